@@ -0,0 +1,502 @@
+// ============================================================================
+//                               BSArchive.cpp
+// ----------------------------------------------------------------------------
+// Part of the open-source Dynamic Animation Replacer (DARGH).
+//
+// Copyright (c) 2023 Nox Sidereum
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the �Software�), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is furnished
+// to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED �AS IS�, WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+// FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+// DEALINGS IN THE SOFTWARE.
+//
+// (The MIT License)
+// ============================================================================
+
+#include "BSArchive.h"
+
+#include <algorithm>
+#include <cstring>
+
+namespace
+{
+	constexpr char     BSA_MAGIC[4] = { 'B', 'S', 'A', '\0' };
+	constexpr uint32_t LZ4_FRAME_MAGIC = 0x184D2204;
+
+	struct Header
+	{
+		char     magic[4];
+		uint32_t version;                    // 104: Skyrim, 105: Skyrim SE
+		uint32_t folderRecordsOffset;
+		uint32_t archiveFlags;
+		uint32_t folderCount;
+		uint32_t fileCount;
+		uint32_t folderNamesLength;          // including each name's terminating NUL, excluding its length byte
+		uint32_t fileNamesLength;            // including each name's terminating NUL
+		uint16_t fileFlags;
+		uint16_t padding;
+	};
+
+	static_assert(sizeof(Header) == 36);
+
+	uint32_t read32(const uint8_t* a_data)
+	{
+		uint32_t value;
+		std::memcpy(&value, a_data, sizeof(value));
+		return value;
+	}
+
+	uint64_t read64(const uint8_t* a_data)
+	{
+		uint64_t value;
+		std::memcpy(&value, a_data, sizeof(value));
+		return value;
+	}
+
+	std::string normalisePath(std::string_view a_path)
+	{
+		// Lower case, '\' separated, without leading or trailing separators.
+		std::string path;
+		path.reserve(a_path.size());
+		for (const char c : a_path) {
+			path.push_back(c == '/' ? '\\' : (c >= 'A' && c <= 'Z') ? static_cast<char>(c + ('a' - 'A')) : c);
+		}
+		const auto first = path.find_first_not_of('\\');
+		if (first == std::string::npos) {
+			return {};
+		}
+		return path.substr(first, path.find_last_not_of('\\') - first + 1);
+	}
+
+	uint32_t hashChars(std::string_view a_chars, uint32_t a_hash = 0)
+	{
+		for (const char c : a_chars) {
+			a_hash = a_hash * 0x1003F + static_cast<uint8_t>(c);
+		}
+		return a_hash;
+	}
+
+	uint64_t hashPath(std::string_view a_root, std::string_view a_ext)
+	{
+		// The hash Bethesda's archives are sorted by: the first, last two
+		// characters and length of the name, and a multiplicative hash of
+		// the rest of it plus the extension.
+		const auto len = a_root.size();
+		uint32_t low = 0;
+		uint32_t high = 0;
+		if (len > 0) {
+			low = static_cast<uint8_t>(a_root[len - 1]) |
+			      (len > 2 ? static_cast<uint8_t>(a_root[len - 2]) << 8 : 0) |
+			      static_cast<uint32_t>(len) << 16 |
+			      static_cast<uint32_t>(static_cast<uint8_t>(a_root[0])) << 24;
+		}
+		if (len > 3) {
+			high = hashChars(a_root.substr(1, len - 3));
+		}
+
+		if (a_ext == ".kf") {
+			low |= 0x80;
+		} else if (a_ext == ".nif") {
+			low |= 0x8000;
+		} else if (a_ext == ".dds") {
+			low |= 0x8080;
+		} else if (a_ext == ".wav") {
+			low |= 0x80000000;
+		}
+		high += hashChars(a_ext);
+
+		return static_cast<uint64_t>(high) << 32 | low;
+	}
+
+	bool decompressLZ4Block(std::span<const uint8_t> a_in, std::span<char> a_out, std::size_t& a_outPos)
+	{
+		// Decodes one LZ4 block, appending it at 'a_outPos'. Matches may
+		// refer back into earlier blocks (which precede it in 'a_out').
+		const auto readLength = [&](std::size_t& a_pos, std::size_t& a_length) {
+			uint8_t byte;
+			do {
+				if (a_pos == a_in.size()) {
+					return false;
+				}
+				byte = a_in[a_pos++];
+				a_length += byte;
+			} while (byte == 255);
+			return true;
+		};
+
+		std::size_t pos = 0;
+		while (pos < a_in.size()) {
+			const uint8_t token = a_in[pos++];
+
+			std::size_t nLiterals = token >> 4;
+			if (nLiterals == 15 && !readLength(pos, nLiterals)) {
+				return false;
+			}
+			if (nLiterals > a_in.size() - pos || nLiterals > a_out.size() - a_outPos) {
+				return false;
+			}
+			std::memcpy(a_out.data() + a_outPos, a_in.data() + pos, nLiterals);
+			pos += nLiterals;
+			a_outPos += nLiterals;
+
+			if (pos == a_in.size()) {
+				// The last sequence has no match.
+				break;
+			}
+
+			if (a_in.size() - pos < 2) {
+				return false;
+			}
+			const std::size_t offset = a_in[pos] | a_in[pos + 1] << 8;
+			pos += 2;
+			std::size_t matchLength = (token & 15) + 4;
+			if ((token & 15) == 15 && !readLength(pos, matchLength)) {
+				return false;
+			}
+			if (offset == 0 || offset > a_outPos || matchLength > a_out.size() - a_outPos) {
+				return false;
+			}
+
+			char* dst = a_out.data() + a_outPos;
+			const char* src = dst - offset;
+			if (offset >= matchLength) {
+				std::memcpy(dst, src, matchLength);
+			} else {
+				// Overlapping: the match repeats the last 'offset' bytes.
+				for (std::size_t i = 0; i < matchLength; ++i) {
+					dst[i] = src[i];
+				}
+			}
+			a_outPos += matchLength;
+		}
+
+		return true;
+	}
+}
+
+uint64_t BSArchive::hashFolder(std::string_view a_lowerPath)
+{
+	return hashPath(a_lowerPath, {});
+}
+
+uint64_t BSArchive::hashFile(std::string_view a_lowerName)
+{
+	const auto dot = a_lowerName.rfind('.');
+	if (dot == std::string_view::npos) {
+		return hashPath(a_lowerName, {});
+	}
+	return hashPath(a_lowerName.substr(0, dot), a_lowerName.substr(dot));
+}
+
+bool BSArchive::open(const std::filesystem::path& a_path, std::string& a_error)
+{
+	archivePath = a_path;
+	folders.clear();
+	files.clear();
+	names.clear();
+	foldersByName.clear();
+
+	// The object may be reused for another archive.
+	stream.close();
+	stream.clear();
+	stream.open(a_path, std::ios::binary | std::ios::ate);
+	if (!stream.is_open()) {
+		a_error = "couldn't open the file";
+		return false;
+	}
+	archiveSize = static_cast<uint64_t>(stream.tellg());
+	stream.seekg(0);
+
+	Header header;
+	if (!stream.read(reinterpret_cast<char*>(&header), sizeof(header)) ||
+		std::memcmp(header.magic, BSA_MAGIC, sizeof(BSA_MAGIC)) != 0) {
+		a_error = "not a BSA archive";
+		return false;
+	}
+	if (header.version != 104 && header.version != 105) {
+		a_error = "unsupported BSA version " + std::to_string(header.version);
+		return false;
+	}
+	if ((header.archiveFlags & kDirectoryNames) == 0 || (header.archiveFlags & kFileNames) == 0) {
+		// Without the names, there's no way of enumerating the archive.
+		a_error = "the archive has no folder or file names";
+		return false;
+	}
+	version = header.version;
+	archiveFlags = header.archiveFlags;
+
+	// The records and names must fit in the file (checked before
+	// allocating anything for them).
+	const std::size_t folderRecordSize = version == 105 ? 24 : 16;
+	if (header.folderRecordsOffset + uint64_t{ header.folderCount } * (folderRecordSize + 1) + header.folderNamesLength +
+		uint64_t{ header.fileCount } * 16 + header.fileNamesLength > archiveSize) {
+		a_error = "the header doesn't match the file size";
+		return false;
+	}
+
+	// ------------------------------------------------------------------------
+	//  1. Folder records: hash and number of files.
+	// ------------------------------------------------------------------------
+	std::vector<uint8_t> block(header.folderCount * folderRecordSize);
+	stream.seekg(header.folderRecordsOffset);
+	if (!stream.read(reinterpret_cast<char*>(block.data()), block.size())) {
+		a_error = "truncated folder records";
+		return false;
+	}
+
+	folders.resize(header.folderCount);
+	uint64_t nFiles = 0;
+	for (uint32_t i = 0; i < header.folderCount; ++i) {
+		const uint8_t* record = block.data() + i * folderRecordSize;
+		folders[i].hash = read64(record);
+		folders[i].firstFile = static_cast<uint32_t>(nFiles);
+		folders[i].numFiles = read32(record + 8);
+		nFiles += folders[i].numFiles;
+	}
+	if (nFiles != header.fileCount) {
+		a_error = "folder records don't add up to the file count";
+		return false;
+	}
+
+	// ------------------------------------------------------------------------
+	//  2. File record blocks, which follow the folder records: for each
+	//     folder, its name (a length byte, then NUL-terminated) and then
+	//     its files' records.
+	// ------------------------------------------------------------------------
+	block.resize(std::size_t{ header.folderCount } + header.folderNamesLength + std::size_t{ header.fileCount } * 16);
+	if (!stream.read(reinterpret_cast<char*>(block.data()), block.size())) {
+		a_error = "truncated file records";
+		return false;
+	}
+
+	files.resize(header.fileCount);
+	std::size_t pos = 0;
+	for (auto& folder : folders) {
+		const std::size_t nameLength = pos < block.size() ? block[pos++] : 0;
+		if (nameLength == 0 || nameLength > block.size() - pos ||
+			std::size_t{ folder.numFiles } * 16 > block.size() - pos - nameLength) {
+			a_error = "malformed file records";
+			return false;
+		}
+		folder.name = normalisePath({ reinterpret_cast<const char*>(block.data() + pos), nameLength - 1 });
+		pos += nameLength;
+
+		for (uint32_t i = 0; i < folder.numFiles; ++i, pos += 16) {
+			auto& file = files[folder.firstFile + i];
+			file.hash = read64(block.data() + pos);
+			file.size = read32(block.data() + pos + 8);
+			file.offset = read32(block.data() + pos + 12);
+		}
+	}
+
+	// ------------------------------------------------------------------------
+	//  3. File names, NUL-terminated, in file record order.
+	// ------------------------------------------------------------------------
+	names.resize(header.fileNamesLength);
+	if (!stream.read(names.data(), names.size()) || names.empty() || names.back() != '\0') {
+		a_error = "truncated file names";
+		return false;
+	}
+	std::transform(names.begin(), names.end(), names.begin(), [](char c) {
+		return (c >= 'A' && c <= 'Z') ? static_cast<char>(c + ('a' - 'A')) : c;
+	});
+
+	uint32_t nameOffset = 0;
+	for (auto& file : files) {
+		if (nameOffset >= names.size()) {
+			a_error = "fewer file names than files";
+			return false;
+		}
+		file.name = nameOffset;
+		nameOffset += static_cast<uint32_t>(std::strlen(names.data() + nameOffset)) + 1;
+	}
+
+	// ------------------------------------------------------------------------
+	//  4. Index. The records should already be sorted by hash, but the
+	//     lookups depend on it, so make sure.
+	// ------------------------------------------------------------------------
+	const auto byHash = [](const auto& a, const auto& b) { return a.hash < b.hash; };
+	if (!std::is_sorted(folders.begin(), folders.end(), byHash)) {
+		std::sort(folders.begin(), folders.end(), byHash);
+	}
+	for (const auto& folder : folders) {
+		const auto folderFiles = files.begin() + folder.firstFile;
+		if (!std::is_sorted(folderFiles, folderFiles + folder.numFiles, byHash)) {
+			std::sort(folderFiles, folderFiles + folder.numFiles, byHash);
+		}
+	}
+
+	foldersByName.resize(folders.size());
+	for (uint32_t i = 0; i < foldersByName.size(); ++i) {
+		foldersByName[i] = i;
+	}
+	std::sort(foldersByName.begin(), foldersByName.end(), [this](uint32_t a, uint32_t b) {
+		return folders[a].name < folders[b].name;
+	});
+
+	return true;
+}
+
+const BSArchive::Folder* BSArchive::findFolder(std::string_view a_path) const
+{
+	const auto path = normalisePath(a_path);
+	const auto hash = hashFolder(path);
+	auto it = std::lower_bound(folders.begin(), folders.end(), hash,
+		[](const Folder& a, uint64_t b) { return a.hash < b; });
+	for (; it != folders.end() && it->hash == hash; ++it) {
+		if (it->name == path) {
+			return &*it;
+		}
+	}
+	return nullptr;
+}
+
+const BSArchive::File* BSArchive::findFile(std::string_view a_path) const
+{
+	const auto path = normalisePath(a_path);
+	const auto separator = path.rfind('\\');
+	const Folder* folder = findFolder(separator == std::string::npos ? std::string_view{} : std::string_view(path).substr(0, separator));
+	if (!folder) {
+		return nullptr;
+	}
+
+	const auto name = std::string_view(path).substr(separator == std::string::npos ? 0 : separator + 1);
+	const auto folderFiles = filesIn(*folder);
+	const auto hash = hashFile(name);
+	auto it = std::lower_bound(folderFiles.begin(), folderFiles.end(), hash,
+		[](const File& a, uint64_t b) { return a.hash < b; });
+	for (; it != folderFiles.end() && it->hash == hash; ++it) {
+		if (fileName(*it) == name) {
+			return &*it;
+		}
+	}
+	return nullptr;
+}
+
+void BSArchive::forEachFolderUnder(std::string_view a_path, const std::function<void(const Folder&)>& a_func) const
+{
+	const auto path = normalisePath(a_path);
+	const auto byName = [this](uint32_t a, const std::string& b) { return folders[a].name < b; };
+
+	// The folder itself, then those whose names start with "path\" (which
+	// needn't directly follow it, e.g. "path-2" sorts between them).
+	auto it = std::lower_bound(foldersByName.begin(), foldersByName.end(), path, byName);
+	if (it != foldersByName.end() && folders[*it].name == path) {
+		a_func(folders[*it++]);
+	}
+
+	const auto prefix = path.empty() ? path : path + '\\';
+	for (it = std::lower_bound(it, foldersByName.end(), prefix, byName);
+		 it != foldersByName.end() && folders[*it].name.starts_with(prefix); ++it) {
+		a_func(folders[*it]);
+	}
+}
+
+bool BSArchive::read(const File& a_file, std::vector<char>& a_contents)
+{
+	if (a_file.offset + uint64_t{ a_file.size & kSizeMask } > archiveSize) {
+		return false;
+	}
+
+	std::vector<uint8_t> data(a_file.size & kSizeMask);
+	stream.clear();
+	stream.seekg(a_file.offset);
+	if (!stream.read(reinterpret_cast<char*>(data.data()), data.size())) {
+		return false;
+	}
+
+	std::size_t pos = 0;
+	if (archiveFlags & kEmbedFileNames) {
+		// Skip the file's path (a length byte, then the path).
+		if (data.empty()) {
+			return false;
+		}
+		pos = 1 + std::size_t{ data[0] };
+	}
+
+	const bool bCompressed = ((archiveFlags & kCompressed) != 0) != ((a_file.size & kToggleCompression) != 0);
+	if (!bCompressed) {
+		if (pos > data.size()) {
+			return false;
+		}
+		a_contents.assign(data.begin() + pos, data.end());
+		return true;
+	}
+
+	// Compressed: the original size, then the compressed data. Only
+	// version 105 (LZ4) is supported: 104 uses zlib, and Skyrim SE
+	// doesn't load those archives anyway.
+	if (version != 105 || pos + 4 > data.size()) {
+		return false;
+	}
+	const uint32_t originalSize = read32(data.data() + pos);
+	if (originalSize / 255 > data.size()) {
+		// More than LZ4 can expand to: the size is corrupt.
+		return false;
+	}
+	a_contents.resize(originalSize);
+	return decompressLZ4Frame(std::span(data).subspan(pos + 4), a_contents);
+}
+
+bool BSArchive::decompressLZ4Frame(std::span<const uint8_t> a_in, std::span<char> a_out)
+{
+	// Frame header: magic, flags, block descriptor, [content size],
+	// [dictionary ID], header checksum.
+	if (a_in.size() < 7 || read32(a_in.data()) != LZ4_FRAME_MAGIC) {
+		return false;
+	}
+	const uint8_t flags = a_in[4];
+	if ((flags >> 6) != 1 || (flags & 0x01)) {
+		// Unknown version, or needs a dictionary.
+		return false;
+	}
+	const bool bBlockChecksums = (flags & 0x10) != 0;
+	std::size_t pos = 6 + ((flags & 0x08) ? 8 : 0) + 1;
+
+	// Blocks, each preceded by its size, until a zero size. The top bit of
+	// the size marks a block stored uncompressed.
+	std::size_t outPos = 0;
+	for (;;) {
+		if (pos + 4 > a_in.size()) {
+			return false;
+		}
+		uint32_t blockSize = read32(a_in.data() + pos);
+		pos += 4;
+		if (blockSize == 0) {
+			break;
+		}
+
+		const bool bStored = (blockSize & 0x80000000) != 0;
+		blockSize &= 0x7FFFFFFF;
+		if (blockSize > a_in.size() - pos) {
+			return false;
+		}
+
+		const auto block = a_in.subspan(pos, blockSize);
+		if (bStored) {
+			if (blockSize > a_out.size() - outPos) {
+				return false;
+			}
+			std::memcpy(a_out.data() + outPos, block.data(), blockSize);
+			outPos += blockSize;
+		} else if (!decompressLZ4Block(block, a_out, outPos)) {
+			return false;
+		}
+		pos += blockSize + (bBlockChecksums ? 4 : 0);
+	}
+
+	return outPos == a_out.size();
+}
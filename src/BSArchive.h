@@ -0,0 +1,132 @@
+// ============================================================================
+//                                BSArchive.h
+// ----------------------------------------------------------------------------
+// Part of the open-source Dynamic Animation Replacer (DARGH).
+//
+// Copyright (c) 2023 Nox Sidereum
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the �Software�), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is furnished
+// to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED �AS IS�, WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+// FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+// DEALINGS IN THE SOFTWARE.
+//
+// (The MIT License)
+// ============================================================================
+
+#pragma once
+
+// ----------------------------------------------------------------------------
+// Reader for Bethesda archives (.bsa, versions 104 and 105), enough to find
+// and read the DynamicAnimationReplacer trees that mods ship inside them.
+//
+// open() parses the archive's folder and file records and its name tables
+// once, into an in-memory index. The records are sorted by hash in the
+// archive, so lookups are binary searches on the Bethesda path hash; the
+// names are only kept to enumerate folders (and to rule out hash
+// collisions). File data is read on demand and, if compressed, inflated
+// (LZ4 frames, as used by Skyrim SE's archives).
+//
+// Paths are relative to Data, e.g. "meshes\actors\character\animations".
+// They are matched case-insensitively, and '/' is treated as '\'.
+//
+// N.B. so that it can be built and tested outside the game (e.g. on Linux),
+// this must not depend on CommonLibSSE (or the PCH).
+// ----------------------------------------------------------------------------
+
+#include <cstdint>
+#include <filesystem>
+#include <fstream>
+#include <functional>
+#include <span>
+#include <string>
+#include <string_view>
+#include <vector>
+
+class BSArchive
+{
+public:
+	struct File
+	{
+		uint64_t hash;
+		uint32_t size;                       // bit 30 set: compression is the opposite of the archive's default
+		uint32_t offset;                     // of the data, from the start of the archive
+		uint32_t name;                       // offset into the name table
+	};
+
+	struct Folder
+	{
+		uint64_t    hash;
+		std::string name;                    // lower case, '\' separated
+		uint32_t    firstFile;               // index into files
+		uint32_t    numFiles;
+	};
+
+	// Opens the archive and builds its index. On failure, returns false and
+	// describes the problem in 'a_error'.
+	bool open(const std::filesystem::path& a_path, std::string& a_error);
+
+	// Bethesda's hash of a folder path, or of a file name (without its folder).
+	static uint64_t hashFolder(std::string_view a_lowerPath);
+	static uint64_t hashFile(std::string_view a_lowerName);
+
+	// The folder or file with the given path, or NULL if there isn't one.
+	const Folder* findFolder(std::string_view a_path) const;
+	const File* findFile(std::string_view a_path) const;
+
+	// Calls 'a_func' for 'a_path' and every folder below it, in name order
+	// ("" for every folder in the archive).
+	void forEachFolderUnder(std::string_view a_path, const std::function<void(const Folder&)>& a_func) const;
+
+	std::span<const File> filesIn(const Folder& a_folder) const
+	{
+		return std::span<const File>(files).subspan(a_folder.firstFile, a_folder.numFiles);
+	}
+
+	std::string_view fileName(const File& a_file) const { return names.data() + a_file.name; }
+
+	// Reads (and if need be, decompresses) a file's contents.
+	bool read(const File& a_file, std::vector<char>& a_contents);
+
+	const std::filesystem::path& path() const { return archivePath; }
+	std::size_t numFolders() const { return folders.size(); }
+	std::size_t numFiles() const { return files.size(); }
+
+	// Decompresses an LZ4 frame. Returns false if it's malformed or doesn't
+	// decompress to exactly 'a_out.size()' bytes.
+	static bool decompressLZ4Frame(std::span<const uint8_t> a_in, std::span<char> a_out);
+
+private:
+	enum ArchiveFlags : uint32_t
+	{
+		kDirectoryNames = 1 << 0,
+		kFileNames      = 1 << 1,
+		kCompressed     = 1 << 2,            // files are compressed unless their size has kToggleCompression set
+		kEmbedFileNames = 1 << 8             // each file's data starts with its path
+	};
+
+	static constexpr uint32_t kToggleCompression = 1 << 30;
+	static constexpr uint32_t kSizeMask = 0x3FFFFFFF;
+
+	std::filesystem::path archivePath;
+	std::ifstream         stream;
+	uint64_t              archiveSize = 0;
+	uint32_t              version = 0;
+	uint32_t              archiveFlags = 0;
+	std::vector<Folder>   folders;           // sorted by hash, as in the archive
+	std::vector<File>     files;             // by folder, each folder's sorted by hash
+	std::vector<char>     names;             // the file name table
+	std::vector<uint32_t> foldersByName;     // indices into folders, sorted by name
+};
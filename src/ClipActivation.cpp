@@ -0,0 +1,150 @@
+// ============================================================================
+//                             ClipActivation.cpp
+// ----------------------------------------------------------------------------
+// Part of the open-source Dynamic Animation Replacer (DARGH).
+//
+// Copyright (c) 2023 Nox Sidereum
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the �Software�), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is furnished
+// to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED �AS IS�, WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+// FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+// DEALINGS IN THE SOFTWARE.
+//
+// (The MIT License)
+// ============================================================================
+
+#include "ClipActivation.h"
+#include "DARProjectRegistry.h"
+#include "Trace.h"
+
+using DARGH::TraceCategory;
+
+// Clip generator whose replacement was decided by AnimationLoaderHook on this thread,
+// and which it's about to activate (see DecidedActivation).
+thread_local RE::hkbClipGenerator* t_decidedClipGenerator = nullptr;
+
+#ifdef DEBUG_COUNT_DECISIONS
+// Innermost DecidedActivation on this thread.
+thread_local DecidedActivation* t_decidedActivation = nullptr;
+std::atomic<uint64_t> g_nDecidedActivations{ 0 };
+#endif
+
+DecidedActivation::DecidedActivation(RE::hkbClipGenerator* a_clipGenerator) :
+	prevClipGenerator(t_decidedClipGenerator)
+#ifdef DEBUG_COUNT_DECISIONS
+	, clipGenerator(a_clipGenerator)
+	, prevActivation(t_decidedActivation)
+#endif
+{
+	t_decidedClipGenerator = a_clipGenerator;
+#ifdef DEBUG_COUNT_DECISIONS
+	t_decidedActivation = this;
+#endif
+}
+
+DecidedActivation::~DecidedActivation()
+{
+	t_decidedClipGenerator = prevClipGenerator;
+#ifdef DEBUG_COUNT_DECISIONS
+	t_decidedActivation = prevActivation;
+	if (nDecisions != 1) {
+		logs::critical("clip generator {:#x}: activation decided {} times", reinterpret_cast<uintptr_t>(clipGenerator), nDecisions);
+		std::abort();
+	}
+
+	const auto nActivations = ++g_nDecidedActivations;
+	if (nActivations % 4096 == 0) {
+		logs::info("decision check: {} activations decided once", nActivations);
+	}
+#endif
+}
+
+bool DecidedActivation::take(RE::hkbClipGenerator* a_clipGenerator)
+{
+	if (a_clipGenerator != t_decidedClipGenerator) {
+		return false;
+	}
+
+	t_decidedClipGenerator = nullptr;
+	return true;
+}
+
+#ifdef DEBUG_COUNT_DECISIONS
+void DecidedActivation::countDecision(RE::hkbClipGenerator* a_clipGenerator)
+{
+	for (auto activation = t_decidedActivation; activation; activation = activation->prevActivation) {
+		if (activation->clipGenerator == a_clipGenerator) {
+			if (++activation->nDecisions > 1) {
+				logs::critical("clip generator {:#x}: activation decided again", reinterpret_cast<uintptr_t>(a_clipGenerator));
+				std::abort();
+			}
+			return;
+		}
+	}
+}
+#endif
+
+namespace DARGH
+{
+	int16_t decideReplacement(RE::hkbClipGenerator* a_clipGenerator, RE::hkbContext* a_context,
+		DARProject*& a_darProj, const char* a_hook)
+	{
+		// N.B. this must not allocate (see DEBUG_COUNT_ALLOCATIONS).
+#ifdef DEBUG_COUNT_DECISIONS
+		DecidedActivation::countDecision(a_clipGenerator);
+#endif
+#ifdef DEBUG_COUNT_ALLOCATIONS
+		NoAllocationScope noAllocations(a_hook);
+#else
+		(void)a_hook;
+#endif
+		a_darProj = nullptr;
+		const std::int16_t origIndex = a_clipGenerator->animationBindingIndex; // CommonLibSSE offset for this member is wrong, fix it upstream (06C -> 070)
+		if (origIndex == -1) {
+			return -1;
+		}
+
+		a_darProj = getDARProject(a_context->character->projectData);
+		if (!a_darProj) {
+			return -1;
+		}
+
+		// Assume here that the hkbCharacter reference is stored in a
+		// BShkbAnimationGraph object o, at o.characterInstance (offset 0xC0):
+		RE::BShkbAnimationGraph* animGraph = (RE::BShkbAnimationGraph*)((uint64_t)a_context->character - 0xC0);
+		RE::Actor* actor = animGraph->holder;
+		if (!actor || !actor->Is(RE::FormType::ActorCharacter)) {
+			return -1;
+		}
+
+		return getNewAnimIndex(a_darProj, origIndex, actor);
+	}
+
+	int16_t decideActivation(RE::hkbClipGenerator* a_clipGenerator, RE::hkbContext* a_context)
+	{
+		if (DecidedActivation::take(a_clipGenerator)) {
+			// AnimationLoaderHook has already evaluated the mappings for this clip
+			// generator and set its animation index accordingly. Don't evaluate
+			// them again: that would double the cost and could disagree with the
+			// animation that was just loaded (e.g. with Random conditions).
+			trace(TraceCategory::kHooks, "Using the decision made by AnimationLoaderHook.");
+			return -1;
+		}
+
+		DARProject* darProj;
+		return decideReplacement(a_clipGenerator, a_context, darProj, "hkbClipGenerator::Activate");
+	}
+}
@@ -0,0 +1,89 @@
+// ============================================================================
+//                              ClipActivation.h
+// ----------------------------------------------------------------------------
+// Part of the open-source Dynamic Animation Replacer (DARGH).
+//
+// Copyright (c) 2023 Nox Sidereum
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the �Software�), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is furnished
+// to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED �AS IS�, WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+// FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+// DEALINGS IN THE SOFTWARE.
+//
+// (The MIT License)
+// ============================================================================
+
+#pragma once
+
+#include "DebugUtils.h"
+
+struct DARProject;
+
+// ----------------------------------------------------------------------------
+// Deciding whether to replace the animation of a clip generator that's being
+// activated. The game activates a clip generator either through
+// AnimationLoaderHook (Trampolines.cpp), which loads the animation and then
+// calls hkbClipGenerator::Activate, or by calling Activate directly (see
+// Hooks.cpp). Each activation is decided once: by whichever hook sees it
+// first.
+// ----------------------------------------------------------------------------
+
+// Marks a clip generator whose replacement has already been decided (and applied
+// to its animationBindingIndex) by the caller, for as long as this object lives on
+// the current thread. hkbClipGenerator::Activate then uses that decision instead of
+// evaluating the DAR mappings a second time (DEBUG_COUNT_DECISIONS checks this).
+class DecidedActivation
+{
+public:
+	explicit DecidedActivation(RE::hkbClipGenerator* a_clipGenerator);
+	~DecidedActivation();
+
+	DecidedActivation(const DecidedActivation&) = delete;
+	DecidedActivation& operator=(const DecidedActivation&) = delete;
+
+	// Whether 'a_clipGenerator' is the one this thread has decided and is
+	// about to activate. If so, it no longer is once this returns.
+	static bool take(RE::hkbClipGenerator* a_clipGenerator);
+
+#ifdef DEBUG_COUNT_DECISIONS
+	// Counts a decision on whether to replace the animation of 'a_clipGenerator'
+	// made on this thread. Aborts if it's the second for a DecidedActivation.
+	static void countDecision(RE::hkbClipGenerator* a_clipGenerator);
+#endif
+
+private:
+	RE::hkbClipGenerator* prevClipGenerator;
+#ifdef DEBUG_COUNT_DECISIONS
+	RE::hkbClipGenerator* clipGenerator;
+	DecidedActivation* prevActivation;
+	uint32_t nDecisions{ 0 };
+#endif
+};
+
+namespace DARGH
+{
+	// Returns the index of the animation to activate 'a_clipGenerator' with
+	// instead of its own, for the character in 'a_context', or -1 if it
+	// shouldn't be replaced. 'a_darProj' is set to the character's project
+	// if it has one. 'a_hook' names the caller (see DEBUG_COUNT_ALLOCATIONS).
+	int16_t decideReplacement(RE::hkbClipGenerator* a_clipGenerator, RE::hkbContext* a_context,
+		DARProject*& a_darProj, const char* a_hook);
+
+	// As decideReplacement, for hkbClipGenerator::Activate. Returns -1 if
+	// the activation has already been decided (see DecidedActivation): the
+	// clip generator's index is then the one decided.
+	int16_t decideActivation(RE::hkbClipGenerator* a_clipGenerator, RE::hkbContext* a_context);
+}
@@ -1,38 +1,206 @@
-// ============================================================================
-//                             Conditions.h
-// ----------------------------------------------------------------------------
-// Part of the open-source Dynamic Animation Replacer (DARGH).
-//
-// Copyright (c) 2023 Nox Sidereum
-//
-// Permission is hereby granted, free of charge, to any person obtaining a copy
-// of this software and associated documentation files (the �Software�), to deal
-// in the Software without restriction, including without limitation the rights
-// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
-// copies of the Software, and to permit persons to whom the Software is furnished
-// to do so, subject to the following conditions:
-//
-// The above copyright notice and this permission notice shall be included in
-// all copies or substantial portions of the Software.
-//
-// THE SOFTWARE IS PROVIDED �AS IS�, WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
-// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
-// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
-// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
-// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
-// FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
-// DEALINGS IN THE SOFTWARE.
-//
-// (The MIT License)
-// ============================================================================
-
-#pragma once
-
-struct FuncInfo
-{
-	void*     funcPtr;
-	uint32_t  nArgs;
-	uint32_t  bmArgIsFloat;
-};
-
-extern std::unordered_map<std::string, FuncInfo> g_DARConditionFuncs;
+// ============================================================================
+//                             Conditions.h
+// ----------------------------------------------------------------------------
+// Part of the open-source Dynamic Animation Replacer (DARGH).
+//
+// Copyright (c) 2023 Nox Sidereum
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the �Software�), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is furnished
+// to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED �AS IS�, WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+// FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+// DEALINGS IN THE SOFTWARE.
+//
+// (The MIT License)
+// ============================================================================
+
+#pragma once
+
+#include "DarghAPI.h"
+
+// ----------------------------------------------------------------------------
+// Concurrency model of the condition engine.
+//
+// Conditions are evaluated on whichever threads activate clip generators,
+// and several Havok job threads do that at once. So everything a condition
+// touches is one of:
+//   1. Immutable once loaded: the function table (including the native
+//      predicates other plugins register, which closes at kDataLoaded),
+//      each folder's ConditionPool and decision diagrams, the remap plans
+//      and the equipped item type table. These are built before the DAR data is published
+//      (g_isDARDataLoaded, release/acquire) or under g_remapPlanLock, and
+//      never modified after that.
+//   2. Per thread: scratch space lives on the stack, Random draws from a
+//      thread_local generator, and the activation decided by
+//      AnimationLoaderHook is thread_local.
+//   3. Atomically published: lookups resolved on first use (e.g. the
+//      warhammer keyword, the item types of forms created at runtime, or
+//      the static conditions' results per kind of actor) and the per-frame
+//      world snapshot. These are
+//      atomics, stored with release and loaded with acquire (or relaxed,
+//      where a value only needs to be untorn), so readers never lock.
+// Anything added to the engine (e.g. a cache) should fit one of these, so
+// that evaluation scales with threads rather than serialising on a lock.
+// tests/host/conditions_stress.cpp runs the engine this way under
+// ThreadSanitizer (xmake build conditions_stress).
+// ----------------------------------------------------------------------------
+
+struct ConditionLinkFunc;
+
+// Condition function IDs, in the order of the DAR condition function table
+// (see Conditions.cpp).
+enum class ConditionFuncID : uint16_t
+{
+	kIsEquippedRight,
+	kIsEquippedRightType,
+	kIsEquippedRightHasKeyword,
+	kIsEquippedLeft,
+	kIsEquippedLeftType,
+	kIsEquippedLeftHasKeyword,
+	kIsEquippedShout,
+	kIsWorn,
+	kIsWornHasKeyword,
+	kIsFemale,
+	kIsChild,
+	kIsPlayerTeammate,
+	kIsInInterior,
+	kIsInFaction,
+	kHasKeyword,
+	kHasMagicEffect,
+	kHasMagicEffectWithKeyword,
+	kHasPerk,
+	kHasSpell,
+	kIsActorValueEqualTo,
+	kIsActorValueLessThan,
+	kIsActorValueBaseEqualTo,
+	kIsActorValueBaseLessThan,
+	kIsActorValueMaxEqualTo,
+	kIsActorValueMaxLessThan,
+	kIsActorValuePercentageEqualTo,
+	kIsActorValuePercentageLessThan,
+	kIsLevelLessThan,
+	kIsActorBase,
+	kIsRace,
+	kCurrentWeather,
+	kCurrentGameTimeLessThan,
+	kValueEqualTo,
+	kValueLessThan,
+	kRandom,
+	kIsUnique,
+	kIsClass,
+	kIsCombatStyle,
+	kIsVoiceType,
+	kIsAttacking,
+	kIsRunning,
+	kIsSneaking,
+	kIsSprinting,
+	kIsInAir,
+	kIsInCombat,
+	kIsWeaponDrawn,
+	kIsInLocation,
+	kHasRefType,
+	kIsParentCell,
+	kIsWorldSpace,
+	kIsFactionRankEqualTo,
+	kIsFactionRankLessThan,
+	kIsMovementDirection,
+
+	kTotal
+};
+
+// Rough cost of evaluating a condition function.
+enum class CostClass : uint8_t
+{
+	kTrivial,          // reads a field or flag of the actor or a singleton
+	kLookup,           // form lookups and/or a few virtual calls
+	kScan              // iterates over a collection (inventory, effects, factions...)
+};
+
+// What type of value an argument takes.
+enum class ArgType : uint8_t
+{
+	kForm,             // "esp name" | formID
+	kGlobal            // GlobalVariable: "esp name" | formID, or a float
+};
+
+// What game state a condition function's result depends on (bit mask).
+enum StateDeps : uint32_t
+{
+	kDepNone        = 0,
+	kDepActorBase   = 1 << 0,    // actor base: sex, class, voice type, keywords...
+	kDepRace        = 1 << 1,
+	kDepEquipment   = 1 << 2,    // items in the actor's hands, selected power
+	kDepInventory   = 1 << 3,    // worn items
+	kDepActorState  = 1 << 4,    // moving, sneaking, in combat...
+	kDepActorValues = 1 << 5,    // actor values and level
+	kDepFactions    = 1 << 6,
+	kDepMagic       = 1 << 7,    // magic effects, spells, perks
+	kDepLocation    = 1 << 8,    // cell, worldspace, location
+	kDepWorld       = 1 << 9,    // weather, game time
+	kDepGlobals     = 1 << 10,   // GlobalVariable arguments
+	kDepRandom      = 1 << 11
+};
+
+// The most arguments any condition function takes.
+constexpr uint32_t MAX_CONDITION_ARGS = 2;
+
+// The most condition functions other plugins can register (see DarghAPI.h).
+// They take the IDs from kTotal on.
+constexpr uint32_t MAX_NATIVE_CONDITIONS = 64;
+constexpr std::size_t MAX_CONDITION_FUNCS = static_cast<std::size_t>(ConditionFuncID::kTotal) + MAX_NATIVE_CONDITIONS;
+
+using ConditionFunc = bool (*)(RE::Actor*, std::variant<uint32_t, float>*, uint32_t);
+
+struct FuncInfo
+{
+	std::string_view  name;
+	ConditionFunc     funcPtr;
+	ConditionFuncID   id;
+	uint32_t          nArgs;
+	uint32_t          bmArgIsFloat;     // bit set if the corresponding arg can be a float
+	CostClass         cost;
+	uint32_t          deps;             // StateDeps
+
+	constexpr ArgType argType(uint32_t a_index) const
+	{
+		return (bmArgIsFloat & (1 << a_index)) ? ArgType::kGlobal : ArgType::kForm;
+	}
+};
+
+const FuncInfo* findConditionFunc(std::string_view a_name);
+const FuncInfo& getConditionFunc(ConditionFuncID a_id);
+uint32_t numConditionFuncs();
+
+// Registration of other plugins' condition functions (see DarghAPI.h).
+// Main thread only, until closeNativeConditions is called at kDataLoaded.
+uint32_t registerNativeCondition(const DARGH_API::RegisterPredicate& a_request);
+void closeNativeConditions();
+
+// The item types compared by IsEquippedRightType and IsEquippedLeftType,
+// classified once per form. buildEquippedTypeTable classifies the loaded
+// forms before the DAR data is published; clearDynamicEquippedTypes forgets
+// those created at runtime, when a game is loaded.
+void buildEquippedTypeTable();
+void clearDynamicEquippedTypes();
+
+// Result of folding a chain of conditions at load time.
+enum class ConditionsFold
+{
+	kUnknown,          // depends on the actor or game state
+	kAlwaysTrue,       // every remaining term was removed
+	kAlwaysFalse       // can never evaluate to true
+};
+
+ConditionsFold simplifyConditions(std::vector<ConditionLinkFunc>& a_conditions, uint32_t& a_nRemoved);
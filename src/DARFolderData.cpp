@@ -0,0 +1,222 @@
+// ============================================================================
+//                             DARFolderData.cpp
+// ----------------------------------------------------------------------------
+// Part of the open-source Dynamic Animation Replacer (DARGH).
+//
+// Copyright (c) 2023 Nox Sidereum
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the �Software�), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is furnished
+// to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED �AS IS�, WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+// FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+// DEALINGS IN THE SOFTWARE.
+//
+// (The MIT License)
+// ============================================================================
+
+#include "DARProject.h"
+#include "Utilities.h"
+#include "Plugin.h"
+#include "Timing.h"
+
+// ----------------------------------------------------------------------------
+// Once a project folder's links are loaded (see DARProject.cpp), these build
+// what its remap plans use at runtime: the links' index by FROM file, the
+// pooled conditions, and the decision diagrams. They don't depend on the
+// game, so the host benches (tests/host) build folders with them too.
+// ----------------------------------------------------------------------------
+namespace DARGH
+{
+	void indexDARLinks(DARFolderData& folderData)
+	{
+		// ====================================================================
+		//                          indexDARLinks
+		// --------------------------------------------------------------------
+		// Indexes the loaded M1 and M2 links by the hash of their FROM
+		// animation file, so that building a remap plan only needs one
+		// lookup per original animation name.
+		// ====================================================================
+		PhaseTimer timer(Phase::kBuildLinks);
+
+		folderData.actorBaseLinkIndex.clear();
+		for (uint32_t i = 0; i < folderData.actorBaseLinks.size(); ++i)
+		{
+			const auto hash = hashLowerASCII(folderData.actorBaseLinks[i].from_hkx_file);
+			folderData.actorBaseLinkIndex[hash].push_back(i);
+		}
+
+		folderData.conditionLinkIndex.clear();
+		for (uint32_t i = 0; i < folderData.conditionLinks.size(); ++i)
+		{
+			const auto hash = hashLowerASCII(folderData.conditionLinks[i].from_hkx_file);
+			folderData.conditionLinkIndex[hash].push_back(i);
+		}
+	}
+
+	void buildConditionPool(DARFolderData& folderData)
+	{
+		// ====================================================================
+		//                        buildConditionPool
+		// --------------------------------------------------------------------
+		// Packs the conditions of every loaded ConditionLink into the
+		// folder's ConditionPool and releases the per-link copies.
+		// All links from one priority subfolder were parsed from the same
+		// _conditions.txt file, so they share a single chain.
+		// ====================================================================
+		PhaseTimer timer(Phase::kBuildLinks);
+
+		auto& pool = folderData.conditionPool;
+		pool = ConditionPool{};
+		for (uint32_t i = 0; i < numConditionFuncs(); ++i)
+		{
+			pool.dispatch[i] = getConditionFunc(static_cast<ConditionFuncID>(i)).funcPtr;
+		}
+
+		std::size_t nOrigBytes = 0;
+		std::unordered_map<int32_t, uint32_t> chainForPriority;
+		for (auto& conditionLink : folderData.conditionLinks)
+		{
+			nOrigBytes += conditionLink.conditions.capacity() * sizeof(ConditionLinkFunc);
+			for (auto& cond : conditionLink.conditions)
+			{
+				nOrigBytes += cond.args.capacity() * sizeof(ConditionPool::Arg);
+			}
+
+			const auto [it, bNewChain] = chainForPriority.try_emplace(conditionLink.priority, pool.numChains());
+			conditionLink.chain = it->second;
+			if (bNewChain)
+			{
+				uint32_t deps = kDepNone;
+				for (auto& cond : conditionLink.conditions)
+				{
+					deps |= getConditionFunc(cond.funcID).deps;
+
+					uint8_t flags = static_cast<uint8_t>(cond.bmArgIsFloat << ConditionPool::kArgIsFloatShift);
+					if (cond.bNot)
+						flags |= ConditionPool::kNot;
+					if (cond.bAnd)
+						flags |= ConditionPool::kAnd;
+					if (cond.bESPNotLoaded)
+						flags |= ConditionPool::kESPNotLoaded;
+
+					std::array<ConditionPool::Arg, MAX_CONDITION_ARGS> args{};
+					std::copy(cond.args.begin(), cond.args.end(), args.begin());
+
+					pool.ops.push_back(cond.funcID);
+					pool.flags.push_back(flags);
+					pool.args.push_back(args);
+				}
+				pool.chainStart.push_back(pool.numTerms());
+				pool.chainDeps.push_back(deps);
+			}
+
+			// The pool is now the only copy that's evaluated.
+			std::vector<ConditionLinkFunc>().swap(conditionLink.conditions);
+		}
+
+		pool.ops.shrink_to_fit();
+		pool.flags.shrink_to_fit();
+		pool.args.shrink_to_fit();
+		pool.chainStart.shrink_to_fit();
+		pool.chainDeps.shrink_to_fit();
+
+		if (pool.numChains() > 0)
+		{
+			const auto nBytes = pool.sizeInBytes();
+			logs::info("{}: condition pool: {} chains, {} terms, {} bytes ({} cache lines), was {} bytes across {} links",
+				folderData.projFolder, pool.numChains(), pool.numTerms(), nBytes,
+				(nBytes + 63) / 64, nOrigBytes, folderData.conditionLinks.size());
+		}
+
+		// Split off the parts of the chains that only depend on the actor's
+		// base and race, to evaluate them once per kind of actor.
+		if (Plugin::CACHE_STATIC_CONDITIONS)
+		{
+			const uint32_t nChains = pool.numChains();
+			splitStaticConditions(pool);
+			if (pool.statics)
+			{
+				const auto nStatic = std::count_if(pool.staticChain.begin(), pool.staticChain.end(),
+					[](uint32_t a_chain) { return a_chain != ConditionPool::NO_CHAIN; });
+				logs::info("{}: {} of {} chains have a static part, cached in {} bytes",
+					folderData.projFolder, nStatic, nChains, pool.statics->sizeInBytes());
+			}
+		}
+	}
+
+	void compileDecisionDAGs(DARFolderData& folderData)
+	{
+		// ====================================================================
+		//                        compileDecisionDAGs
+		// --------------------------------------------------------------------
+		// Compiles the candidate list of each FROM animation file with more
+		// than one mapping into a decision diagram (see DecisionDAG.h). The
+		// lists only depend on the folder's links, so this is done here, on
+		// the loader thread, rather than for each remap plan. A plan whose
+		// list differs (e.g. PackByPriority dropped a folder) finds no
+		// diagram, and evaluates its candidates in sequence.
+		//
+		// The lists are ordered as in DARRemapPlan::allLinks: by priority,
+		// highest first, with every M1 mapping as one candidate at 0.
+		// ====================================================================
+		PhaseTimer timer(Phase::kBuildLinks);
+
+		std::unordered_map<std::string_view, std::map<int32_t, uint32_t, std::greater<int32_t>>> candidates;
+		for (const auto& actorBaseLink : folderData.actorBaseLinks)
+		{
+			candidates[actorBaseLink.from_hkx_file].try_emplace(0, DecisionDAG::kActorBase);
+		}
+		for (const auto& conditionLink : folderData.conditionLinks)
+		{
+			candidates[conditionLink.from_hkx_file].try_emplace(conditionLink.priority, conditionLink.chain);
+		}
+
+		std::size_t nNodes = 0;
+		std::size_t nLists = 0;
+		std::vector<uint32_t> chains;
+		for (const auto& [fromFile, byPriority] : candidates)
+		{
+			if (byPriority.size() < 2)
+			{
+				continue;
+			}
+
+			++nLists;
+			chains.clear();
+			for (const auto& [priority, chain] : byPriority)
+			{
+				chains.push_back(chain);
+			}
+
+			const auto [it, bNew] = folderData.decisionDAGs.try_emplace(chains, nullptr);
+			if (bNew)
+			{
+				it->second = DecisionDAG::compile(folderData.conditionPool, chains);
+				if (it->second)
+				{
+					nNodes += it->second->numNodes();
+				}
+			}
+		}
+
+		// Keep only the lists worth a diagram.
+		std::erase_if(folderData.decisionDAGs, [](const auto& a_entry) { return !a_entry.second; });
+		if (!folderData.decisionDAGs.empty())
+		{
+			logs::info("{}: compiled {} decision diagrams ({} nodes, {} bytes) for {} candidate lists",
+				folderData.projFolder, folderData.decisionDAGs.size(), nNodes, nNodes * sizeof(DecisionNode), nLists);
+		}
+	}
+}
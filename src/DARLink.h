@@ -1,158 +1,310 @@
-// ============================================================================
-//                                 DARLink.h
-// ----------------------------------------------------------------------------
-// Part of the open-source Dynamic Animation Replacer (DARGH).
-//
-// Copyright (c) 2023 Nox Sidereum
-//
-// Permission is hereby granted, free of charge, to any person obtaining a copy
-// of this software and associated documentation files (the �Software�), to deal
-// in the Software without restriction, including without limitation the rights
-// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
-// copies of the Software, and to permit persons to whom the Software is furnished
-// to do so, subject to the following conditions:
-//
-// The above copyright notice and this permission notice shall be included in
-// all copies or substantial portions of the Software.
-//
-// THE SOFTWARE IS PROVIDED �AS IS�, WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
-// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
-// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
-// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
-// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
-// FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
-// DEALINGS IN THE SOFTWARE.
-//
-// (The MIT License)
-// ============================================================================
-
-#pragma once
-
-// Used for actor base data (method 1) ------------
-struct ActorBaseLink
-{
-	std::string from_hkx_file;                             // animation file path to map FROM
-	std::string to_hkx_file;                               // animation file path to map TO
-	RE::FormID  actorBaseID{ 0 };                          // complete actor form ID: i.e. modIndex | (actor base)
-};
-// ------------------------------------------------
-
-// Used for condition data (method 2) -------------
-struct ConditionLinkFunc
-{
-	void* funcPtr;                                         // function pointer
-	std::vector<std::variant<uint32_t, float>> args;       // function args: form IDs (unsigned ints) or floats
-	uint32_t bmArgIsFloat;                                 // bit mask - if the bit is set, the corresponding arg is a float.
-	bool bNot = false;                                     // result of this condition should be NOTed
-	bool bAnd = true;                                      // result of this condition should be ANDed with the next condition
-	bool bESPNotLoaded = false;                            // mod associated with this condition is not loaded.
-};
-
-struct ConditionLink
-{
-	std::string from_hkx_file;                             // animation file path to map FROM
-	std::string to_hkx_file;                               // animation file path to map TO
-	int32_t priority;                                      // condition link's priority
-	std::vector<ConditionLinkFunc> conditions;             // conditions to evaluate
-};
-// ------------------------------------------------
-
-class LinkData
-{
-public:
-	virtual int16_t getNewAnimIndex(RE::Actor* a_actor) = 0;
-};
-
-class BaseLinkData : public LinkData
-{
-public:
-	// key: actor base form ID, val: to_hkx_index
-	std::unordered_map<RE::FormID, uint16_t> allLinks;
-
-	int16_t getNewAnimIndex(RE::Actor* a_actor) override
-	{
-		const auto base = a_actor->GetActorBase();
-		if (base) {
-			// Try to find a mapped index for the
-			// given actor base form ID.
-			const auto search = allLinks.find(base->GetFormID());
-			if (search != allLinks.end()) {
-				return search->second;
-			}
-		}
-
-		return -1;
-	}
-};
-
-class ConditionLinkData : public LinkData
-{
-public:
-	std::vector<ConditionLinkFunc> conditions;
-	uint16_t to_hkx_index;
-
-private:
-	bool evaluateConditions(std::vector<ConditionLinkFunc> a_vecFuncData, RE::Actor* a_actor)
-	{
-		bool bTrueOr = false;    // If true the last evaluated expression was true || ...
-		bool bCond;
-
-		// Evaluate the chain of conditions.
-		for (auto& data : a_vecFuncData) {
-			if (bTrueOr) {
-				// Don't need to evaluate this expression.
-
-				// We have true || ... which evaluates to true,
-				// irrespective of what the second expression is.
-				// So don't waste time evaluating it. Move onto the next one.
-				if (data.bAnd) {
-					// This breaks our ability to avoid evaluating.
-					// We now have (true || ... && ...) == (true && ...)
-					bTrueOr = false;
-				}
-			} else {
-				// Need to evaluate this expression.
-				if (data.bESPNotLoaded) {
-					bCond = false;
-				} else {
-					bCond =
-						((bool(__fastcall*)(RE::Actor*, std::variant<uint32_t, float>*, uint32_t))data.funcPtr)
-						(a_actor, data.args.data(), data.bmArgIsFloat);
-				}
-
-				if (bCond == data.bNot) {
-					// We have either
-					//   !true or false
-					// both of which evaluate to false.
-					if (data.bAnd) {
-						// We have false && ...
-						// which always evaluates to false.
-						// No need to evaluate any further expressions.
-						return false;
-					}
-
-					// We have false || ...
-					// Need to evaluate the next expression.
-				} else {
-					// We have true (&& or ||) ...
-					// If we have true || ... we don't need
-					// to evaluate the next condition.
-					bTrueOr = !data.bAnd;
-				}
-			}
-		}
-
-		return true;
-	}
-
-public:
-	int16_t getNewAnimIndex(RE::Actor* a_actor) override
-	{
-		if (evaluateConditions(conditions, a_actor)) {
-			// Conditions evaluated to true, return the mapped index.
-			return to_hkx_index;
-		}
-
-		return -1;
-	}
-};
+// ============================================================================
+//                                 DARLink.h
+// ----------------------------------------------------------------------------
+// Part of the open-source Dynamic Animation Replacer (DARGH).
+//
+// Copyright (c) 2023 Nox Sidereum
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the �Software�), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is furnished
+// to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED �AS IS�, WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+// FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+// DEALINGS IN THE SOFTWARE.
+//
+// (The MIT License)
+// ============================================================================
+
+#pragma once
+
+#include "Conditions.h"
+#include "StaticConditions.h"
+
+// Used for actor base data (method 1) ------------
+struct ActorBaseLink
+{
+	std::string from_hkx_file;                             // animation file path to map FROM
+	std::string to_hkx_file;                               // animation file path to map TO
+	RE::FormID  actorBaseID{ 0 };                          // complete actor form ID: i.e. modIndex | (actor base)
+};
+// ------------------------------------------------
+
+// Used for condition data (method 2) -------------
+struct ConditionLinkFunc
+{
+	ConditionFunc funcPtr;                                 // function pointer
+	ConditionFuncID funcID;                                // function ID (index into the condition function table)
+	std::vector<std::variant<uint32_t, float>> args;       // function args: form IDs (unsigned ints) or floats
+	uint32_t bmArgIsFloat;                                 // bit mask - if the bit is set, the corresponding arg is a float.
+	bool bNot = false;                                     // result of this condition should be NOTed
+	bool bAnd = true;                                      // result of this condition should be ANDed with the next condition
+	bool bESPNotLoaded = false;                            // mod associated with this condition is not loaded.
+};
+
+struct ConditionLink
+{
+	std::string from_hkx_file;                             // animation file path to map FROM
+	std::string to_hkx_file;                               // animation file path to map TO
+	int32_t priority;                                      // condition link's priority
+	std::vector<ConditionLinkFunc> conditions;             // conditions to evaluate (emptied once pooled)
+	uint32_t chain = 0;                                    // index of the conditions' chain in the folder's ConditionPool
+};
+
+// All of a project folder's condition chains, packed into contiguous
+// structure-of-arrays storage once loading has finished, so that evaluating
+// a chain streams through a few arrays instead of chasing a heap-allocated
+// ConditionLinkFunc (and its args vector) per term.
+// Term i of the pool is described by ops[i], flags[i] and args[i]. Chain c
+// is made up of terms chainStart[c] up to (but not including) chainStart[c + 1].
+struct ConditionPool
+{
+	using Arg = std::variant<uint32_t, float>;
+
+	enum : uint8_t
+	{
+		kNot             = 1 << 0,    // result of the term should be NOTed
+		kAnd             = 1 << 1,    // result of the term should be ANDed with the next term
+		kESPNotLoaded    = 1 << 2,    // mod associated with the term is not loaded
+		kArgIsFloatShift = 4          // bits 4+: bmArgIsFloat
+	};
+
+	std::vector<ConditionFuncID> ops;
+	std::vector<uint8_t> flags;
+	std::vector<std::array<Arg, MAX_CONDITION_ARGS>> args;
+	std::vector<uint32_t> chainStart{ 0 };
+	std::vector<uint32_t> chainDeps;                       // per chain: StateDeps of all its terms
+	std::array<ConditionFunc, MAX_CONDITION_FUNCS> dispatch{};
+
+	// Set by splitStaticConditions (see StaticConditions.h). Per chain of the
+	// links: the chain holding its static part (NO_CHAIN if it has none), and
+	// the one holding the rest. Both are appended after the links' chains.
+	static constexpr uint32_t NO_CHAIN = ~0u;
+	std::vector<uint32_t> staticChain;
+	std::vector<uint32_t> dynamicChain;
+	std::unique_ptr<StaticChainCache> statics;             // null if no chain has a static part
+
+	uint32_t numTerms() const { return static_cast<uint32_t>(ops.size()); }
+	uint32_t numChains() const { return static_cast<uint32_t>(chainStart.size() - 1); }
+
+	std::size_t sizeInBytes() const
+	{
+		return ops.size() * sizeof(ConditionFuncID) +
+		       flags.size() * sizeof(uint8_t) +
+		       args.size() * sizeof(args[0]) +
+		       chainStart.size() * sizeof(uint32_t) +
+		       chainDeps.size() * sizeof(uint32_t) +
+		       (staticChain.size() + dynamicChain.size()) * sizeof(uint32_t) +
+		       sizeof(dispatch);
+	}
+
+	// Result of calling term 'a_term''s condition function, i.e. ignoring
+	// its kNot and kESPNotLoaded flags.
+	bool evaluateTerm(uint32_t a_term, RE::Actor* a_actor) const
+	{
+		return dispatch[static_cast<std::size_t>(ops[a_term])](a_actor, const_cast<Arg*>(args[a_term].data()), flags[a_term] >> kArgIsFloatShift);
+	}
+
+	bool evaluate(uint32_t a_chain, RE::Actor* a_actor) const
+	{
+		bool bTrueOr = false;    // If true the last evaluated expression was true || ...
+
+		// Evaluate the chain of conditions.
+		const uint32_t end = chainStart[a_chain + 1];
+		for (uint32_t i = chainStart[a_chain]; i < end; ++i) {
+			const uint8_t f = flags[i];
+			const bool bAnd = (f & kAnd) != 0;
+
+			if (bTrueOr) {
+				// We have true || ... which evaluates to true,
+				// irrespective of what the second expression is.
+				// So don't waste time evaluating it.
+				if (bAnd) {
+					// We now have (true || ... && ...) == (true && ...)
+					bTrueOr = false;
+				}
+				continue;
+			}
+
+			const bool bCond = (f & kESPNotLoaded) ? false : evaluateTerm(i, a_actor);
+
+			if (bCond == ((f & kNot) != 0)) {
+				// We have either !true or false.
+				if (bAnd) {
+					// We have false && ... which always evaluates to false.
+					return false;
+				}
+				// We have false || ... so evaluate the next expression.
+			} else {
+				// If we have true || ... we don't need
+				// to evaluate the next condition.
+				bTrueOr = !bAnd;
+			}
+		}
+
+		return true;
+	}
+};
+// ------------------------------------------------
+
+// Method 1 (actor base) mappings of a whole remap plan, in a single
+// open-addressing hash table (linear probing) keyed by
+// (from_hkx_index, actor base form ID), with the to_hkx_index as value.
+class ActorBaseTable
+{
+public:
+	// Adds a mapping, unless one already exists for this key (the first
+	// mapping added wins). Returns false if it already existed.
+	bool insert(uint32_t a_fromIndex, RE::FormID a_actorBaseID, uint16_t a_toIndex)
+	{
+		if ((count + 1) * 2 > keys.size()) {
+			rehash(keys.empty() ? 16 : keys.size() * 2);
+		}
+
+		const uint64_t key = makeKey(a_fromIndex, a_actorBaseID);
+		std::size_t slot = findSlot(key);
+		if (keys[slot] == key) {
+			return false;
+		}
+
+		keys[slot] = key;
+		values[slot] = a_toIndex;
+		++count;
+		return true;
+	}
+
+	// Returns the to_hkx_index for the key, or -1 if there isn't one.
+	int16_t find(uint32_t a_fromIndex, RE::FormID a_actorBaseID) const
+	{
+		if (count == 0) {
+			return -1;
+		}
+
+		const uint64_t key = makeKey(a_fromIndex, a_actorBaseID);
+		const std::size_t slot = findSlot(key);
+		return keys[slot] == key ? values[slot] : -1;
+	}
+
+	std::size_t size() const { return count; }
+	std::size_t sizeInBytes() const { return keys.size() * (sizeof(uint64_t) + sizeof(uint16_t)); }
+
+private:
+	static constexpr uint64_t EMPTY_KEY = ~0ull;       // (0xFFFFFFFF, 0xFFFFFFFF) is never a valid key
+
+	std::vector<uint64_t> keys;                        // capacity is always a power of 2
+	std::vector<uint16_t> values;
+	std::size_t count = 0;
+
+	static uint64_t makeKey(uint32_t a_fromIndex, RE::FormID a_actorBaseID)
+	{
+		return (static_cast<uint64_t>(a_fromIndex) << 32) | a_actorBaseID;
+	}
+
+	std::size_t findSlot(uint64_t a_key) const
+	{
+		// Returns the slot holding 'a_key', or else the empty slot where it would go.
+		// (splitmix64 finalizer, to spread consecutive form IDs and indices.)
+		uint64_t hash = a_key;
+		hash = (hash ^ (hash >> 30)) * 0xBF58476D1CE4E5B9ull;
+		hash = (hash ^ (hash >> 27)) * 0x94D049BB133111EBull;
+		hash ^= hash >> 31;
+
+		const std::size_t mask = keys.size() - 1;
+		std::size_t slot = hash & mask;
+		while (keys[slot] != a_key && keys[slot] != EMPTY_KEY) {
+			slot = (slot + 1) & mask;
+		}
+		return slot;
+	}
+
+	void rehash(std::size_t a_capacity)
+	{
+		const auto oldKeys = std::exchange(keys, std::vector<uint64_t>(a_capacity, EMPTY_KEY));
+		const auto oldValues = std::exchange(values, std::vector<uint16_t>(a_capacity));
+
+		for (std::size_t i = 0; i < oldKeys.size(); ++i) {
+			if (oldKeys[i] != EMPTY_KEY) {
+				const std::size_t slot = findSlot(oldKeys[i]);
+				keys[slot] = oldKeys[i];
+				values[slot] = oldValues[i];
+			}
+		}
+	}
+};
+
+class LinkData
+{
+public:
+	virtual ~LinkData() = default;
+	// 'a_staticChains' is the actor's StaticChainCache results for the
+	// folder's ConditionPool, or nullptr to evaluate conditions in full.
+	virtual int16_t getNewAnimIndex(RE::Actor* a_actor, uint32_t a_fromIndex, const uint64_t* a_staticChains) = 0;
+	// What game state the result of getNewAnimIndex depends on (StateDeps).
+	virtual uint32_t stateDeps() const = 0;
+};
+
+// A remap plan has a single BaseLinkData, which appears with priority 0 in
+// every from_hkx_index that has M1 mappings.
+class BaseLinkData : public LinkData
+{
+public:
+	ActorBaseTable allLinks;
+
+	int16_t getNewAnimIndex(RE::Actor* a_actor, uint32_t a_fromIndex, const uint64_t*) override
+	{
+		const auto base = a_actor->GetActorBase();
+		if (base) {
+			// Try to find a mapped index for the
+			// given actor base form ID.
+			return allLinks.find(a_fromIndex, base->GetFormID());
+		}
+
+		return -1;
+	}
+
+	uint32_t stateDeps() const override
+	{
+		return kDepActorBase;
+	}
+};
+
+class ConditionLinkData : public LinkData
+{
+public:
+	const ConditionPool* pool;
+	uint32_t chain;                                        // index of this link's chain in 'pool'
+	uint16_t to_hkx_index;
+
+	int16_t getNewAnimIndex(RE::Actor* a_actor, uint32_t, const uint64_t* a_staticChains) override
+	{
+		uint32_t toEvaluate = chain;
+		if (a_staticChains) {
+			if (!StaticChainCache::isTrue(a_staticChains, chain)) {
+				return -1;
+			}
+			toEvaluate = pool->dynamicChain[chain];
+		}
+
+		if (pool->evaluate(toEvaluate, a_actor)) {
+			// Conditions evaluated to true, return the mapped index.
+			return to_hkx_index;
+		}
+
+		return -1;
+	}
+
+	uint32_t stateDeps() const override
+	{
+		return pool->chainDeps[chain];
+	}
+};
@@ -0,0 +1,239 @@
+// ============================================================================
+//                                 DARPack.h
+// ----------------------------------------------------------------------------
+// Part of the open-source Dynamic Animation Replacer (DARGH).
+//
+// Copyright (c) 2023 Nox Sidereum
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the �Software�), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is furnished
+// to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED �AS IS�, WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+// FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+// DEALINGS IN THE SOFTWARE.
+//
+// (The MIT License)
+// ============================================================================
+
+#pragma once
+
+// ----------------------------------------------------------------------------
+// On-disk format of a .darpack file: a DynamicAnimationReplacer tree
+// precompiled by the darpack tool (tools/darpack). Packs sit in the project's
+// animations folder, loose or in an archive, one per mod if need be:
+//
+//     meshes\actors\(project folder)\animations\(mod).darpack
+//
+// The plugin loads every pack there after the loose tree; each M1 and M2
+// folder comes from the loose tree if it has it, else from the first pack
+// in name order that does.
+//
+// Everything is little-endian and referenced by offset from the start of the
+// file, so a pack is used in place once read. Form references are stored as
+// (plugin table index, ID without the load order index), so only the plugin
+// table needs resolving against the load order at load time.
+//
+// N.B. this header is shared with the darpack tool, so it must not depend on
+// CommonLibSSE (or the PCH).
+// ----------------------------------------------------------------------------
+
+#include <cstdint>
+#include <cstring>
+#include <span>
+
+namespace DARPack
+{
+	constexpr char     MAGIC[8] = { 'D', 'A', 'R', 'P', 'A', 'C', 'K', '\0' };
+	constexpr uint32_t VERSION = 1;
+	constexpr uint32_t NO_STRING = 0xFFFFFFFF;
+	constexpr const char* FILE_NAME = "DynamicAnimationReplacer.darpack";    // the tool's default output
+
+	// Where a table is in the file.
+	struct Table
+	{
+		uint32_t offset;                     // from the start of the file
+		uint32_t count;                      // number of records (bytes, for the string pool)
+	};
+
+	// A run of records in a table.
+	struct Range
+	{
+		uint32_t first;
+		uint32_t count;
+	};
+
+	struct Header
+	{
+		char     magic[8];
+		uint32_t version;
+		uint32_t fileSize;
+		Table    strings;                    // NUL-terminated strings, referenced by offset into the pool
+		Table    plugins;                    // uint32_t: string, plugin file name
+		Table    paths;                      // uint32_t: string, hkx file path relative to its folder
+		Table    actorBaseFolders;           // ActorBaseFolder
+		Table    priorityFolders;            // PriorityFolder
+		Table    terms;                      // Term
+		Table    args;                       // Arg
+	};
+
+	// DynamicAnimationReplacer\(esp name)\(actor base id)
+	struct ActorBaseFolder
+	{
+		uint32_t plugin;                     // index into the plugin table
+		uint32_t actorBaseID;                // without the load order index
+		uint32_t name;                       // string: folder name, i.e. the actor base ID as 8 hex digits
+		Range    paths;                      // the folder's hkx files
+	};
+
+	// DynamicAnimationReplacer\_CustomConditions\(priority)
+	struct PriorityFolder
+	{
+		int32_t  priority;
+		uint32_t name;                       // string: folder name
+		uint32_t errorLine;                  // string: the _conditions.txt line that failed to parse, or NO_STRING
+		Range    terms;                      // the parsed conditions
+		Range    paths;                      // the folder's hkx files
+	};
+
+	enum TermFlags : uint8_t
+	{
+		kNot = 1 << 0,                       // result of the condition should be NOTed
+		kAnd = 1 << 1                        // result of the condition should be ANDed with the next one
+	};
+
+	struct Term
+	{
+		uint32_t funcName;                   // string: condition function name
+		uint32_t flags;                      // TermFlags
+		Range    args;
+	};
+
+	enum class ArgKind : uint32_t
+	{
+		kForm,                               // "esp name" | formID
+		kFloat
+	};
+
+	struct Arg
+	{
+		ArgKind  kind;
+		uint32_t plugin;                     // kForm: index into the plugin table
+		uint32_t value;                      // kForm: form ID without the load order index, kFloat: the float's bits
+	};
+
+	static_assert(sizeof(Header) == 72 && sizeof(ActorBaseFolder) == 20 && sizeof(PriorityFolder) == 28 &&
+	              sizeof(Term) == 16 && sizeof(Arg) == 12, "DAR pack record layout changed: bump VERSION");
+
+	// A pack in memory. open() checks the header and every reference in the
+	// pack, after which the accessors can be used without further checks.
+	class View
+	{
+	public:
+		bool open(const char* a_data, std::size_t a_size)
+		{
+			if (a_size < sizeof(Header)) {
+				return false;
+			}
+
+			data = a_data;
+			size = a_size;
+			std::memcpy(&header, a_data, sizeof(Header));
+			if (std::memcmp(header.magic, MAGIC, sizeof(MAGIC)) != 0 || header.version != VERSION || header.fileSize != a_size) {
+				return false;
+			}
+
+			if (!isInFile(header.strings, 1) || header.strings.count == 0 || data[header.strings.offset + header.strings.count - 1] != '\0' ||
+				!isInFile(header.plugins, sizeof(uint32_t)) || !isInFile(header.paths, sizeof(uint32_t)) ||
+				!isInFile(header.actorBaseFolders, sizeof(ActorBaseFolder)) || !isInFile(header.priorityFolders, sizeof(PriorityFolder)) ||
+				!isInFile(header.terms, sizeof(Term)) || !isInFile(header.args, sizeof(Arg))) {
+				return false;
+			}
+
+			for (const auto name : plugins()) {
+				if (!isString(name)) {
+					return false;
+				}
+			}
+			for (const auto path : paths()) {
+				if (!isString(path)) {
+					return false;
+				}
+			}
+			for (const auto& folder : actorBaseFolders()) {
+				if (folder.plugin >= header.plugins.count || !isString(folder.name) || !isInTable(folder.paths, header.paths)) {
+					return false;
+				}
+			}
+			for (const auto& folder : priorityFolders()) {
+				if (!isString(folder.name) || (folder.errorLine != NO_STRING && !isString(folder.errorLine)) ||
+					!isInTable(folder.terms, header.terms) || !isInTable(folder.paths, header.paths)) {
+					return false;
+				}
+			}
+			for (const auto& term : terms()) {
+				if (!isString(term.funcName) || !isInTable(term.args, header.args)) {
+					return false;
+				}
+			}
+			for (const auto& arg : args()) {
+				// Reject kinds this version doesn't know, as well as bad plugin indices.
+				if (arg.kind == ArgKind::kForm ? arg.plugin >= header.plugins.count : arg.kind != ArgKind::kFloat) {
+					return false;
+				}
+			}
+
+			return true;
+		}
+
+		const char* string(uint32_t a_offset) const { return data + header.strings.offset + a_offset; }
+
+		std::span<const uint32_t> plugins() const { return table<uint32_t>(header.plugins); }
+		std::span<const uint32_t> paths() const { return table<uint32_t>(header.paths); }
+		std::span<const ActorBaseFolder> actorBaseFolders() const { return table<ActorBaseFolder>(header.actorBaseFolders); }
+		std::span<const PriorityFolder> priorityFolders() const { return table<PriorityFolder>(header.priorityFolders); }
+		std::span<const Term> terms() const { return table<Term>(header.terms); }
+		std::span<const Arg> args() const { return table<Arg>(header.args); }
+
+		template <class T>
+		static std::span<const T> slice(std::span<const T> a_table, Range a_range)
+		{
+			return a_table.subspan(a_range.first, a_range.count);
+		}
+
+	private:
+		const char* data = nullptr;
+		std::size_t size = 0;
+		Header      header{};
+
+		template <class T>
+		std::span<const T> table(const Table& a_table) const
+		{
+			// Tables are 4-byte aligned (checked in isInFile).
+			return { reinterpret_cast<const T*>(data + a_table.offset), a_table.count };
+		}
+
+		bool isInFile(const Table& a_table, std::size_t a_recordSize) const
+		{
+			return a_table.offset % 4 == 0 && a_table.offset <= size &&
+			       a_table.count <= (size - a_table.offset) / a_recordSize;
+		}
+
+		bool isString(uint32_t a_offset) const { return a_offset < header.strings.count; }
+
+		static bool isInTable(Range a_range, const Table& a_table)
+		{
+			return a_range.first <= a_table.count && a_range.count <= a_table.count - a_range.first;
+		}
+	};
+}
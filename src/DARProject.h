@@ -1,53 +1,90 @@
-// ============================================================================
-//                             DARProject.h
-// ----------------------------------------------------------------------------
-// Part of the open-source Dynamic Animation Replacer (DARGH).
-//
-// Copyright (c) 2023 Nox Sidereum
-//
-// Permission is hereby granted, free of charge, to any person obtaining a copy
-// of this software and associated documentation files (the �Software�), to deal
-// in the Software without restriction, including without limitation the rights
-// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
-// copies of the Software, and to permit persons to whom the Software is furnished
-// to do so, subject to the following conditions:
-//
-// The above copyright notice and this permission notice shall be included in
-// all copies or substantial portions of the Software.
-//
-// THE SOFTWARE IS PROVIDED �AS IS�, WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
-// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
-// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
-// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
-// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
-// FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
-// DEALINGS IN THE SOFTWARE.
-//
-// (The MIT License)
-// ============================================================================
-
-#pragma once
-
-#include "DARLink.h"
-
-struct DARProject
-{
-	// Maps from (from_hkx_index => ordered map with (priority => LinkData))
-	// N.B. higher numbers == higher priority so we want them to appear
-	// first when iterating, which is why we use the custom comparator
-	std::unordered_map<
-		uint32_t,
-		std::map<int, LinkData*, std::greater<int>>
-	> allLinks;
-	std::vector<ActorBaseLink> actorBaseLinks;
-	std::vector<ConditionLink> conditionLinks;
-	std::string projFolder;
-	RE::hkRefPtr<RE::hkbProjectData> projData{ nullptr };
-	bool animationsLoaded = false;
-};
-
-namespace DARGH
-{
-	void loadDARMaps_ActorBase(DARProject& a_darProj, std::string a_darDir);
-	void loadDARMaps_Conditional(DARProject& a_darProj, std::string a_darDir);
-}
+// ============================================================================
+//                             DARProject.h
+// ----------------------------------------------------------------------------
+// Part of the open-source Dynamic Animation Replacer (DARGH).
+//
+// Copyright (c) 2023 Nox Sidereum
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the �Software�), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is furnished
+// to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED �AS IS�, WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+// FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+// DEALINGS IN THE SOFTWARE.
+//
+// (The MIT License)
+// ============================================================================
+
+#pragma once
+
+#include "DARLink.h"
+#include "DARRemapPlan.h"
+#include "Usage.h"
+
+// DAR data loaded from one project folder's DynamicAnimationReplacer tree.
+// Projects that share a folder (e.g. DefaultMale.hkx and DefaultFemale.hkx)
+// all hold a reference to the same instance, so the tree is only scanned
+// and parsed once.
+struct DARFolderData
+{
+	std::vector<ActorBaseLink> actorBaseLinks;
+	std::vector<ConditionLink> conditionLinks;
+	// Indices into actorBaseLinks and conditionLinks, in load order, keyed
+	// by hashLowerASCII(from_hkx_file). Built once loading has finished.
+	std::unordered_map<uint64_t, std::vector<uint32_t>> actorBaseLinkIndex;
+	std::unordered_map<uint64_t, std::vector<uint32_t>> conditionLinkIndex;
+	// The conditions of every ConditionLink, packed once loading has finished.
+	ConditionPool conditionPool;
+	// Decision diagrams for the candidate lists (chain indices, highest
+	// priority first) of the FROM animation files with more than one
+	// mapping, if DecisionDiagrams is set (see DecisionDAG.h). Compiled
+	// once loading has finished; remap plans only look them up.
+	std::map<std::vector<uint32_t>, std::unique_ptr<DecisionDAG>> decisionDAGs;
+	// Remap plans built from these links, keyed by the fingerprint of the
+	// original animation names they were built from (see DARRemapPlan.h).
+	std::unordered_map<uint64_t, std::unique_ptr<DARRemapPlan>> remapPlans;
+	// How often each mapping wins, if UsageTelemetry is set (see Usage.h).
+	std::unique_ptr<DARGH::FolderUsage> usage;
+	std::string projFolder;
+};
+
+struct DARProject
+{
+	std::shared_ptr<DARFolderData> folderData;
+	// The plan most recently installed for 'projData'.
+	std::atomic<const DARRemapPlan*> remapPlan{ nullptr };
+	std::string projFolder;
+	RE::hkRefPtr<RE::hkbProjectData> projData{ nullptr };
+	bool animationsLoaded = false;
+	bool bTraced = true;                                   // listed in TraceProjects (see Trace.h)
+};
+
+namespace DARGH
+{
+	// The M1 and M2 folders already loaded for a project folder. The loose
+	// tree is loaded first, then the packs in name order, and each folder
+	// is only taken from the first of them that has it.
+	struct DARLoadedFolders
+	{
+		std::unordered_set<RE::FormID> actorBases;             // complete actor base form IDs
+		std::unordered_set<int32_t> priorities;
+	};
+
+	void loadDARMaps_ActorBase(DARFolderData& a_folderData, std::string a_darDir, DARLoadedFolders& a_loaded);
+	void loadDARMaps_Conditional(DARFolderData& a_folderData, std::string a_darDir, DARLoadedFolders& a_loaded);
+	void loadDARPacks(DARFolderData& a_folderData, const std::string& a_animDir, DARLoadedFolders& a_loaded);
+	void indexDARLinks(DARFolderData& a_folderData);
+	void buildConditionPool(DARFolderData& a_folderData);
+	void compileDecisionDAGs(DARFolderData& a_folderData);
+}
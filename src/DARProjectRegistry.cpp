@@ -1,88 +1,270 @@
-// ============================================================================
-//                           DARProjectRegistry.cpp
-// ----------------------------------------------------------------------------
-// Part of the open-source Dynamic Animation Replacer (DARGH).
-//
-// Copyright (c) 2023 Nox Sidereum
-//
-// Permission is hereby granted, free of charge, to any person obtaining a copy
-// of this software and associated documentation files (the �Software�), to deal
-// in the Software without restriction, including without limitation the rights
-// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
-// copies of the Software, and to permit persons to whom the Software is furnished
-// to do so, subject to the following conditions:
-//
-// The above copyright notice and this permission notice shall be included in
-// all copies or substantial portions of the Software.
-//
-// THE SOFTWARE IS PROVIDED �AS IS�, WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
-// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
-// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
-// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
-// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
-// FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
-// DEALINGS IN THE SOFTWARE.
-//
-// (The MIT License)
-// ============================================================================
-
-#include "DARProjectRegistry.h"
-
-namespace DARGH
-{
-	// The single DAR Project Registry, used to store all of our
-	// DAR map data.
-	std::map<std::string, DARProject> g_DARProjectRegistry;
-
-	// Whether the DAR data has been loaded into the registry yet.
-	// The data is loaded at runtime by the SKSE callback function.
-	bool g_isDARDataLoaded = false;
-
-	DARProject* getDARProject(RE::hkRefPtr<RE::hkbProjectData> a_projData)
-	{
-		// ====================================================================
-		//                         getDARProject
-		// --------------------------------------------------------------------
-		// Retrieves the first entry in our global project registry that
-		// points to 'projData'. If no entries are found, or if DAR data
-		// has not yet been loaded, returns NULL.
-		// --------------------------------------------------------------------
-		if (!a_projData || !g_isDARDataLoaded) {
-			return nullptr;
-		}
-
-		for (auto& [path, proj] : DARGH::g_DARProjectRegistry) {
-			if (proj.projData == a_projData) {
-				return &proj;
-			}
-		}
-
-		return nullptr;
-	}
-
-	void registerDARProject(std::string_view a_path)
-	{
-		// ====================================================================
-		//                        registerDARProject
-		// --------------------------------------------------------------------
-		// Initialise a new empty entry in our global project registry, with
-		// a key that is the parent directory of 'projectFilePath', if the
-		// entry doesn't already exist.
-		// ====================================================================
-		if (!a_path.empty()) {
-			std::string path{ a_path };
-			std::transform(path.begin(), path.end(), path.begin(), [](uint8_t c)
-				{ return static_cast<uint8_t>(std::tolower(c)); });
-
-			// Only register a new project entry if there isn't already
-			// one there.
-			if (!g_DARProjectRegistry.contains(path)) {
-				// Doesn't already exist in the map, so create and register
-				// a new entry.
-				DARProject darProj;
-				darProj.projFolder = path.substr(0, path.find_last_of("\\"));
-				g_DARProjectRegistry.insert({ path, darProj });
-			}
-		}
-	}
-}
\ No newline at end of file
+// ============================================================================
+//                           DARProjectRegistry.cpp
+// ----------------------------------------------------------------------------
+// Part of the open-source Dynamic Animation Replacer (DARGH).
+//
+// Copyright (c) 2023 Nox Sidereum
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the �Software�), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is furnished
+// to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED �AS IS�, WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+// FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+// DEALINGS IN THE SOFTWARE.
+//
+// (The MIT License)
+// ============================================================================
+
+#include "DARProjectRegistry.h"
+#include "Utilities.h"
+#include "Trace.h"
+
+namespace DARGH
+{
+	// The single DAR Project Registry, used to store all of our
+	// DAR map data.
+	std::map<std::string, DARProject> g_DARProjectRegistry;
+
+	// Entries in the registry above, keyed by hashLowerASCII(path).
+	std::unordered_map<uint64_t, std::pair<const std::string, DARProject>*> g_DARProjectIndex;
+
+	// The loaded DAR data, keyed by project folder. Each project in
+	// the registry above holds a reference to its folder's entry.
+	std::map<std::string, std::shared_ptr<DARFolderData>> g_DARFolderRegistry;
+
+	// Whether the DAR data has been loaded into the registry yet.
+	// The data is loaded at runtime on a background thread, started
+	// by the SKSE callback function.
+	std::atomic<bool> g_isDARDataLoaded = false;
+
+	// Readiness barrier for the background load.
+	std::atomic<bool> g_isDARDataLoading = false;
+	std::mutex g_loadMutex;
+	std::condition_variable g_loadCondition;
+
+	DARProject* getDARProject(const RE::hkRefPtr<RE::hkbProjectData>& a_projData)
+	{
+		// ====================================================================
+		//                         getDARProject
+		// --------------------------------------------------------------------
+		// Retrieves the first entry in our global project registry that
+		// points to 'projData'. If no entries are found, or if DAR data
+		// has not yet been loaded, returns NULL.
+		// --------------------------------------------------------------------
+		if (!a_projData || !g_isDARDataLoaded) {
+			return nullptr;
+		}
+
+		for (auto& [path, proj] : DARGH::g_DARProjectRegistry) {
+			if (proj.projData == a_projData) {
+				return &proj;
+			}
+		}
+
+		return nullptr;
+	}
+
+	int16_t chooseAnimIndex(const DARRemapPlan& plan, const DARRemapPlan::LinkMap& all_links,
+		int16_t from_hkx_index, RE::Actor* actor)
+	{
+		// ====================================================================
+		//                        chooseAnimIndex
+		// --------------------------------------------------------------------
+		// Queries each of 'all_links' (the potential mappings from
+		// 'from_hkx_index') in turn, in order of descending priority
+		// number (i.e. 345 is higher priority than 3), to see if it should
+		// be applied (the mapping will return -1 if NO, otherwise the new
+		// index). Stops on the first mapping that doesn't return -1 and
+		// returns that index. If they all return -1, returns -1.
+		// ====================================================================
+		int16_t to_hkx_index;
+
+		if (!plan.decisions.empty()) {
+			const auto decision = plan.decisions.find(from_hkx_index);
+			if (decision != plan.decisions.end()) {
+				// The links were compiled into a decision diagram, which
+				// finds the same link while evaluating fewer conditions.
+				to_hkx_index = decision->second.dag->evaluate(actor, from_hkx_index, decision->second.candidates.data());
+				trace(TraceCategory::kConditionEval, "getNewAnimIndex: decision diagram for index {} => {}", from_hkx_index, to_hkx_index);
+				return to_hkx_index;
+			}
+		}
+
+		// The static parts of the folder's conditions, evaluated once for
+		// every actor like this one (see StaticConditions.h).
+		const auto statics = plan.conditionPool ? plan.conditionPool->statics.get() : nullptr;
+		const uint64_t* staticChains = statics ? statics->find(actor) : nullptr;
+
+		// Return the new animation index of the first link data item in
+		// the map (over which we iterate in order from higher priority
+		// number to lower priority), that returns a valid index.
+		trace(TraceCategory::kConditionEval, "getNewAnimIndex: found potential mapping(s) for index {}", from_hkx_index);
+		for (auto& link : all_links)
+		{
+			trace(TraceCategory::kConditionEval, "getNewAnimIndex: apply map with priority {}...?", link.first);
+			auto& link_dat = link.second;
+			to_hkx_index = link_dat->getNewAnimIndex(actor, from_hkx_index, staticChains);
+			if (to_hkx_index != -1)
+			{
+				trace(TraceCategory::kConditionEval, "  => yes, new anim index = {}", to_hkx_index);
+				return to_hkx_index;
+			}
+			trace(TraceCategory::kConditionEval, "  => no");
+		}
+		trace(TraceCategory::kConditionEval, " => no applicable mappings.");
+		return -1;
+	}
+
+	int16_t getNewAnimIndex(DARProject* darProj, int16_t from_hkx_index, RE::Actor* actor)
+	{
+		// ====================================================================
+		//                        getNewAnimIndex
+		// --------------------------------------------------------------------
+		// Searches the project node for any potential mappings from
+		// 'from_hkx_index', and returns the index of the one to apply
+		// (see chooseAnimIndex). If no mappings found or none of them
+		// apply, returns -1.
+		// ====================================================================
+
+		// Try to find the orig index in the installed remap plan.
+		const auto plan = darProj->remapPlan.load(std::memory_order_acquire);
+		if (!plan) {
+			return -1;
+		}
+
+		const auto search = plan->allLinks.find(from_hkx_index);
+		if (search == plan->allLinks.end()) {
+			// Not found
+			return -1;
+		}
+
+		traceProject(darProj->bTraced);
+
+		const int16_t to_hkx_index = chooseAnimIndex(*plan, search->second, from_hkx_index, actor);
+		if (plan->usage) {
+			// Count the choice (see Usage.h).
+			plan->usage->record(from_hkx_index, to_hkx_index);
+		}
+		return to_hkx_index;
+	}
+
+	void registerDARProject(std::string_view a_path)
+	{
+		// ====================================================================
+		//                        registerDARProject
+		// --------------------------------------------------------------------
+		// Initialise a new empty entry in our global project registry, with
+		// a key that is the parent directory of 'projectFilePath', if the
+		// entry doesn't already exist. Projects with the same parent
+		// directory share one entry in the folder registry.
+		// ====================================================================
+		if (!a_path.empty()) {
+			std::string path{ a_path };
+			toLowerASCII(path);
+
+			// Only register a new project entry if there isn't already
+			// one there.
+			if (!g_DARProjectRegistry.contains(path)) {
+				// Doesn't already exist in the map, so create and register
+				// a new entry.
+				auto entry = g_DARProjectRegistry.try_emplace(path).first;
+				g_DARProjectIndex.insert({ hashLowerASCII(path), &*entry });
+
+				auto& darProj = entry->second;
+				darProj.projFolder = path.substr(0, path.find_last_of("\\"));
+				darProj.bTraced = isProjectTraced(darProj.projFolder);
+
+				auto& folderData = g_DARFolderRegistry[darProj.projFolder];
+				if (!folderData) {
+					folderData = std::make_shared<DARFolderData>();
+					folderData->projFolder = darProj.projFolder;
+				}
+				darProj.folderData = folderData;
+			}
+		}
+	}
+
+	std::pair<const std::string, DARProject>* findDARProject(std::string_view a_path)
+	{
+		// ====================================================================
+		//                          findDARProject
+		// --------------------------------------------------------------------
+		// Looks up the registry entry for the (lowercase) project file path
+		// 'a_path', by hash. Returns NULL if there isn't one.
+		// ====================================================================
+		const auto search = g_DARProjectIndex.find(hashLowerASCII(a_path));
+		if (search == g_DARProjectIndex.end() || search->second->first != a_path) {
+			return nullptr;
+		}
+
+		return search->second;
+	}
+
+	void loadDARDataAsync(std::function<void()> a_load)
+	{
+		// ====================================================================
+		//                         loadDARDataAsync
+		// --------------------------------------------------------------------
+		// Runs 'a_load' on a background thread, then publishes the registry
+		// (sets g_isDARDataLoaded) and releases anyone waiting in
+		// waitForDARData.
+		// ====================================================================
+		g_isDARDataLoading = true;
+
+		std::thread([load = std::move(a_load)]() {
+			const auto start = std::chrono::steady_clock::now();
+			load();
+			const std::chrono::duration<double, std::milli> elapsed =
+				std::chrono::steady_clock::now() - start;
+
+			{
+				std::lock_guard locker(g_loadMutex);
+				g_isDARDataLoaded.store(true, std::memory_order_release);
+			}
+			g_loadCondition.notify_all();
+
+			logs::info("loaded DAR data in {:.1f} ms (background)", elapsed.count());
+		}).detach();
+	}
+
+	bool waitForDARData()
+	{
+		// ====================================================================
+		//                          waitForDARData
+		// --------------------------------------------------------------------
+		// Returns true once the DAR data is loaded. If the background load
+		// is still running, blocks until it finishes and logs how long we
+		// had to wait. Returns false without waiting if no load has been
+		// started yet.
+		// ====================================================================
+		if (g_isDARDataLoaded.load(std::memory_order_acquire)) {
+			return true;
+		}
+
+		if (!g_isDARDataLoading) {
+			return false;
+		}
+
+		const auto start = std::chrono::steady_clock::now();
+		{
+			std::unique_lock locker(g_loadMutex);
+			g_loadCondition.wait(locker, [] { return g_isDARDataLoaded.load(std::memory_order_acquire); });
+		}
+		const std::chrono::duration<double, std::milli> waited =
+			std::chrono::steady_clock::now() - start;
+
+		logs::info("waited {:.1f} ms for DAR data to finish loading", waited.count());
+		return true;
+	}
+}
@@ -1,41 +1,45 @@
-// ============================================================================
-//                             DARProjectRegistry.h
-// ----------------------------------------------------------------------------
-// Part of the open-source Dynamic Animation Replacer (DARGH).
-//
-// Copyright (c) 2023 Nox Sidereum
-//
-// Permission is hereby granted, free of charge, to any person obtaining a copy
-// of this software and associated documentation files (the �Software�), to deal
-// in the Software without restriction, including without limitation the rights
-// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
-// copies of the Software, and to permit persons to whom the Software is furnished
-// to do so, subject to the following conditions:
-//
-// The above copyright notice and this permission notice shall be included in
-// all copies or substantial portions of the Software.
-//
-// THE SOFTWARE IS PROVIDED �AS IS�, WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
-// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
-// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
-// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
-// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
-// FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
-// DEALINGS IN THE SOFTWARE.
-//
-// (The MIT License)
-// ============================================================================
-
-#pragma once
-
-#include "DARProject.h"
-
-namespace DARGH
-{
-	extern bool g_isDARDataLoaded;
-	extern std::map<std::string, DARProject> g_DARProjectRegistry;
-
-	DARProject* getDARProject(RE::hkRefPtr<RE::hkbProjectData> a_projData);
-	void registerDARProject(std::string_view a_path);
-	int16_t getNewAnimIndex(DARProject* a_darProj, int16_t a_origAnimIndex, RE::Actor* a_actor);
-}
+// ============================================================================
+//                             DARProjectRegistry.h
+// ----------------------------------------------------------------------------
+// Part of the open-source Dynamic Animation Replacer (DARGH).
+//
+// Copyright (c) 2023 Nox Sidereum
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the �Software�), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is furnished
+// to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED �AS IS�, WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+// FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+// DEALINGS IN THE SOFTWARE.
+//
+// (The MIT License)
+// ============================================================================
+
+#pragma once
+
+#include "DARProject.h"
+
+namespace DARGH
+{
+	extern std::atomic<bool> g_isDARDataLoaded;
+	extern std::map<std::string, DARProject> g_DARProjectRegistry;
+	extern std::map<std::string, std::shared_ptr<DARFolderData>> g_DARFolderRegistry;
+
+	DARProject* getDARProject(const RE::hkRefPtr<RE::hkbProjectData>& a_projData);
+	void registerDARProject(std::string_view a_path);
+	std::pair<const std::string, DARProject>* findDARProject(std::string_view a_path);
+	void loadDARDataAsync(std::function<void()> a_load);
+	bool waitForDARData();
+	int16_t getNewAnimIndex(DARProject* a_darProj, int16_t a_origAnimIndex, RE::Actor* a_actor);
+}
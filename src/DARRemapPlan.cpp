@@ -0,0 +1,515 @@
+// ============================================================================
+//                              DARRemapPlan.cpp
+// ----------------------------------------------------------------------------
+// Part of the open-source Dynamic Animation Replacer (DARGH).
+//
+// Copyright (c) 2023 Nox Sidereum
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the �Software�), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is furnished
+// to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED �AS IS�, WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+// FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+// DEALINGS IN THE SOFTWARE.
+//
+// (The MIT License)
+// ============================================================================
+
+#include "DARRemapPlan.h"
+#include "DARProject.h"
+#include "Plugin.h"
+#include "Utilities.h"
+#include "Timing.h"
+
+// Temporary structures used when building a remap plan:
+
+// Actor base remappings (method 1)
+struct obj16_m1
+{
+	uint32_t        animIndex_orig;
+	::ActorBaseLink*  ActorBaseLink;               // qualified: the member hides the type
+};
+
+// Condition remappings (method 2)
+struct obj16_m2
+{
+	uint32_t        animIndex_orig;
+	::ConditionLink*  ConditionLink;
+};
+
+namespace DARGH
+{
+	// Guards the per-project plan caches. Characters can be generated
+	// on more than one thread.
+	RE::BSSpinLock g_remapPlanLock;
+
+	std::atomic<bool> g_ShownConditionError{ false };
+
+	uint64_t fingerprintAnimNames(const char* const* a_names, uint32_t a_count)
+	{
+		// ====================================================================
+		//                      fingerprintAnimNames
+		// --------------------------------------------------------------------
+		// 64-bit FNV-1a hash of the animation names, in order. Each name's
+		// terminating null is hashed too, so that e.g. {"ab", "c"} and
+		// {"a", "bc"} produce different fingerprints.
+		// ====================================================================
+		uint64_t hash = FNV1A_OFFSET_BASIS;
+		const auto mix = [&hash](uint8_t c) {
+			hash ^= c;
+			hash *= FNV1A_PRIME;
+		};
+
+		for (uint32_t i = 0; i < a_count; ++i) {
+			if (const char* name = a_names[i]) {
+				for (; *name; ++name) {
+					mix(static_cast<uint8_t>(*name));
+				}
+			} else {
+				// Distinguish a null name from an empty one.
+				mix(0xFF);
+			}
+			mix(0);
+		}
+
+		return hash;
+	}
+
+	std::string getReplacementFolder(const std::string& a_toHkx)
+	{
+		// Returns the two folders under DynamicAnimationReplacer that a TO
+		// animation file lives in, i.e. "(esp name)\(actor base id)" for M1
+		// or "_CustomConditions\(priority)" for M2.
+		constexpr auto prefix = "Animations\\DynamicAnimationReplacer\\"sv;
+		const auto start = prefix.size();
+		auto end = a_toHkx.find('\\', start);
+		if (end != std::string::npos) {
+			end = a_toHkx.find('\\', end + 1);
+		}
+		return a_toHkx.substr(start, end == std::string::npos ? std::string::npos : end - start);
+	}
+
+	void packByPriority(std::vector<obj16_m1>& a_m1data, std::vector<obj16_m2>& a_m2data,
+		uint32_t a_nSlots, std::string_view a_projFolder)
+	{
+		// ====================================================================
+		//                          packByPriority
+		// --------------------------------------------------------------------
+		// Used when the replacements don't all fit in the available slots.
+		// Keeps whole replacement folders, in descending priority order
+		// (M1 folders have priority 0), for as long as their distinct TO
+		// files fit in 'a_nSlots'. Lower priority folders that still fit
+		// after a larger one is dropped are kept. Removes the mappings of
+		// dropped folders from 'a_m1data' and 'a_m2data', and logs what
+		// fit and what was dropped.
+		// ====================================================================
+		struct Folder
+		{
+			std::string name;
+			int priority;
+			std::unordered_set<const void*> targets;
+			bool bKeep = false;
+		};
+
+		std::vector<Folder> folders;
+		std::unordered_map<std::string, std::size_t> folderIndex;
+		std::unordered_map<const void*, std::size_t> linkFolder;
+
+		const auto addTarget = [&](const void* a_link, const std::string& a_toHkx, int a_priority) {
+			auto name = getReplacementFolder(a_toHkx);
+			const auto [it, inserted] = folderIndex.try_emplace(name, folders.size());
+			if (inserted) {
+				folders.push_back({ std::move(name), a_priority });
+			}
+			folders[it->second].targets.insert(a_link);
+			linkFolder[a_link] = it->second;
+		};
+
+		for (auto& m1data : a_m1data) {
+			addTarget(m1data.ActorBaseLink, m1data.ActorBaseLink->to_hkx_file, 0);
+		}
+		for (auto& m2data : a_m2data) {
+			addTarget(m2data.ConditionLink, m2data.ConditionLink->to_hkx_file, m2data.ConditionLink->priority);
+		}
+
+		std::vector<Folder*> byPriority;
+		for (auto& folder : folders) {
+			byPriority.push_back(&folder);
+		}
+		std::stable_sort(byPriority.begin(), byPriority.end(),
+			[](const Folder* a_lhs, const Folder* a_rhs) { return a_lhs->priority > a_rhs->priority; });
+
+		uint32_t nUsed = 0;
+		uint32_t nKept = 0;
+		for (auto folder : byPriority) {
+			const auto nTargets = static_cast<uint32_t>(folder->targets.size());
+			if (nUsed + nTargets <= a_nSlots) {
+				folder->bKeep = true;
+				nUsed += nTargets;
+				++nKept;
+			}
+		}
+
+		logs::info("{}: packed {} of {} replacement folders by priority ({} / {} free slots used)",
+			a_projFolder, nKept, folders.size(), nUsed, a_nSlots);
+		for (auto folder : byPriority) {
+			logs::info("  {} {} ({} files, priority {})",
+				folder->bKeep ? "loaded " : "dropped", folder->name, folder->targets.size(), folder->priority);
+		}
+
+		std::erase_if(a_m1data, [&](const obj16_m1& a_data) { return !folders[linkFolder[a_data.ActorBaseLink]].bKeep; });
+		std::erase_if(a_m2data, [&](const obj16_m2& a_data) { return !folders[linkFolder[a_data.ConditionLink]].bKeep; });
+	}
+
+	void attachDecisions(DARRemapPlan& a_plan, const DARFolderData& a_folderData)
+	{
+		// ====================================================================
+		//                          attachDecisions
+		// --------------------------------------------------------------------
+		// Gives each from_hkx_index with more than one link the decision
+		// diagram (see DecisionDAG.h) compiled for its LinkMap's candidate
+		// chains when the folder was loaded, if there is one. Compiling is
+		// left to the loader thread, so this only costs a lookup per index.
+		// ====================================================================
+		std::vector<uint32_t> chains;
+
+		for (auto& [fromIndex, links] : a_plan.allLinks)
+		{
+			if (links.size() < 2) {
+				continue;
+			}
+
+			chains.clear();
+			for (auto& [priority, link] : links) {
+				chains.push_back(link == &a_plan.baseLinks ?
+					DecisionDAG::kActorBase :
+					static_cast<const ConditionLinkData*>(link)->chain);
+			}
+
+			const auto it = a_folderData.decisionDAGs.find(chains);
+			if (it == a_folderData.decisionDAGs.end()) {
+				continue;
+			}
+
+			auto& decision = a_plan.decisions[fromIndex];
+			decision.dag = it->second.get();
+			for (auto& [priority, link] : links) {
+				decision.candidates.push_back({ link, link == &a_plan.baseLinks ?
+					int16_t(-1) :
+					static_cast<int16_t>(static_cast<const ConditionLinkData*>(link)->to_hkx_index) });
+			}
+		}
+
+		if (!a_plan.decisions.empty()) {
+			logs::info("{}: decision diagrams for {} of {} replaced animations",
+				a_folderData.projFolder, a_plan.decisions.size(), a_plan.allLinks.size());
+		}
+	}
+
+	std::unique_ptr<DARRemapPlan> buildRemapPlan(DARFolderData& a_folderData,
+		const char* const* a_names, uint32_t a_count)
+	{
+		// ====================================================================
+		//                          buildRemapPlan
+		// --------------------------------------------------------------------
+		// Builds the new animation names array and the link data for the
+		// given project folder and original animation names. This is the work DAR
+		// does for every character it generates; we do it once per plan.
+		// ====================================================================
+		auto plan = std::make_unique<DARRemapPlan>();
+		plan->szAnimNames_Orig = a_count;
+
+		// ------------------------------------------------------------------------------
+		// Iterate over the animation names array, see what M1 and/or M2 mappings we have
+		// for each one, temporarily store those mappings in m1data and m2data vectors.
+		// ------------------------------------------------------------------------------
+		std::vector<obj16_m1> m1data_vec;
+		std::vector<obj16_m2> m2data_vec;
+		std::string animName_Orig;
+
+		for (uint32_t i = 0; i < a_count; ++i)
+		{
+			const std::string_view name = a_names[i] ? a_names[i] : "";
+			const auto hash = hashLowerASCII(name);
+			const auto m1Search = a_folderData.actorBaseLinkIndex.find(hash);
+			const auto m2Search = a_folderData.conditionLinkIndex.find(hash);
+			if (m1Search == a_folderData.actorBaseLinkIndex.end()
+				&& m2Search == a_folderData.conditionLinkIndex.end())
+			{
+				// No replacements for this animation.
+				continue;
+			}
+
+			animName_Orig.assign(name);
+			toLowerASCII(animName_Orig);
+
+			// Actor Base replacement animation files (M1).
+			if (m1Search != a_folderData.actorBaseLinkIndex.end())
+			{
+				for (const auto index : m1Search->second)
+				{
+					auto& pM1Obj = a_folderData.actorBaseLinks[index];
+					if (pM1Obj.from_hkx_file == animName_Orig)
+					{
+						m1data_vec.push_back({ i, &pM1Obj });
+					}
+				}
+			}
+
+			// Conditional replacement animation files (M2).
+			if (m2Search != a_folderData.conditionLinkIndex.end())
+			{
+				for (const auto index : m2Search->second)
+				{
+					auto& pM2Obj = a_folderData.conditionLinks[index];
+					if (pM2Obj.from_hkx_file == animName_Orig)
+					{
+						m2data_vec.push_back({ i, &pM2Obj });
+					}
+				}
+			}
+		}
+
+		// ------------------------------------------------------------------------------
+		// Calculate the total number of replacement animations.
+		// ------------------------------------------------------------------------------
+		const uint32_t szAnimNames_New = a_count + static_cast<uint32_t>(m2data_vec.size() + m1data_vec.size());
+		plan->szAnimNames_New = szAnimNames_New;
+
+		// No available slots for the replacement animations, so there is
+		// nothing to install.
+		if (a_count >= Plugin::MAX_ANIMATION_FILES) {
+			return plan;
+		}
+
+		// ------------------------------------------------------------------------------
+		// Lay out the names in 'namePool', recording each one's offset. Null names are
+		// recorded as npos. Offset 0 is the empty string shared by all the padding slots.
+		// Each name starts on a NAME_ALIGNMENT boundary: the names are installed as
+		// hkStringPtrs, whose bit 0 flags a string Havok owns (and would free).
+		// ------------------------------------------------------------------------------
+		constexpr auto npos = std::numeric_limits<std::size_t>::max();
+		const uint32_t szSlots = Plugin::MAX_ANIMATION_FILES - a_count;
+		std::vector<std::size_t> offsets(Plugin::MAX_ANIMATION_FILES, 0);
+		auto& pool = plan->namePool;
+		pool.push_back('\0');
+
+		const auto addName = [&pool](const char* a_name) -> std::size_t {
+			if (!a_name) {
+				return npos;
+			}
+			const auto offset = (pool.size() + DARRemapPlan::NAME_ALIGNMENT - 1) & ~(DARRemapPlan::NAME_ALIGNMENT - 1);
+			pool.resize(offset);
+			pool.insert(pool.end(), a_name, a_name + std::strlen(a_name) + 1);
+			return offset;
+		};
+
+		// If there are not enough slots to include all of the remappings,
+		// we leave the slots padded with empty strings and don't link any
+		// of them (we only do all or none)... unless the user has asked us
+		// to pack them by priority instead.
+		const bool bFits = szAnimNames_New < Plugin::MAX_ANIMATION_FILES;
+		const bool bPack = !bFits && Plugin::PACK_ANIMATIONS_BY_PRIORITY;
+		if (bPack) {
+			// Keep the same one slot of headroom DAR requires when everything fits.
+			packByPriority(m1data_vec, m2data_vec, szSlots - 1, a_folderData.projFolder);
+		}
+
+		if (bFits || bPack) {
+			// Allocates the next free slot to a TO animation file. When packing,
+			// a file mapped from more than one FROM index only takes one slot.
+			std::unordered_map<const void*, uint16_t> targetSlots;
+			uint16_t nextSlot = 0;
+
+			// Point the plan's usage counters at the folder's (see Usage.h).
+			const auto folderUsage = a_folderData.usage.get();
+			if (folderUsage) {
+				plan->usage = std::make_unique<PlanUsage>();
+				plan->usage->slotWins.resize(szSlots, nullptr);
+				plan->usage->choices.resize(Plugin::MAX_ANIMATION_FILES, nullptr);
+			}
+			const auto countUsage = [&](uint32_t a_fromIndex, uint16_t a_slot, UsageCounter& a_wins, const std::string& a_fromFile) {
+				plan->usage->slotWins[a_slot] = &a_wins;
+				auto& fromChoices = plan->usage->choices[a_fromIndex];
+				if (!fromChoices) {
+					fromChoices = &folderUsage->choices.at(hashLowerASCII(a_fromFile));
+				}
+			};
+			const auto slotFor = [&](const void* a_link, const std::string& a_toHkx) -> uint16_t {
+				if (bPack) {
+					const auto [it, inserted] = targetSlots.try_emplace(a_link, nextSlot);
+					if (!inserted) {
+						return it->second;
+					}
+				}
+				offsets[nextSlot] = addName(a_toHkx.c_str());
+				return nextSlot++;
+			};
+
+			// ==============================================
+			//      1. COPY ACTOR BASE MAPPINGS (M1)
+			// ==============================================
+			for (auto& m1data : m1data_vec)
+			{
+				const uint16_t destIndex = slotFor(m1data.ActorBaseLink, m1data.ActorBaseLink->to_hkx_file);
+
+				// Calculate a revised animation index for the original FROM animation name.
+				uint32_t fromAnimIndex_rev = szSlots + m1data.animIndex_orig;
+
+				// All M1 mappings share the plan's BaseLinkData object,
+				// which always has a priority of 0.
+				plan->allLinks[fromAnimIndex_rev].try_emplace(0, &plan->baseLinks);
+				plan->baseLinks.allLinks.insert(fromAnimIndex_rev, m1data.ActorBaseLink->actorBaseID, destIndex);
+
+				if (folderUsage) {
+					const auto linkIndex = m1data.ActorBaseLink - a_folderData.actorBaseLinks.data();
+					countUsage(fromAnimIndex_rev, destIndex, folderUsage->actorBaseWins[linkIndex], m1data.ActorBaseLink->from_hkx_file);
+				}
+			}
+
+			// ==============================================
+			//        2. COPY CONDITION MAPPINGS (M2)
+			// ==============================================
+			plan->conditionPool = &a_folderData.conditionPool;
+			for (auto& m2data : m2data_vec)
+			{
+				const uint16_t destIndex = slotFor(m2data.ConditionLink, m2data.ConditionLink->to_hkx_file);
+
+				// Calculate new animation index for the FROM animation name.
+				// And get the priority.
+				int priority = m2data.ConditionLink->priority;
+				uint32_t fromAnimIndex_rev = szSlots + m2data.animIndex_orig;
+
+				// ConditionLinkData can have any priority from -ve to +ve, except 0.
+				// Larger numbers mean greater priority (and thus their associated
+				// ConditionLinkData objects should appear earlier when iterating
+				// over the map).
+				auto oCLinkData = std::make_unique<ConditionLinkData>();
+				oCLinkData->pool = &a_folderData.conditionPool;
+				oCLinkData->chain = m2data.ConditionLink->chain;
+				oCLinkData->to_hkx_index = destIndex;
+
+				auto& oMap = plan->allLinks[fromAnimIndex_rev];
+				const auto [it, success] = oMap.insert({ priority, oCLinkData.get() });
+				if (success) {
+					plan->linkPool.push_back(std::move(oCLinkData));
+					if (folderUsage) {
+						const auto linkIndex = m2data.ConditionLink - a_folderData.conditionLinks.data();
+						countUsage(fromAnimIndex_rev, destIndex, folderUsage->conditionWins[linkIndex], m2data.ConditionLink->from_hkx_file);
+					}
+				} else if (!g_ShownConditionError.exchange(true)) {
+					logs::error("couldn't add conditions");
+				}
+			}
+		}
+
+		// ==============================================
+		//    3. COPY THE ORIGINAL FILE NAMES.
+		// ==============================================
+		for (uint32_t i = 0; i < a_count; ++i) {
+			offsets[szSlots + i] = addName(a_names[i]);
+		}
+
+		// ==============================================
+		//    4. RESOLVE THE OFFSETS INTO THE NAME POOL.
+		// ==============================================
+		// 'namePool' is complete, so its data pointer is now stable. (Its storage
+		// comes from operator new, which aligns it to at least NAME_ALIGNMENT.)
+		plan->animNames.resize(Plugin::MAX_ANIMATION_FILES);
+		for (uint32_t i = 0; i < Plugin::MAX_ANIMATION_FILES; ++i) {
+			plan->animNames[i] = offsets[i] == npos ? nullptr : pool.data() + offsets[i];
+			assert(reinterpret_cast<std::uintptr_t>(plan->animNames[i]) % DARRemapPlan::NAME_ALIGNMENT == 0);
+		}
+
+		// ==============================================
+		//    5. ATTACH THE LINKS' DECISION DIAGRAMS.
+		// ==============================================
+		if (!a_folderData.decisionDAGs.empty()) {
+			attachDecisions(*plan, a_folderData);
+		}
+
+		return plan;
+	}
+
+	const DARRemapPlan* getRemapPlan(DARProject& a_darProj, std::string_view a_projPath,
+		const char* const* a_names, uint32_t a_count)
+	{
+		// ====================================================================
+		//                          getRemapPlan
+		// --------------------------------------------------------------------
+		// Returns the remap plan for the given project and original animation
+		// names, building it on first use. Plans are owned by the project's
+		// folder data (and so shared with any other project using the same
+		// folder), and are never modified or freed once built.
+		// ====================================================================
+		auto& folderData = *a_darProj.folderData;
+		{
+			// If these names are already a plan's names array (i.e. the string
+			// data has been generated before), there is nothing to do.
+			RE::BSSpinLockGuard locker(g_remapPlanLock);
+			for (const auto& [key, existing] : folderData.remapPlans) {
+				if (!existing->animNames.empty() && existing->animNames.data() == a_names) {
+					return existing.get();
+				}
+			}
+		}
+
+		const auto fingerprint = fingerprintAnimNames(a_names, a_count);
+
+		RE::BSSpinLockGuard locker(g_remapPlanLock);
+		auto& plan = folderData.remapPlans[fingerprint];
+		if (!plan) {
+			PhaseTimer timer(Phase::kBuildRemapPlan, a_projPath);
+			plan = buildRemapPlan(folderData, a_names, a_count);
+			plan->fingerprint = fingerprint;
+		}
+
+		// ------------------------------------------------------------------------------
+		// Inform the user of the total number of animations, once per project. Also
+		// advise the user if we have breached the MAX_ANIMATION_FILES limit (by default
+		// this is 16384).
+		// ------------------------------------------------------------------------------
+		const uint32_t szAnimNames_New = plan->szAnimNames_New;
+		if (!a_darProj.animationsLoaded)
+		{
+			a_darProj.animationsLoaded = true;
+			if (szAnimNames_New <= Plugin::MAX_ANIMATION_FILES)
+			{
+				logs::info("{} / {} : {}",
+					szAnimNames_New, Plugin::MAX_ANIMATION_FILES, a_projPath);
+			}
+			else if (Plugin::PACK_ANIMATIONS_BY_PRIORITY)
+			{
+				// The user opted in to packing, so only log it (see packByPriority).
+				logs::info("Too many animation files, packed by priority. {} / {} : {}",
+					szAnimNames_New, Plugin::MAX_ANIMATION_FILES, a_projPath);
+			}
+			else
+			{
+				logs::info("Too many animation files. {} / {} : {}",
+					szAnimNames_New, Plugin::MAX_ANIMATION_FILES, a_projPath);
+
+				// Also display error via an in-game message box:
+				std::string msg = "Too many animation files.\n";
+				msg += std::to_string(szAnimNames_New);
+				msg += " / ";
+				msg += std::to_string(Plugin::MAX_ANIMATION_FILES);
+				msg += "\n";
+				RE::CreateMessage(msg.c_str(), 0, 0, 4, 10, "OK", 0);
+			}
+		}
+
+		return plan.get();
+	}
+}
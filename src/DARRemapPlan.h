@@ -0,0 +1,100 @@
+// ============================================================================
+//                               DARRemapPlan.h
+// ----------------------------------------------------------------------------
+// Part of the open-source Dynamic Animation Replacer (DARGH).
+//
+// Copyright (c) 2023 Nox Sidereum
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the �Software�), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is furnished
+// to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED �AS IS�, WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+// FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+// DEALINGS IN THE SOFTWARE.
+//
+// (The MIT License)
+// ============================================================================
+
+#pragma once
+
+#include "DARLink.h"
+#include "DecisionDAG.h"
+#include "Usage.h"
+
+struct DARProject;
+
+// ----------------------------------------------------------------------------
+// An immutable remapping of one project's animation names. The plan depends
+// only on the project's DAR links and on the original animation names, so it
+// is built once per distinct set of names (identified by 'fingerprint') and
+// then installed, by pointer, into every hkbCharacterStringData generated
+// from that project.
+//
+// Layout of 'animNames' (MAX_ANIMATION_FILES entries), as per DAR:
+//        (1) the M1 remapped animation file names
+//        (2) the M2 remapped animation file names
+//        (3) empty string padding
+//        (4) the original animation file names
+// ----------------------------------------------------------------------------
+struct DARRemapPlan
+{
+	using LinkMap = std::map<int, LinkData*, std::greater<int>>;
+
+	uint64_t fingerprint{ 0 };                             // hash of the original animation names
+	uint32_t szAnimNames_Orig{ 0 };                        // number of original animation names
+	uint32_t szAnimNames_New{ 0 };                         // original + M1 remaps + M2 remaps
+
+	// Maps from (from_hkx_index => ordered map with (priority => LinkData))
+	// N.B. higher numbers == higher priority so we want them to appear
+	// first when iterating, which is why we use the custom comparator
+	std::unordered_map<uint32_t, LinkMap> allLinks;
+
+	// All the M1 mappings (priority 0 in 'allLinks').
+	BaseLinkData baseLinks;
+
+	// The project folder's pool, which every ConditionLinkData evaluates.
+	const ConditionPool* conditionPool{ nullptr };
+
+	// The from_hkx_indexes whose LinkMap has a decision diagram (see
+	// DecisionDAG.h; owned by the folder data), with the LinkMap's LinkData
+	// in order.
+	struct Decision
+	{
+		const DecisionDAG* dag;
+		std::vector<DecisionCandidate> candidates;
+	};
+	std::unordered_map<uint32_t, Decision> decisions;
+
+	// Where to count the choices made with this plan, if UsageTelemetry
+	// is set (see Usage.h).
+	std::unique_ptr<DARGH::PlanUsage> usage;
+
+	// The new animation names array, or empty if the original names
+	// already fill every available slot (in which case nothing is installed).
+	std::vector<const char*> animNames;
+
+	// Alignment of every name in 'namePool'. They're installed as hkStringPtrs,
+	// which keep a flag in bit 0, so they must be at least 2-byte aligned.
+	static constexpr std::size_t NAME_ALIGNMENT = 8;
+
+	std::vector<char> namePool;                            // backing storage for 'animNames'
+	std::vector<std::unique_ptr<LinkData>> linkPool;       // owns the LinkData in 'allLinks'
+};
+
+namespace DARGH
+{
+	uint64_t fingerprintAnimNames(const char* const* a_names, uint32_t a_count);
+	const DARRemapPlan* getRemapPlan(DARProject& a_darProj, std::string_view a_projPath,
+		const char* const* a_names, uint32_t a_count);
+}
@@ -0,0 +1,145 @@
+// ============================================================================
+//                                 DarghAPI.h
+// ----------------------------------------------------------------------------
+// Part of the open-source Dynamic Animation Replacer (DARGH).
+//
+// Copyright (c) 2023 Nox Sidereum
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the �Software�), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is furnished
+// to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED �AS IS�, WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+// FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+// DEALINGS IN THE SOFTWARE.
+//
+// (The MIT License)
+// ============================================================================
+
+#pragma once
+
+// ----------------------------------------------------------------------------
+// API for other SKSE plugins.
+//
+// A plugin can add its own condition functions ("native predicates") for use
+// in _conditions.txt files, alongside DAR's. Copy this header into your
+// plugin and, once every plugin has been loaded (i.e. when handling
+// SKSE's kPostPostLoad or kInputLoaded message), send dargh one
+// RegisterPredicate message per function:
+//
+//     bool IsHoldingTorch(RE::Actor* a_actor, const DARGH_API::PredicateArg* a_args);
+//
+//     DARGH_API::RegisterPredicate msg{};
+//     msg.name = "IsHoldingTorch";
+//     msg.func = &IsHoldingTorch;
+//     msg.cost = DARGH_API::kCostLookup;
+//     msg.deps = DARGH_API::kDepEquipment;
+//     SKSE::GetMessagingInterface()->Dispatch(DARGH_API::kRegisterPredicate,
+//         &msg, sizeof(msg), DARGH_API::PLUGIN_NAME);
+//     if (msg.result != DARGH_API::kRegistered) { ... }
+//
+// Registration closes when the game's data has loaded (kDataLoaded), before
+// dargh parses any conditions. From then on the function table doesn't
+// change, so native predicates are called as directly as DAR's own.
+//
+// Native predicates are called concurrently from several threads, so they
+// must be thread-safe and must not block. They must also be pure functions
+// of the game state declared in 'deps': dargh uses it to decide when a
+// decision can be reused.
+// ----------------------------------------------------------------------------
+
+namespace RE
+{
+	class Actor;
+}
+
+namespace DARGH_API
+{
+	constexpr const char* PLUGIN_NAME = "dargh";
+	constexpr uint32_t INTERFACE_VERSION = 1;
+
+	// Message types (SKSE::MessagingInterface::Message::type).
+	enum : uint32_t
+	{
+		kRegisterPredicate = 0x44475031    // 'DGP1'
+	};
+
+	// The most arguments a predicate can take.
+	constexpr uint32_t MAX_PREDICATE_ARGS = 2;
+
+	// One argument, as written in _conditions.txt.
+	union PredicateArg
+	{
+		uint32_t formID;    // kArgForm: the form's (runtime) form ID
+		float    value;     // kArgGlobal: the direct value or the GlobalVariable's value
+	};
+
+	using PredicateFunc = bool (*)(RE::Actor* a_actor, const PredicateArg* a_args);
+
+	// Argument types: bit i of RegisterPredicate::argIsGlobal.
+	//   0 (kArgForm):   "esp name" | formID
+	//   1 (kArgGlobal): GlobalVariable, i.e. "esp name" | formID, or a float
+	enum ArgType : uint32_t
+	{
+		kArgForm   = 0,
+		kArgGlobal = 1
+	};
+
+	// Rough cost of a call.
+	enum Cost : uint32_t
+	{
+		kCostTrivial,      // reads a field or flag of the actor or a singleton
+		kCostLookup,       // form lookups and/or a few virtual calls
+		kCostScan          // iterates over a collection (inventory, effects, factions...)
+	};
+
+	// What game state the result depends on (bit mask).
+	enum Deps : uint32_t
+	{
+		kDepActorBase   = 1 << 0,    // actor base: sex, class, voice type, keywords...
+		kDepRace        = 1 << 1,
+		kDepEquipment   = 1 << 2,    // items in the actor's hands, selected power
+		kDepInventory   = 1 << 3,    // worn items
+		kDepActorState  = 1 << 4,    // moving, sneaking, in combat...
+		kDepActorValues = 1 << 5,    // actor values and level
+		kDepFactions    = 1 << 6,
+		kDepMagic       = 1 << 7,    // magic effects, spells, perks
+		kDepLocation    = 1 << 8,    // cell, worldspace, location
+		kDepWorld       = 1 << 9,    // weather, game time
+		kDepGlobals     = 1 << 10,   // GlobalVariable arguments
+		kDepRandom      = 1 << 11    // not a function of the game state at all
+	};
+
+	enum Result : uint32_t
+	{
+		kNotHandled,       // dargh isn't installed, or didn't get the message
+		kRegistered,
+		kClosed,           // sent after kDataLoaded
+		kBadVersion,
+		kBadArguments,     // no name or function, or too many arguments
+		kNameTaken,        // a DAR function or another plugin's predicate has this name
+		kTableFull
+	};
+
+	struct RegisterPredicate
+	{
+		uint32_t      version{ INTERFACE_VERSION };
+		const char*   name{ nullptr };     // copied; case sensitive, like DAR's functions
+		PredicateFunc func{ nullptr };
+		uint32_t      nArgs{ 0 };          // up to MAX_PREDICATE_ARGS
+		uint32_t      argIsGlobal{ 0 };    // bit i set: argument i is a kArgGlobal
+		uint32_t      cost{ kCostLookup };
+		uint32_t      deps{ 0 };
+		uint32_t      result{ kNotHandled };    // set by dargh
+	};
+}
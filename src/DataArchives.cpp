@@ -0,0 +1,204 @@
+// ============================================================================
+//                              DataArchives.cpp
+// ----------------------------------------------------------------------------
+// Part of the open-source Dynamic Animation Replacer (DARGH).
+//
+// Copyright (c) 2023 Nox Sidereum
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the �Software�), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is furnished
+// to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED �AS IS�, WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+// FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+// DEALINGS IN THE SOFTWARE.
+//
+// (The MIT License)
+// ============================================================================
+
+#include "DataArchives.h"
+#include "BSArchive.h"
+#include "Utilities.h"
+#include "Timing.h"
+
+namespace DARGH
+{
+	// In load order: later archives override earlier ones.
+	std::vector<std::unique_ptr<BSArchive>> g_dataArchives;
+
+	std::string getArchivePath(const std::string& a_path)
+	{
+		// "data\meshes\..." => "meshes\...", in lower case (as the
+		// archives' names are).
+		std::string path = startsWith(a_path, "data\\") || startsWith(a_path, "Data\\") ? a_path.substr(5) : a_path;
+		toLowerASCII(path);
+		return path;
+	}
+
+	std::vector<std::string> getLoadedArchiveNames()
+	{
+		// The archives the game loads, in order: those listed in its INI
+		// file, then each active plugin's own "<plugin name>.bsa".
+		std::vector<std::string> names;
+		const auto ini = RE::INISettingCollection::GetSingleton();
+		for (const auto key : { "sResourceArchiveList:Archive", "sResourceArchiveList2:Archive" }) {
+			const auto setting = ini ? ini->GetSetting(key) : nullptr;
+			const auto list = setting ? setting->GetString() : nullptr;
+			if (list) {
+				std::vector<std::string> listed;
+				splitOnCommas(listed, list);
+				for (const auto& name : listed) {
+					if (!trim(name).empty()) {
+						names.push_back(trim(name));
+					}
+				}
+			}
+		}
+
+		if (const auto dh = RE::TESDataHandler::GetSingleton()) {
+			for (const auto file : dh->files) {
+				if (file && file->compileIndex != 0xFF) {
+					const auto fileName = std::string(file->GetFilename());
+					names.push_back(fileName.substr(0, fileName.rfind('.')) + ".bsa");
+				}
+			}
+		}
+
+		return names;
+	}
+
+	void openDataArchives()
+	{
+		PhaseTimer timer(Phase::kOpenArchives);
+		g_dataArchives.clear();
+		for (const auto& name : getLoadedArchiveNames()) {
+			const auto path = "data\\" + name;
+			std::error_code ec;
+			if (!fs::exists(path, ec)) {
+				continue;
+			}
+
+			auto archive = std::make_unique<BSArchive>();
+			std::string error;
+			if (!archive->open(path, error)) {
+				logs::warn("couldn't read archive {}: {}", name, error);
+				continue;
+			}
+
+			// Only keep the archives with something for us: a loose-style
+			// tree, or a pack (see DARPack.h) in an animations folder.
+			bool bHasDARTree = false;
+			archive->forEachFolderUnder("meshes", [&](const BSArchive::Folder& a_folder) {
+				if (bHasDARTree || a_folder.name.find("\\dynamicanimationreplacer") != std::string::npos) {
+					bHasDARTree = true;
+					return;
+				}
+				if (a_folder.name.ends_with("\\animations")) {
+					for (const auto& file : archive->filesIn(a_folder)) {
+						bHasDARTree = bHasDARTree || archive->fileName(file).ends_with(".darpack");
+					}
+				}
+			});
+			if (bHasDARTree) {
+				logs::info("Reading DynamicAnimationReplacer folders from {} ({} folders, {} files).",
+					name, archive->numFolders(), archive->numFiles());
+				g_dataArchives.push_back(std::move(archive));
+			}
+		}
+	}
+
+	void closeDataArchives()
+	{
+		g_dataArchives.clear();
+	}
+
+	bool findDataFiles(std::string& a_dir, std::vector<std::string>& a_matches,
+	                   bool a_filterToExt, bool a_recursive, std::string a_ext)
+	{
+		PhaseTimer timer(Phase::kEnumerate);
+		bool bFound = findMatchingFiles(a_dir, a_matches, a_filterToExt, a_recursive, a_ext, ""s);
+		if (g_dataArchives.empty()) {
+			return bFound;
+		}
+
+		std::unordered_set<std::string> seen;
+		for (auto match : a_matches) {
+			toLowerASCII(match);
+			seen.insert(std::move(match));
+		}
+		const auto add = [&](std::string a_match) {
+			if (seen.insert(a_match).second) {
+				a_matches.push_back(std::move(a_match));
+			}
+		};
+
+		const auto dir = getArchivePath(a_dir);
+		toLowerASCII(a_ext);
+		for (const auto& archive : g_dataArchives) {
+			archive->forEachFolderUnder(dir, [&](const BSArchive::Folder& a_folder) {
+				bFound = true;
+
+				// The folder's path relative to 'dir' ("" for 'dir' itself).
+				const auto subDir = std::string_view(a_folder.name).substr(std::min(dir.size() + 1, a_folder.name.size()));
+				if (!a_filterToExt) {
+					// Subfolders. An archive only lists the folders that
+					// have files, so take their parents from their paths.
+					if (subDir.empty()) {
+						return;
+					}
+					if (!a_recursive) {
+						add(std::string(subDir.substr(0, subDir.find('\\'))));
+						return;
+					}
+					for (auto pos = subDir.find('\\'); pos != std::string_view::npos; pos = subDir.find('\\', pos + 1)) {
+						add(std::string(subDir.substr(0, pos)));
+					}
+					add(std::string(subDir));
+				} else if (a_recursive || subDir.empty()) {
+					for (const auto& file : archive->filesIn(a_folder)) {
+						const auto fileName = archive->fileName(file);
+						if (fileName.ends_with(a_ext)) {
+							add(subDir.empty() ? std::string(fileName) : std::format("{}\\{}", subDir, fileName));
+						}
+					}
+				}
+			});
+		}
+
+		return bFound;
+	}
+
+	bool readDataFile(const std::string& a_path, std::string& a_contents)
+	{
+		std::ifstream file(a_path, std::ios::binary);
+		if (file.is_open()) {
+			a_contents.assign(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+			return true;
+		}
+
+		const auto path = getArchivePath(a_path);
+		for (auto it = g_dataArchives.rbegin(); it != g_dataArchives.rend(); ++it) {
+			if (const auto archived = (*it)->findFile(path)) {
+				std::vector<char> contents;
+				if (!(*it)->read(*archived, contents)) {
+					logs::warn("couldn't read {} from archive {}", path, (*it)->path().filename().string());
+					return false;
+				}
+				a_contents.assign(contents.begin(), contents.end());
+				return true;
+			}
+		}
+
+		return false;
+	}
+}
@@ -0,0 +1,57 @@
+// ============================================================================
+//                               DataArchives.h
+// ----------------------------------------------------------------------------
+// Part of the open-source Dynamic Animation Replacer (DARGH).
+//
+// Copyright (c) 2023 Nox Sidereum
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the �Software�), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is furnished
+// to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED �AS IS�, WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+// FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+// DEALINGS IN THE SOFTWARE.
+//
+// (The MIT License)
+// ============================================================================
+
+#pragma once
+
+// ----------------------------------------------------------------------------
+// The Data folder as the game sees it while the DAR data loads: loose files,
+// plus the contents of the archives the game loads (see BSArchive.h). Mods
+// can then ship their DynamicAnimationReplacer trees inside a .bsa rather
+// than as thousands of loose files.
+//
+// As in the game, loose files override archived ones, and later archives
+// override earlier ones. The archives are only open while the DAR data is
+// loading (on the loader thread).
+// ----------------------------------------------------------------------------
+namespace DARGH
+{
+	// Opens those of the game's archives that contain DynamicAnimationReplacer
+	// trees, in load order.
+	void openDataArchives();
+	void closeDataArchives();
+
+	// As findMatchingFiles, but also returns matches from the open archives
+	// (lower case), without duplicating any loose ones. Returns false if
+	// 'a_dir' exists neither as a folder nor in an archive.
+	bool findDataFiles(std::string& a_dir, std::vector<std::string>& a_matches,
+	                   bool a_filterToExt, bool a_recursive, std::string a_ext);
+
+	// Reads a file, loose or from the open archives. 'a_path' is of the
+	// form "data\...".
+	bool readDataFile(const std::string& a_path, std::string& a_contents);
+}
@@ -0,0 +1,285 @@
+// ============================================================================
+//                              DecisionDAG.cpp
+// ----------------------------------------------------------------------------
+// Part of the open-source Dynamic Animation Replacer (DARGH).
+//
+// Copyright (c) 2023 Nox Sidereum
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the �Software�), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is furnished
+// to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED �AS IS�, WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+// FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+// DEALINGS IN THE SOFTWARE.
+//
+// (The MIT License)
+// ============================================================================
+
+#include "DecisionDAG.h"
+#include "Utilities.h"
+
+// ----------------------------------------------------------------------------
+// Compilation is a Shannon expansion of the candidate list. At each step the
+// next predicate to test is the one getNewAnimIndex would evaluate next, given
+// the values of the predicates already tested. Steps are memoised on
+// (candidate, values of the predicates the remaining candidates use), and the
+// nodes are hash-consed, so identical subdiagrams are shared and tests whose
+// branches lead to the same node are dropped.
+//
+// Each compiled chain is held in conjunctive normal form: the terms up to and
+// including each kAnd term form a clause, which is true if any of its terms
+// is. That is how ConditionPool::evaluate reads a chain; trailing terms without
+// kAnd leave the chain true whatever their values, so they're dropped.
+// ----------------------------------------------------------------------------
+
+class DecisionDAGCompiler
+{
+	// A set of predicates, or their values.
+	using Bits = std::vector<uint64_t>;
+
+	struct BitsHash
+	{
+		std::size_t operator()(const Bits& a_bits) const
+		{
+			uint64_t hash = FNV1A_OFFSET_BASIS;
+			for (const auto word : a_bits) {
+				hash = (hash ^ word) * FNV1A_PRIME;
+			}
+			return static_cast<std::size_t>(hash ^ (hash >> 32));
+		}
+	};
+
+	struct Literal
+	{
+		uint32_t predicate;
+		bool     bNot;
+	};
+
+	using Clause = std::vector<Literal>;
+
+	struct Candidate
+	{
+		bool bLeaf = false;                // queried in place (M1, or uses Random)
+		bool bNever = false;               // chain can never be true
+		std::vector<Clause> clauses;
+	};
+
+public:
+	DecisionDAGCompiler(const ConditionPool& a_pool, std::span<const uint32_t> a_chains) :
+		pool(a_pool)
+	{
+		// Split each chain into clauses of literals, interning its terms as
+		// predicates. Terms whose mod isn't loaded are constants.
+		std::map<std::array<uint32_t, 2 + 2 * MAX_CONDITION_ARGS>, uint32_t> predicateIDs;
+
+		for (const auto chain : a_chains) {
+			auto& candidate = candidates.emplace_back();
+			if (chain == DecisionDAG::kActorBase) {
+				candidate.bLeaf = true;
+				continue;
+			}
+
+			const uint32_t start = pool.chainStart[chain];
+			const uint32_t end = pool.chainStart[chain + 1];
+			for (uint32_t i = start; i < end; ++i) {
+				if (getConditionFunc(pool.ops[i]).deps & kDepRandom) {
+					candidate.bLeaf = true;
+				}
+			}
+			if (candidate.bLeaf) {
+				continue;
+			}
+
+			Clause clause;
+			bool bSatisfied = false;           // the clause has a constant true term
+			for (uint32_t i = start; i < end; ++i) {
+				const uint8_t f = pool.flags[i];
+				const bool bNot = (f & ConditionPool::kNot) != 0;
+
+				if (f & ConditionPool::kESPNotLoaded) {
+					// Evaluates to false, so the term is !bNot.
+					bSatisfied |= bNot;
+				} else {
+					std::array<uint32_t, 2 + 2 * MAX_CONDITION_ARGS> key{ static_cast<uint32_t>(pool.ops[i]),
+						static_cast<uint32_t>(f >> ConditionPool::kArgIsFloatShift) };
+					for (uint32_t a = 0; a < MAX_CONDITION_ARGS; ++a) {
+						const auto& arg = pool.args[i][a];
+						key[2 + 2 * a] = static_cast<uint32_t>(arg.index());
+						key[3 + 2 * a] = arg.index() == 0 ? std::get<uint32_t>(arg) : std::bit_cast<uint32_t>(std::get<float>(arg));
+					}
+
+					const auto [it, bNew] = predicateIDs.try_emplace(key, static_cast<uint32_t>(predicateTerms.size()));
+					if (bNew) {
+						predicateTerms.push_back(i);
+					}
+					clause.push_back({ it->second, bNot });
+					++nLiterals;
+				}
+
+				if (f & ConditionPool::kAnd) {
+					if (!bSatisfied) {
+						if (clause.empty()) {
+							// Every term of the clause is constant false.
+							candidate.bNever = true;
+						}
+						candidate.clauses.push_back(std::move(clause));
+					}
+					clause.clear();
+					bSatisfied = false;
+				}
+			}
+		}
+
+		nWords = (predicateTerms.size() + 63) / 64;
+
+		// The predicates used by each candidate and those after it.
+		suffix.assign(candidates.size() + 1, Bits(nWords, 0));
+		for (std::size_t k = candidates.size(); k-- > 0;) {
+			suffix[k] = suffix[k + 1];
+			for (auto& clause : candidates[k].clauses) {
+				for (auto& literal : clause) {
+					suffix[k][literal.predicate / 64] |= 1ull << (literal.predicate % 64);
+				}
+			}
+		}
+	}
+
+	std::unique_ptr<DecisionDAG> compile()
+	{
+		// There's nothing to gain unless some predicate appears more than once.
+		if (candidates.size() > std::numeric_limits<uint16_t>::max() || predicateTerms.size() == nLiterals) {
+			return nullptr;
+		}
+
+		dag = std::make_unique<DecisionDAG>();
+		dag->pool = &pool;
+		dag->nPredicates = static_cast<uint32_t>(predicateTerms.size());
+		dag->root = build(0, Bits(nWords, 0), Bits(nWords, 0));
+		if (bTooLarge) {
+			return nullptr;
+		}
+
+		dag->nodes.shrink_to_fit();
+		return std::move(dag);
+	}
+
+private:
+	const ConditionPool& pool;
+	std::vector<Candidate> candidates;
+	std::vector<uint32_t> predicateTerms;      // per predicate: a term of the pool that calls it
+	std::size_t nLiterals = 0;
+	std::size_t nWords = 0;
+	std::vector<Bits> suffix;
+
+	std::unique_ptr<DecisionDAG> dag;
+	std::unordered_map<Bits, uint32_t, BitsHash> states;
+	std::map<std::array<uint32_t, 5>, uint32_t> uniqueNodes;
+	bool bTooLarge = false;
+
+	static bool test(const Bits& a_bits, uint32_t a_predicate)
+	{
+		return (a_bits[a_predicate / 64] >> (a_predicate % 64)) & 1;
+	}
+
+	uint32_t makeNode(DecisionNode::Kind a_kind, uint32_t a_candidate, uint32_t a_arg, uint32_t a_next0, uint32_t a_next1)
+	{
+		const auto [it, bNew] = uniqueNodes.try_emplace({ a_kind, a_candidate, a_arg, a_next0, a_next1 },
+			static_cast<uint32_t>(dag->nodes.size()));
+		if (bNew) {
+			dag->nodes.push_back({ a_kind, static_cast<uint16_t>(a_candidate), a_arg, { a_next0, a_next1 } });
+		}
+		return it->second;
+	}
+
+	uint32_t build(uint32_t a_k, Bits a_known, Bits a_values)
+	{
+		// Returns the node that decides candidates a_k onwards, given the
+		// values of the 'a_known' predicates.
+
+		// Forget the predicates no remaining candidate uses.
+		for (std::size_t w = 0; w < nWords; ++w) {
+			a_known[w] &= suffix[a_k][w];
+			a_values[w] &= a_known[w];
+		}
+
+		Bits key;
+		key.reserve(1 + 2 * nWords);
+		key.push_back(a_k);
+		key.insert(key.end(), a_known.begin(), a_known.end());
+		key.insert(key.end(), a_values.begin(), a_values.end());
+		if (const auto it = states.find(key); it != states.end()) {
+			return it->second;
+		}
+		if (bTooLarge || states.size() >= DecisionDAG::MAX_STATES) {
+			bTooLarge = true;
+			return 0;
+		}
+
+		uint32_t node;
+		if (a_k == candidates.size()) {
+			node = makeNode(DecisionNode::kNoMatch, 0, 0, 0, 0);
+		} else if (const auto& candidate = candidates[a_k]; candidate.bLeaf) {
+			node = makeNode(DecisionNode::kLink, a_k, 0, build(a_k + 1, a_known, a_values), 0);
+		} else {
+			// Find the first term evaluate would evaluate whose value isn't
+			// known yet, unless the chain is already decided.
+			bool bFalse = candidate.bNever;
+			uint32_t next = ~0u;
+			for (auto& clause : candidate.clauses) {
+				bool bTrue = false;
+				uint32_t unknown = ~0u;
+				for (auto& literal : clause) {
+					if (!test(a_known, literal.predicate)) {
+						if (unknown == ~0u) {
+							unknown = literal.predicate;
+						}
+					} else if (test(a_values, literal.predicate) != literal.bNot) {
+						bTrue = true;
+						break;
+					}
+				}
+				if (bTrue) {
+					continue;
+				}
+				if (unknown == ~0u) {
+					bFalse = true;
+					break;
+				}
+				if (next == ~0u) {
+					next = unknown;
+				}
+			}
+
+			if (bFalse) {
+				node = build(a_k + 1, a_known, a_values);
+			} else if (next == ~0u) {
+				node = makeNode(DecisionNode::kMatch, a_k, 0, 0, 0);
+			} else {
+				a_known[next / 64] |= 1ull << (next % 64);
+				const uint32_t ifFalse = build(a_k, a_known, a_values);
+				a_values[next / 64] |= 1ull << (next % 64);
+				const uint32_t ifTrue = build(a_k, a_known, a_values);
+				node = ifFalse == ifTrue ? ifFalse : makeNode(DecisionNode::kTest, 0, predicateTerms[next], ifFalse, ifTrue);
+			}
+		}
+
+		states.emplace(std::move(key), node);
+		return node;
+	}
+};
+
+std::unique_ptr<DecisionDAG> DecisionDAG::compile(const ConditionPool& a_pool, std::span<const uint32_t> a_chains)
+{
+	return DecisionDAGCompiler(a_pool, a_chains).compile();
+}
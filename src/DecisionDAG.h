@@ -0,0 +1,134 @@
+// ============================================================================
+//                               DecisionDAG.h
+// ----------------------------------------------------------------------------
+// Part of the open-source Dynamic Animation Replacer (DARGH).
+//
+// Copyright (c) 2023 Nox Sidereum
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the �Software�), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is furnished
+// to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED �AS IS�, WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+// FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+// DEALINGS IN THE SOFTWARE.
+//
+// (The MIT License)
+// ============================================================================
+
+#pragma once
+
+#include "DARLink.h"
+
+// ----------------------------------------------------------------------------
+// The candidate mappings of one from_hkx_index (its LinkMap, in priority
+// order), compiled into a reduced decision diagram over the predicates that
+// their condition chains share.
+//
+// Two terms are the same predicate if they call the same condition function
+// with the same arguments; NOT is an attribute of the term, not the
+// predicate. Walking the diagram evaluates each predicate at most once, and
+// skips any candidate whose chain is already decided by the predicates
+// evaluated for higher priority candidates. Otherwise it evaluates the terms
+// in the order getNewAnimIndex would, so the first candidate (by priority)
+// whose chain is true still wins, exactly as when the LinkMap is walked.
+//
+// Candidates whose result isn't a pure function of the predicates (the M1
+// mappings, and chains that use Random) are kept as ordered leaves: the
+// candidate's LinkData is queried in place, in priority order, so even the
+// random numbers are drawn as before.
+//
+// Candidates are described by the index of their chain in the pool, or
+// kActorBase for the M1 mappings. Candidate lists that are the same, e.g.
+// every animation of one priority folder that no other folder replaces,
+// share one diagram.
+// ----------------------------------------------------------------------------
+
+struct DecisionNode
+{
+	enum Kind : uint8_t
+	{
+		kTest,             // evaluate pool term 'arg' (without its NOT), go to next[result]
+		kLink,             // query candidate's LinkData: if it maps, that's the result, else go to next[0]
+		kMatch,            // candidate's chain is true, so it maps
+		kNoMatch           // no candidate maps
+	};
+
+	Kind     kind;
+	uint16_t candidate;    // kLink, kMatch: position in the candidate list
+	uint32_t arg;          // kTest: term index in the pool
+	uint32_t next[2];      // kTest: [false, true]; kLink: [not mapped, unused]
+};
+
+// A candidate of a compiled from_hkx_index.
+struct DecisionCandidate
+{
+	LinkData* link;
+	int16_t   to_hkx_index;  // of a ConditionLinkData, for kMatch
+};
+
+class DecisionDAG
+{
+public:
+	static constexpr uint32_t kActorBase = ~0u;
+
+	// Don't let one candidate list take more than this many states to
+	// compile (each makes at most one node). Lists that do are left to be
+	// evaluated in sequence.
+	static constexpr std::size_t MAX_STATES = 4096;
+
+	// Compiles the candidate list 'a_chains', highest priority first.
+	// Returns null if there's nothing to gain over evaluating the
+	// candidates in sequence (no predicate is shared between them), or
+	// if the diagram would be too large.
+	static std::unique_ptr<DecisionDAG> compile(const ConditionPool& a_pool, std::span<const uint32_t> a_chains);
+
+	// As getNewAnimIndex, for 'a_candidates' (LinkData in the order given
+	// to compile).
+	int16_t evaluate(RE::Actor* a_actor, uint32_t a_fromIndex, const DecisionCandidate* a_candidates) const
+	{
+		const DecisionNode* node = &nodes[root];
+		for (;;) {
+			switch (node->kind) {
+			case DecisionNode::kTest:
+				node = &nodes[node->next[pool->evaluateTerm(node->arg, a_actor)]];
+				break;
+			case DecisionNode::kLink:
+				{
+					const auto index = a_candidates[node->candidate].link->getNewAnimIndex(a_actor, a_fromIndex, nullptr);
+					if (index != -1) {
+						return index;
+					}
+					node = &nodes[node->next[0]];
+				}
+				break;
+			case DecisionNode::kMatch:
+				return a_candidates[node->candidate].to_hkx_index;
+			default:
+				return -1;
+			}
+		}
+	}
+
+	std::size_t numNodes() const { return nodes.size(); }
+	uint32_t numPredicates() const { return nPredicates; }
+	std::size_t sizeInBytes() const { return nodes.size() * sizeof(DecisionNode); }
+
+private:
+	const ConditionPool* pool = nullptr;
+	std::vector<DecisionNode> nodes;
+	uint32_t root = 0;
+	uint32_t nPredicates = 0;
+
+	friend class DecisionDAGCompiler;
+};
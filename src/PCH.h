@@ -3,7 +3,9 @@
 #include <SKSE/SKSE.h>
 #include <RE/Skyrim.h>
 
+#include <condition_variable>
 #include <numbers>
+#include <thread>
 
 namespace logs = SKSE::log;
 namespace fs = std::filesystem;
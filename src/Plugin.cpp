@@ -29,15 +29,148 @@
 #include "Plugin.h"
 #include "DARProjectRegistry.h"
 #include "DARProject.h"
+#include "Prefetch.h"
+#include "WorldSnapshot.h"
 #include "Utilities.h"
+#include "Conditions.h"
+#include "DataArchives.h"
+#include "Timing.h"
+#include "Trace.h"
+#include "Usage.h"
 
 namespace Plugin
 {
+	void LoadDARData()
+	{
+		// --------------------------------------------------------------------
+		// Load applicable DAR mappings for the registered projects.
+		// Projects sharing a folder share the loaded data, so each
+		// folder is only loaded once. Trees may also be in the game's
+		// archives, which are only needed while loading.
+		// --------------------------------------------------------------------
+		DARGH::openDataArchives();
+		logs::info("DAR data load time per project folder:");
+		for (auto& [folder, folderData] : DARGH::g_DARFolderRegistry) {
+			const auto before = DARGH::getPhaseTotals();
+			{
+				// The folder's timer must stop before its timing is logged.
+				DARGH::PhaseTimer timer(DARGH::Phase::kLoadFolder, folder);
+				DARGH::TraceScope traceScope(DARGH::isProjectTraced(folder), false);
+				auto dir = std::format("data\\meshes\\{}\\animations\\DynamicAnimationReplacer", folder);
+
+				// ... i.e.
+				//     "data\meshes\actors\(project folder)\
+				//        animations\DynamicAnimationReplacer"
+
+				// Then any precompiled packs (see tools/darpack), for the
+				// folders the loose tree doesn't have:
+				//     "data\meshes\actors\(project folder)\
+				//        animations\(mod).darpack"
+				DARGH::DARLoadedFolders loaded;
+				DARGH::loadDARMaps_ActorBase(*folderData, dir, loaded);
+				DARGH::loadDARMaps_Conditional(*folderData, dir, loaded);
+				DARGH::loadDARPacks(*folderData, std::format("data\\meshes\\{}\\animations", folder), loaded);
+				DARGH::indexDARLinks(*folderData);
+				DARGH::buildConditionPool(*folderData);
+				if (COMPILE_DECISION_DIAGRAMS) {
+					DARGH::compileDecisionDAGs(*folderData);
+				}
+				if (RECORD_USAGE) {
+					DARGH::initFolderUsage(*folderData);
+				}
+			}
+			DARGH::logFolderTiming(folder, before);
+		}
+		DARGH::closeDataArchives();
+
+		// Classify the equippable forms for IsEquippedRightType and
+		// IsEquippedLeftType.
+		{
+			DARGH::PhaseTimer timer(DARGH::Phase::kResolveForms, "equipped item types");
+			buildEquippedTypeTable();
+		}
+
+		// Now that all the conditions are known, collect the world state
+		// they read, for the per-frame snapshot.
+		DARGH::buildWorldSnapshot();
+
+		// Carry on counting from where the last session left off.
+		if (RECORD_USAGE) {
+			DARGH::loadUsage();
+		}
+
+		DARGH::logTiming("DAR data load timing");
+	}
+
+	void HandleAPIMessage(SKSE::MessagingInterface::Message* a_msg)
+	{
+		// Handles messages from other plugins (see DarghAPI.h).
+		if (a_msg->type != DARGH_API::kRegisterPredicate ||
+			a_msg->dataLen < sizeof(DARGH_API::RegisterPredicate)) {
+			return;
+		}
+
+		auto request = static_cast<DARGH_API::RegisterPredicate*>(a_msg->data);
+		request->result = registerNativeCondition(*request);
+
+		const auto name = request->name ? request->name : "";
+		const auto sender = a_msg->sender ? a_msg->sender : "?";
+		if (request->result == DARGH_API::kRegistered) {
+			logs::info("Registered condition function {}() from {}.", name, sender);
+		} else {
+			logs::warn("Couldn't register condition function {}() from {} (error {}).", name, sender, request->result);
+		}
+	}
+
 	void HandleSKSEMessage(SKSE::MessagingInterface::Message* a_msg)
 	{
+		if (a_msg->type == SKSE::MessagingInterface::kPostLoad) {
+			// Every plugin has now been loaded, so we can listen to them all.
+			SKSE::GetMessagingInterface()->RegisterListener(nullptr, HandleAPIMessage);
+			return;
+		}
+
+		if (a_msg->type == SKSE::MessagingInterface::kPreLoadGame ||
+			a_msg->type == SKSE::MessagingInterface::kNewGame) {
+			// The forms created at runtime in the last game are gone, and
+			// their form IDs will be reused.
+			clearDynamicEquippedTypes();
+			if (RECORD_USAGE) {
+				if (a_msg->type == SKSE::MessagingInterface::kNewGame) {
+					DARGH::startPlayClock();
+				} else {
+					DARGH::stopPlayClock();
+				}
+			}
+			return;
+		}
+
+		if (a_msg->type == SKSE::MessagingInterface::kPostLoadGame) {
+			// By now the characters around the player have been generated,
+			// so the timings include their remapping.
+			DARGH::logTiming("Timing after loading a game");
+			if (RECORD_USAGE) {
+				DARGH::startPlayClock();
+			}
+			return;
+		}
+
+		if (a_msg->type == SKSE::MessagingInterface::kSaveGame) {
+			if (RECORD_USAGE) {
+				DARGH::saveUsage();
+			}
+			return;
+		}
+
 		if (a_msg->type != SKSE::MessagingInterface::kDataLoaded)
 			return;
 
+		// --------------------------------------------------------------------
+		//  0. No more condition functions can be registered: the conditions
+		//     are about to be parsed.
+		// --------------------------------------------------------------------
+		closeNativeConditions();
+
 		// --------------------------------------------------------------------
 		//  1. Get the data handler.
 		// --------------------------------------------------------------------
@@ -50,6 +183,7 @@ namespace Plugin
 		// --------------------------------------------------------------------
 		//  2. Register two projects (male & female) for each loaded race.
 		// --------------------------------------------------------------------
+		std::optional<DARGH::PhaseTimer> registerTimer(std::in_place, DARGH::Phase::kRegisterProjects);
 		const auto& races = dh->GetFormArray<RE::TESRace>();
 		for (const auto race : races) {
 			if (race) {
@@ -75,21 +209,22 @@ namespace Plugin
 				DARGH::registerDARProject(name);
 			}
 		}
+		registerTimer.reset();
 
 		// --------------------------------------------------------------------
-		//  4. Load applicable DAR mappings for the registered projects.
+		//  4. Load the DAR data in the background. The main menu doesn't
+		//     wait for it; GenAnimationHook does, should a character be
+		//     generated before it has finished.
 		// --------------------------------------------------------------------
-		for (auto& [path, proj] : DARGH::g_DARProjectRegistry) {
-			auto dir = std::format("data\\meshes\\{}\\animations\\DynamicAnimationReplacer", proj.projFolder);
-
-			// ... i.e.
-			//     "data\meshes\actors\(project folder)\
-			//        animations\DynamicAnimationReplacer"
+		DARGH::loadDARDataAsync(LoadDARData);
 
-			DARGH::loadDARMaps_ActorBase(proj, dir);
-			DARGH::loadDARMaps_Conditional(proj, dir);
+		// --------------------------------------------------------------------
+		//  5. Optionally, prefetch replacement animations as actors' state
+		//     changes (see PrefetchBudgetMB in the INI file).
+		// --------------------------------------------------------------------
+		if (PREFETCH_BUDGET_MB > 0) {
+			DARGH::startPrefetcher(std::size_t{ PREFETCH_BUDGET_MB } << 20, std::make_unique<FilePrefetchLoader>());
+			DARGH::registerPrefetchEvents();
 		}
-
-		DARGH::g_isDARDataLoaded = true;
 	}
 }
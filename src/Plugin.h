@@ -30,7 +30,30 @@
 
 namespace Plugin
 {
-	static uint32_t MAX_ANIMATION_FILES{ 16384 };
+	inline uint32_t MAX_ANIMATION_FILES{ 16384 };
+
+	// If the replacements don't all fit under MAX_ANIMATION_FILES, load as
+	// many as fit in descending priority order, rather than none of them.
+	inline bool PACK_ANIMATIONS_BY_PRIORITY{ false };
+
+	// If non-zero, prefetch the replacement animations that an actor's state
+	// changes make current, keeping at most this many MB prefetched.
+	inline uint32_t PREFETCH_BUDGET_MB{ 0 };
+
+	// If set, also write the load timings as a Chrome trace (see Timing.h).
+	inline bool WRITE_TIMING_TRACE{ false };
+
+	// If set, compile each animation's candidate mappings into a decision
+	// diagram over their shared conditions (see DecisionDAG.h).
+	inline bool COMPILE_DECISION_DIAGRAMS{ false };
+
+	// If set, evaluate the conditions that only depend on the actor's base
+	// and race once per kind of actor (see StaticConditions.h).
+	inline bool CACHE_STATIC_CONDITIONS{ false };
+
+	// If set, count how often each mapping wins, across sessions, and
+	// report those that never do (see Usage.h).
+	inline bool RECORD_USAGE{ false };
 
 	void HandleSKSEMessage(SKSE::MessagingInterface::Message* a_msg);
 }
\ No newline at end of file
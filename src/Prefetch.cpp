@@ -0,0 +1,395 @@
+// ============================================================================
+//                                Prefetch.cpp
+// ----------------------------------------------------------------------------
+// Part of the open-source Dynamic Animation Replacer (DARGH).
+//
+// Copyright (c) 2023 Nox Sidereum
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the �Software�), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is furnished
+// to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED �AS IS�, WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+// FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+// DEALINGS IN THE SOFTWARE.
+//
+// (The MIT License)
+// ============================================================================
+
+#include "Prefetch.h"
+#include "DARProjectRegistry.h"
+#include "Utilities.h"
+#include "Trace.h"
+
+using DARGH::TraceCategory;
+
+namespace
+{
+	struct PrefetchedFile
+	{
+		std::size_t size;
+		std::list<uint64_t>::iterator lruPos;
+	};
+
+	std::unique_ptr<AnimationPrefetchLoader> g_prefetchLoader;
+	std::atomic<std::size_t> g_prefetchBudget{ 0 };                  // 0 => prefetcher isn't running
+
+	// An actor whose replacements may have changed, and the game state
+	// (StateDeps) that changed.
+	struct ActorRequest
+	{
+		RE::ActorHandle actor;
+		uint32_t deps;
+	};
+
+	// Everything below is guarded by g_prefetchMutex.
+	// Files are keyed by prefetchKey().
+	std::mutex g_prefetchMutex;
+	std::condition_variable g_prefetchCondition;
+	std::vector<ActorRequest> g_frameRequests;                       // this frame's requests, one per actor
+	std::vector<ActorRequest> g_actorQueue;                          // requests of past frames, waiting for the worker
+	std::deque<std::pair<uint64_t, std::string>> g_prefetchQueue;    // files waiting to be prefetched
+	std::unordered_set<uint64_t> g_prefetchQueued;                   // keys in g_prefetchQueue
+	std::unordered_map<uint64_t, PrefetchedFile> g_prefetched;       // files prefetched, within budget
+	std::list<uint64_t> g_prefetchLRU;                               // g_prefetched, most recently used first
+	std::size_t g_prefetchedBytes = 0;
+	uint32_t g_nLoads = 0;
+	uint32_t g_nHits = 0;
+
+	uint64_t prefetchKey(const std::string& a_projFolder, const char* a_animName)
+	{
+		return hashLowerASCII(a_animName, hashLowerASCII(a_projFolder));
+	}
+
+	void addRequest(std::vector<ActorRequest>& a_requests, const ActorRequest& a_request)
+	{
+		// Coalesces requests for the same actor. There are only ever a few
+		// pending, so a linear search will do.
+		const auto search = std::find_if(a_requests.begin(), a_requests.end(),
+			[&](const ActorRequest& a_pending) { return a_pending.actor == a_request.actor; });
+		if (search != a_requests.end()) {
+			search->deps |= a_request.deps;
+		} else {
+			a_requests.push_back(a_request);
+		}
+	}
+
+	void evaluateForActor(RE::Actor* a_actor, uint32_t a_deps)
+	{
+		// --------------------------------------------------------------------
+		// Re-evaluates the mappings of the actor's behavior graphs that
+		// depend on the game state 'a_deps' (StateDeps), and queues the
+		// replacements that would now be used for prefetching.
+		// --------------------------------------------------------------------
+		if (!a_actor->Is(RE::FormType::ActorCharacter)) {
+			return;
+		}
+
+		RE::BSTSmartPointer<RE::BSAnimationGraphManager> manager;
+		if (!a_actor->GetAnimationGraphManager(manager) || !manager) {
+			return;
+		}
+
+		struct Candidate
+		{
+			uint64_t key;
+			const std::string* projFolder;
+			const char* animName;
+		};
+		std::vector<Candidate> candidates;
+
+		for (auto& graph : manager->graphs) {
+			if (!graph) {
+				continue;
+			}
+
+			const DARProject* darProj = DARGH::getDARProject(graph->characterInstance.projectData);
+			if (!darProj) {
+				continue;
+			}
+
+			const auto plan = darProj->remapPlan.load(std::memory_order_acquire);
+			if (!plan || plan->animNames.empty()) {
+				continue;
+			}
+
+			for (auto& [fromIndex, links] : plan->allLinks) {
+				const bool bAffected = std::any_of(links.begin(), links.end(),
+					[a_deps](const auto& a_link) { return (a_link.second->stateDeps() & a_deps) != 0; });
+				if (!bAffected) {
+					continue;
+				}
+
+				// Highest priority first, as in getNewAnimIndex.
+				for (auto& [priority, link] : links) {
+					const auto newIndex = link->getNewAnimIndex(a_actor, fromIndex, nullptr);
+					if (newIndex != -1) {
+						const char* animName = plan->animNames[newIndex];
+						if (animName && *animName) {
+							candidates.push_back({ prefetchKey(darProj->projFolder, animName), &darProj->projFolder, animName });
+						}
+						break;
+					}
+				}
+			}
+		}
+
+		if (candidates.empty()) {
+			return;
+		}
+
+		std::lock_guard locker(g_prefetchMutex);
+		for (auto& candidate : candidates) {
+			if (g_prefetched.contains(candidate.key) || !g_prefetchQueued.insert(candidate.key).second) {
+				continue;
+			}
+
+			DARGH::trace(TraceCategory::kPrefetch, "queueing {} for prefetch", candidate.animName);
+			g_prefetchQueue.emplace_back(candidate.key,
+				std::format("meshes\\{}\\{}", *candidate.projFolder, candidate.animName));
+		}
+	}
+
+	void prefetchWorker()
+	{
+		// --------------------------------------------------------------------
+		// Evaluates the actors requested in past frames, queueing the
+		// replacements they would now use, then prefetches queued files one
+		// at a time (going back to any new requests between files). N.B. the
+		// budget limits how much we bring in: once it's exceeded, the least
+		// recently used files are forgotten (and may be prefetched again
+		// later).
+		// --------------------------------------------------------------------
+		std::vector<ActorRequest> requests;
+		for (;;) {
+			std::pair<uint64_t, std::string> job;
+			{
+				std::unique_lock locker(g_prefetchMutex);
+				g_prefetchCondition.wait(locker, [] { return !g_actorQueue.empty() || !g_prefetchQueue.empty(); });
+				if (!g_actorQueue.empty()) {
+					requests.swap(g_actorQueue);
+				} else {
+					job = std::move(g_prefetchQueue.front());
+					g_prefetchQueue.pop_front();
+				}
+			}
+
+			if (!requests.empty()) {
+				for (const auto& request : requests) {
+					// The actor may have been unloaded since it was requested.
+					if (const auto actor = request.actor.get()) {
+						evaluateForActor(actor.get(), request.deps);
+					}
+				}
+				requests.clear();
+				continue;
+			}
+
+			const auto size = g_prefetchLoader->prefetch(job.second);
+
+			DARGH::trace(TraceCategory::kPrefetch, "prefetched {} ({} bytes)", job.second, size);
+
+			std::lock_guard locker(g_prefetchMutex);
+			g_prefetchQueued.erase(job.first);
+			if (size == 0 || size > g_prefetchBudget) {
+				continue;
+			}
+
+			while (g_prefetchedBytes + size > g_prefetchBudget && !g_prefetchLRU.empty()) {
+				const auto victim = g_prefetched.find(g_prefetchLRU.back());
+				g_prefetchedBytes -= victim->second.size;
+				g_prefetched.erase(victim);
+				g_prefetchLRU.pop_back();
+			}
+
+			g_prefetchLRU.push_front(job.first);
+			g_prefetched[job.first] = { size, g_prefetchLRU.begin() };
+			g_prefetchedBytes += size;
+		}
+	}
+
+	class PrefetchEventSink :
+		public RE::BSTEventSink<RE::TESEquipEvent>,
+		public RE::BSTEventSink<RE::TESCombatEvent>,
+		public RE::BSTEventSink<SKSE::ActionEvent>
+	{
+	public:
+		static PrefetchEventSink* GetSingleton()
+		{
+			static PrefetchEventSink singleton;
+			return &singleton;
+		}
+
+		RE::BSEventNotifyControl ProcessEvent(const RE::TESEquipEvent* a_event, RE::BSTEventSource<RE::TESEquipEvent>*) override
+		{
+			if (a_event && a_event->actor) {
+				DARGH::prefetchForActor(a_event->actor->As<RE::Actor>(), kDepEquipment | kDepInventory);
+			}
+			return RE::BSEventNotifyControl::kContinue;
+		}
+
+		RE::BSEventNotifyControl ProcessEvent(const RE::TESCombatEvent* a_event, RE::BSTEventSource<RE::TESCombatEvent>*) override
+		{
+			if (a_event && a_event->actor) {
+				DARGH::prefetchForActor(a_event->actor->As<RE::Actor>(), kDepActorState);
+			}
+			return RE::BSEventNotifyControl::kContinue;
+		}
+
+		RE::BSEventNotifyControl ProcessEvent(const SKSE::ActionEvent* a_event, RE::BSTEventSource<SKSE::ActionEvent>*) override
+		{
+			if (a_event &&
+				(a_event->type == SKSE::ActionEvent::Type::kBeginDraw ||
+				 a_event->type == SKSE::ActionEvent::Type::kBeginSheathe)) {
+				DARGH::prefetchForActor(a_event->actor, kDepActorState | kDepEquipment);
+			}
+			return RE::BSEventNotifyControl::kContinue;
+		}
+	};
+}
+
+std::size_t FilePrefetchLoader::prefetch(const std::string& a_path)
+{
+	// Only loose files can be read here; files packed in a BSA are skipped.
+	std::ifstream file("data\\" + a_path, std::ios::binary);
+	if (!file) {
+		return 0;
+	}
+
+	std::size_t nBytes = 0;
+	std::vector<char> buffer(64 * 1024);
+	while (file.read(buffer.data(), buffer.size()) || file.gcount() > 0) {
+		nBytes += file.gcount();
+	}
+
+	return nBytes;
+}
+
+namespace DARGH
+{
+	void startPrefetcher(std::size_t a_budgetBytes, std::unique_ptr<AnimationPrefetchLoader> a_loader)
+	{
+		// ====================================================================
+		//                          startPrefetcher
+		// --------------------------------------------------------------------
+		// Starts the background thread that prefetches replacement
+		// animations with 'a_loader', keeping at most 'a_budgetBytes'
+		// prefetched at a time.
+		// ====================================================================
+		if (g_prefetchBudget != 0 || a_budgetBytes == 0 || !a_loader) {
+			return;
+		}
+
+		g_prefetchLoader = std::move(a_loader);
+		g_prefetchBudget = a_budgetBytes;
+		std::thread(prefetchWorker).detach();
+
+		logs::info("prefetching replacement animations (budget: {} KB)", a_budgetBytes >> 10);
+	}
+
+	void registerPrefetchEvents()
+	{
+		// ====================================================================
+		//                      registerPrefetchEvents
+		// --------------------------------------------------------------------
+		// Prefetch whenever an actor's equipment, combat state or weapon
+		// state changes, as these commonly switch the replacements used.
+		// ====================================================================
+		const auto sink = PrefetchEventSink::GetSingleton();
+		if (const auto holder = RE::ScriptEventSourceHolder::GetSingleton()) {
+			holder->AddEventSink<RE::TESEquipEvent>(sink);
+			holder->AddEventSink<RE::TESCombatEvent>(sink);
+		}
+		if (const auto actionEvents = SKSE::GetActionEventSource()) {
+			actionEvents->AddEventSink(sink);
+		}
+	}
+
+	void prefetchForActor(RE::Actor* a_actor, uint32_t a_deps)
+	{
+		// ====================================================================
+		//                         prefetchForActor
+		// --------------------------------------------------------------------
+		// Requests that the mappings of the actor's behavior graphs that
+		// depend on the game state 'a_deps' (StateDeps) are re-evaluated,
+		// and the replacements that would now be used prefetched. Only
+		// queues the request: requests for the same actor in the same frame
+		// are combined, and flushPrefetchRequests hands them to the
+		// prefetcher's thread, which does the evaluation.
+		// ====================================================================
+		if (g_prefetchBudget == 0 || !a_actor || !g_isDARDataLoaded) {
+			return;
+		}
+
+		std::lock_guard locker(g_prefetchMutex);
+		addRequest(g_frameRequests, { a_actor->GetHandle(), a_deps });
+	}
+
+	void flushPrefetchRequests()
+	{
+		// ====================================================================
+		//                       flushPrefetchRequests
+		// --------------------------------------------------------------------
+		// Called once per frame, on the main thread. Hands this frame's
+		// requests to the prefetcher's thread.
+		// ====================================================================
+		if (g_prefetchBudget == 0) {
+			return;
+		}
+
+		{
+			std::lock_guard locker(g_prefetchMutex);
+			if (g_frameRequests.empty()) {
+				return;
+			}
+
+			for (const auto& request : g_frameRequests) {
+				addRequest(g_actorQueue, request);
+			}
+			g_frameRequests.clear();
+		}
+		g_prefetchCondition.notify_one();
+	}
+
+	void recordAnimationLoad(const DARProject* a_darProj, int16_t a_index)
+	{
+		// ====================================================================
+		//                        recordAnimationLoad
+		// --------------------------------------------------------------------
+		// Called when replacement animation 'a_index' is about to be loaded.
+		// Keeps count of how many of these loads had been prefetched.
+		// ====================================================================
+		if (g_prefetchBudget == 0) {
+			return;
+		}
+
+		const auto plan = a_darProj->remapPlan.load(std::memory_order_acquire);
+		if (!plan || a_index < 0 || static_cast<std::size_t>(a_index) >= plan->animNames.size() || !plan->animNames[a_index]) {
+			return;
+		}
+
+		const auto key = prefetchKey(a_darProj->projFolder, plan->animNames[a_index]);
+
+		std::lock_guard locker(g_prefetchMutex);
+		const auto search = g_prefetched.find(key);
+		if (search != g_prefetched.end()) {
+			++g_nHits;
+			g_prefetchLRU.splice(g_prefetchLRU.begin(), g_prefetchLRU, search->second.lruPos);
+		}
+
+		if (++g_nLoads % 256 == 0) {
+			logs::info("prefetch hit rate: {} / {} replacement loads ({:.1f}%), {} KB prefetched",
+				g_nHits, g_nLoads, 100.0 * g_nHits / g_nLoads, g_prefetchedBytes >> 10);
+		}
+	}
+}
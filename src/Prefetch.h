@@ -0,0 +1,64 @@
+// ============================================================================
+//                                 Prefetch.h
+// ----------------------------------------------------------------------------
+// Part of the open-source Dynamic Animation Replacer (DARGH).
+//
+// Copyright (c) 2023 Nox Sidereum
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the �Software�), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is furnished
+// to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED �AS IS�, WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+// FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+// DEALINGS IN THE SOFTWARE.
+//
+// (The MIT License)
+// ============================================================================
+
+#pragma once
+
+#include "DARProject.h"
+
+// ----------------------------------------------------------------------------
+// Brings an animation file in ahead of the synchronous load that
+// AnimationLoaderHook triggers when a replacement is first used. Abstracted
+// so that a stand-in loader can be used to measure the prefetch hit rate
+// outside of the game.
+// ----------------------------------------------------------------------------
+class AnimationPrefetchLoader
+{
+public:
+	virtual ~AnimationPrefetchLoader() = default;
+
+	// Prefetches the file at 'a_path' (relative to the Data folder).
+	// Returns the number of bytes brought in, or 0 if it couldn't be read.
+	virtual std::size_t prefetch(const std::string& a_path) = 0;
+};
+
+// Reads loose animation files once, so that the engine's own load of the
+// file is served from the OS file cache rather than the disk.
+class FilePrefetchLoader : public AnimationPrefetchLoader
+{
+public:
+	std::size_t prefetch(const std::string& a_path) override;
+};
+
+namespace DARGH
+{
+	void startPrefetcher(std::size_t a_budgetBytes, std::unique_ptr<AnimationPrefetchLoader> a_loader);
+	void registerPrefetchEvents();
+	void prefetchForActor(RE::Actor* a_actor, uint32_t a_deps);
+	void flushPrefetchRequests();
+	void recordAnimationLoad(const DARProject* a_darProj, int16_t a_index);
+}
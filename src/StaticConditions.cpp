@@ -0,0 +1,197 @@
+// ============================================================================
+//                            StaticConditions.cpp
+// ----------------------------------------------------------------------------
+// Part of the open-source Dynamic Animation Replacer (DARGH).
+//
+// Copyright (c) 2023 Nox Sidereum
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the �Software�), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is furnished
+// to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED �AS IS�, WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+// FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+// DEALINGS IN THE SOFTWARE.
+//
+// (The MIT License)
+// ============================================================================
+
+#include "StaticConditions.h"
+#include "DARLink.h"
+#include "Utilities.h"
+
+bool isStaticCondition(ConditionFuncID a_id)
+{
+	switch (a_id) {
+	case ConditionFuncID::kIsFemale:
+	case ConditionFuncID::kIsChild:
+	case ConditionFuncID::kIsUnique:
+	case ConditionFuncID::kIsActorBase:
+	case ConditionFuncID::kIsRace:
+	case ConditionFuncID::kIsClass:
+	case ConditionFuncID::kIsCombatStyle:
+	case ConditionFuncID::kIsVoiceType:
+		return true;
+	default:
+		return false;
+	}
+}
+
+bool getStaticKey(RE::Actor* a_actor, StaticKey& a_key)
+{
+	// N.B. the key is all the static conditions read, rather than just the
+	// actor base's form ID: the player's sex, race and voice type can be
+	// changed in the race menu, and the temporary bases of leveled actors
+	// (and their form IDs) are recycled.
+	const auto base = a_actor->GetActorBase();
+	if (!base) {
+		return false;
+	}
+
+	const auto formID = [](const RE::TESForm* a_form) { return a_form ? a_form->GetFormID() : 0; };
+	a_key.base = base->GetFormID();
+	a_key.race = formID(a_actor->GetRace());
+	a_key.npcClass = formID(base->npcClass);
+	a_key.combatStyle = formID(base->combatStyle);
+	a_key.voiceType = formID(base->voiceType);
+	a_key.flags = (base->IsFemale() ? StaticKey::kFemale : 0u) | (base->IsUnique() ? StaticKey::kUnique : 0u);
+	return true;
+}
+
+StaticChainCache::StaticChainCache(const ConditionPool& a_pool, uint32_t a_nChains) :
+	pool(a_pool),
+	nChains(a_nChains),
+	nWords((a_nChains + 63) / 64),
+	slots(std::make_unique<Slot[]>(MAX_KEYS)),
+	results(std::make_unique<uint64_t[]>(static_cast<std::size_t>(MAX_KEYS) * nWords))
+{
+}
+
+const uint64_t* StaticChainCache::find(RE::Actor* a_actor)
+{
+	StaticKey key;
+	if (!getStaticKey(a_actor, key)) {
+		return nullptr;
+	}
+
+	uint64_t hash = FNV1A_OFFSET_BASIS;
+	for (const uint32_t field : { key.base, key.race, key.npcClass, key.combatStyle, key.voiceType, key.flags }) {
+		hash = (hash ^ field) * FNV1A_PRIME;
+	}
+
+	constexpr std::size_t mask = MAX_KEYS - 1;
+	std::size_t slot = (hash ^ (hash >> 32)) & mask;
+	for (;;) {
+		auto& entry = slots[slot];
+		uint32_t state = entry.state.load(std::memory_order_acquire);
+		if (state == kEmpty) {
+			if (nKeys.load(std::memory_order_relaxed) >= MAX_KEYS / 4 * 3) {
+				return nullptr;
+			}
+			if (!entry.state.compare_exchange_strong(state, kFilling, std::memory_order_acquire)) {
+				// Another thread claimed it first: look at it again.
+				continue;
+			}
+			nKeys.fetch_add(1, std::memory_order_relaxed);
+			entry.key = key;
+			fill(slot, a_actor);
+			entry.state.store(kReady, std::memory_order_release);
+			return &results[slot * nWords];
+		}
+
+		if (state == kReady && entry.key == key) {
+			return &results[slot * nWords];
+		}
+
+		// Someone else's key, or one that's still being filled in (if that's
+		// this actor's key too, it ends up cached twice, which is harmless).
+		slot = (slot + 1) & mask;
+	}
+}
+
+void StaticChainCache::fill(std::size_t a_slot, RE::Actor* a_actor)
+{
+	uint64_t* out = &results[a_slot * nWords];
+	std::fill_n(out, nWords, 0);
+	for (uint32_t chain = 0; chain < nChains; ++chain) {
+		const uint32_t staticChain = pool.staticChain[chain];
+		if (staticChain == ConditionPool::NO_CHAIN || pool.evaluate(staticChain, a_actor)) {
+			out[chain / 64] |= 1ull << (chain % 64);
+		}
+	}
+}
+
+void splitStaticConditions(ConditionPool& a_pool)
+{
+	// N.B. Random draws are kept in order: a clause after the first one that
+	// draws a random number stays in the dynamic part, even if it's static,
+	// so skipping a chain on its static part never skips a draw that
+	// evaluating it in full would have made.
+	const uint32_t nChains = a_pool.numChains();
+	a_pool.staticChain.assign(nChains, ConditionPool::NO_CHAIN);
+	a_pool.dynamicChain.resize(nChains);
+
+	// Appends a chain made up of the terms in 'a_clauses' (as [begin, end) pairs).
+	const auto appendChain = [&a_pool](const std::vector<std::pair<uint32_t, uint32_t>>& a_clauses) {
+		uint32_t deps = kDepNone;
+		for (const auto& [begin, end] : a_clauses) {
+			for (uint32_t i = begin; i < end; ++i) {
+				deps |= getConditionFunc(a_pool.ops[i]).deps;
+				a_pool.ops.push_back(a_pool.ops[i]);
+				a_pool.flags.push_back(a_pool.flags[i]);
+				a_pool.args.push_back(a_pool.args[i]);
+			}
+		}
+		a_pool.chainStart.push_back(a_pool.numTerms());
+		a_pool.chainDeps.push_back(deps);
+		return a_pool.numChains() - 1;
+	};
+
+	std::vector<std::pair<uint32_t, uint32_t>> staticClauses;
+	std::vector<std::pair<uint32_t, uint32_t>> dynamicClauses;
+	for (uint32_t chain = 0; chain < nChains; ++chain) {
+		a_pool.dynamicChain[chain] = chain;
+
+		staticClauses.clear();
+		dynamicClauses.clear();
+		bool bRandom = false;
+		const uint32_t end = a_pool.chainStart[chain + 1];
+		for (uint32_t begin = a_pool.chainStart[chain]; begin < end;) {
+			// A clause is the terms up to and including the next kAnd term.
+			uint32_t clauseEnd = begin;
+			bool bStatic = !bRandom;
+			bool bAnd = false;
+			while (clauseEnd < end && !bAnd) {
+				const uint8_t flags = a_pool.flags[clauseEnd];
+				const auto op = a_pool.ops[clauseEnd];
+				bAnd = (flags & ConditionPool::kAnd) != 0;
+				bStatic = bStatic && ((flags & ConditionPool::kESPNotLoaded) || isStaticCondition(op));
+				bRandom = bRandom || (getConditionFunc(op).deps & kDepRandom);
+				++clauseEnd;
+			}
+
+			// Trailing terms without kAnd stay in the dynamic part, at its end.
+			(bStatic && bAnd ? staticClauses : dynamicClauses).emplace_back(begin, clauseEnd);
+			begin = clauseEnd;
+		}
+
+		if (!staticClauses.empty()) {
+			a_pool.staticChain[chain] = appendChain(staticClauses);
+			a_pool.dynamicChain[chain] = appendChain(dynamicClauses);
+		}
+	}
+
+	if (a_pool.numChains() > nChains) {
+		a_pool.statics = std::make_unique<StaticChainCache>(a_pool, nChains);
+	}
+}
@@ -0,0 +1,126 @@
+// ============================================================================
+//                             StaticConditions.h
+// ----------------------------------------------------------------------------
+// Part of the open-source Dynamic Animation Replacer (DARGH).
+//
+// Copyright (c) 2023 Nox Sidereum
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the �Software�), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is furnished
+// to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED �AS IS�, WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+// FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+// DEALINGS IN THE SOFTWARE.
+//
+// (The MIT License)
+// ============================================================================
+
+#pragma once
+
+#include "Conditions.h"
+
+struct ConditionPool;
+
+// ----------------------------------------------------------------------------
+// Static conditions are those that only read the actor's base and race:
+// IsFemale, IsChild, IsUnique, IsActorBase, IsRace, IsClass, IsCombatStyle
+// and IsVoiceType. Every actor with the same StaticKey gets the same result
+// from each of them, for as long as that key doesn't change.
+//
+// splitStaticConditions splits each chain of a folder's ConditionPool into a
+// static part (its clauses made only of static conditions) and a dynamic
+// part (the rest). A StaticChainCache evaluates the static parts of all the
+// chains once per StaticKey, and keeps the results as one bit per chain. So
+// a candidate whose static part is false is skipped on a single bit test,
+// and one whose static part is true only evaluates its dynamic part.
+// ----------------------------------------------------------------------------
+
+// Everything a static condition reads from an actor.
+struct StaticKey
+{
+	RE::FormID base;
+	RE::FormID race;
+	RE::FormID npcClass;
+	RE::FormID combatStyle;
+	RE::FormID voiceType;
+	uint32_t   flags;                                      // kFemale | kUnique
+
+	enum : uint32_t
+	{
+		kFemale = 1 << 0,
+		kUnique = 1 << 1
+	};
+
+	bool operator==(const StaticKey&) const = default;
+};
+
+bool isStaticCondition(ConditionFuncID a_id);
+
+// Fills in the actor's StaticKey. Returns false if it has no actor base.
+bool getStaticKey(RE::Actor* a_actor, StaticKey& a_key);
+
+// The results of the static parts of a pool's chains, per StaticKey, in a
+// fixed-size open-addressing table (linear probing) that's filled in on
+// first use. Lookups never lock: a thread claims an empty slot, fills it in,
+// and then publishes it (release), and other threads skip the slot until
+// they see it published (acquire). Once the table is 3/4 full, actors with
+// new keys aren't cached, and their chains are evaluated in full.
+class StaticChainCache
+{
+public:
+	static constexpr uint32_t MAX_KEYS = 1024;         // a power of 2
+
+	StaticChainCache(const ConditionPool& a_pool, uint32_t a_nChains);
+
+	// Returns the actor's static chain results (see isTrue), or nullptr if
+	// they can't be cached.
+	const uint64_t* find(RE::Actor* a_actor);
+
+	// Is the static part of chain 'a_chain' true, in results from find?
+	static bool isTrue(const uint64_t* a_results, uint32_t a_chain)
+	{
+		return (a_results[a_chain / 64] >> (a_chain % 64)) & 1;
+	}
+
+	uint32_t size() const { return nKeys.load(std::memory_order_relaxed); }
+	std::size_t sizeInBytes() const { return MAX_KEYS * (sizeof(Slot) + nWords * sizeof(uint64_t)); }
+
+private:
+	enum : uint32_t
+	{
+		kEmpty,
+		kFilling,
+		kReady
+	};
+
+	struct Slot
+	{
+		std::atomic<uint32_t> state{ kEmpty };
+		StaticKey key{};
+	};
+
+	const ConditionPool& pool;
+	uint32_t nChains;
+	uint32_t nWords;                                   // uint64_t words of results per key
+	std::unique_ptr<Slot[]> slots;
+	std::unique_ptr<uint64_t[]> results;               // nWords per slot
+	std::atomic<uint32_t> nKeys{ 0 };
+
+	void fill(std::size_t a_slot, RE::Actor* a_actor);
+};
+
+// Splits each chain of 'a_pool' into its static and dynamic parts (see
+// above), and creates the pool's StaticChainCache if any chain has a static
+// part.
+void splitStaticConditions(ConditionPool& a_pool);
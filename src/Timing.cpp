@@ -0,0 +1,208 @@
+// ============================================================================
+//                                 Timing.cpp
+// ----------------------------------------------------------------------------
+// Part of the open-source Dynamic Animation Replacer (DARGH).
+//
+// Copyright (c) 2023 Nox Sidereum
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the �Software�), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is furnished
+// to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED �AS IS�, WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+// FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+// DEALINGS IN THE SOFTWARE.
+//
+// (The MIT License)
+// ============================================================================
+
+#include "Timing.h"
+#include "Plugin.h"
+
+namespace DARGH
+{
+	constexpr std::array<const char*, static_cast<std::size_t>(Phase::kTotal)> PHASE_NAMES{
+		"register projects",
+		"open archives",
+		"load folder (other)",
+		"enumerate folders",
+		"parse _conditions.txt",
+		"resolve mods and forms",
+		"load .darpack",
+		"build links",
+		"remap characters",
+		"build remap plans"
+	};
+
+	struct PhaseStats
+	{
+		std::atomic<uint64_t> ns{ 0 };               // self time
+		std::atomic<uint64_t> calls{ 0 };
+		std::atomic<uint64_t> longestNs{ 0 };        // of a single call, including nested phases
+	};
+
+	std::array<PhaseStats, static_cast<std::size_t>(Phase::kTotal)> g_phaseStats;
+	thread_local PhaseTimer* t_currentTimer = nullptr;
+
+	// Trace events, if enabled. Timers are too coarse (a few thousand while
+	// loading, then one per character) for a lock to matter, but cap the
+	// number of events anyway.
+	struct TraceEvent
+	{
+		Phase       phase;
+		std::string detail;
+		uint32_t    threadID;
+		int64_t     start;
+		int64_t     duration;
+	};
+
+	constexpr std::size_t MAX_TRACE_EVENTS = 1 << 18;
+	std::mutex g_traceLock;
+	std::vector<TraceEvent> g_traceEvents;
+
+	const auto g_clockEpoch = std::chrono::steady_clock::now();
+	std::atomic<uint32_t> g_nextThreadID{ 0 };
+	thread_local const uint32_t t_threadID = ++g_nextThreadID;
+
+	int64_t nowNs()
+	{
+		return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - g_clockEpoch).count();
+	}
+
+	PhaseTimer::PhaseTimer(Phase a_phase, std::string_view a_detail) :
+		phase(a_phase),
+		detail(a_detail),
+		parent(t_currentTimer),
+		start(nowNs())
+	{
+		t_currentTimer = this;
+	}
+
+	PhaseTimer::~PhaseTimer()
+	{
+		const int64_t elapsed = nowNs() - start;
+		t_currentTimer = parent;
+		if (parent) {
+			parent->childNs += elapsed;
+		}
+
+		auto& stats = g_phaseStats[static_cast<std::size_t>(phase)];
+		stats.ns.fetch_add(static_cast<uint64_t>(std::max<int64_t>(elapsed - childNs, 0)), std::memory_order_relaxed);
+		stats.calls.fetch_add(1, std::memory_order_relaxed);
+		uint64_t longest = stats.longestNs.load(std::memory_order_relaxed);
+		while (static_cast<uint64_t>(elapsed) > longest &&
+			   !stats.longestNs.compare_exchange_weak(longest, static_cast<uint64_t>(elapsed), std::memory_order_relaxed)) {
+		}
+
+		if (Plugin::WRITE_TIMING_TRACE) {
+			std::lock_guard locker(g_traceLock);
+			if (g_traceEvents.size() < MAX_TRACE_EVENTS) {
+				g_traceEvents.push_back({ phase, std::string(detail), t_threadID, start, elapsed });
+			}
+		}
+	}
+
+	PhaseTotals getPhaseTotals()
+	{
+		PhaseTotals totals;
+		for (std::size_t i = 0; i < totals.size(); ++i) {
+			totals[i] = g_phaseStats[i].ns.load(std::memory_order_relaxed);
+		}
+		return totals;
+	}
+
+	void logFolderTiming(const std::string& a_folder, const PhaseTotals& a_before)
+	{
+		const auto after = getPhaseTotals();
+		std::string line;
+		uint64_t totalNs = 0;
+		for (std::size_t i = 0; i < after.size(); ++i) {
+			const auto ns = after[i] - a_before[i];
+			if (ns > 0) {
+				line += std::format("{}{} {:.2f}", line.empty() ? "" : ", ", PHASE_NAMES[i], ns / 1e6);
+				totalNs += ns;
+			}
+		}
+		logs::info("  {}: {:.2f} ms ({})", a_folder, totalNs / 1e6, line);
+	}
+
+	void writeTrace()
+	{
+		// ====================================================================
+		//                            writeTrace
+		// --------------------------------------------------------------------
+		// Writes the events recorded so far as a Chrome trace (the JSON
+		// "trace event format"), one complete ("X") event per timer.
+		// ====================================================================
+		const auto dir = logs::log_directory();
+		if (!dir) {
+			return;
+		}
+
+		std::vector<TraceEvent> events;
+		{
+			std::lock_guard locker(g_traceLock);
+			events = g_traceEvents;
+		}
+
+		const auto path = *dir / "dargh_trace.json";
+		std::ofstream file(path, std::ios::trunc);
+		if (!file.is_open()) {
+			logs::warn("couldn't write {}", path.string());
+			return;
+		}
+
+		const auto escape = [](const std::string& a_text) {
+			std::string escaped;
+			for (const char c : a_text) {
+				if (c == '\\' || c == '"') {
+					escaped.push_back('\\');
+				}
+				escaped.push_back(c);
+			}
+			return escaped;
+		};
+
+		file << "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n";
+		for (std::size_t i = 0; i < events.size(); ++i) {
+			const auto& event = events[i];
+			file << std::format("{{\"name\":\"{}\",\"cat\":\"dargh\",\"ph\":\"X\",\"pid\":1,\"tid\":{},\"ts\":{:.3f},\"dur\":{:.3f}",
+				PHASE_NAMES[static_cast<std::size_t>(event.phase)], event.threadID, event.start / 1e3, event.duration / 1e3);
+			if (!event.detail.empty()) {
+				file << std::format(",\"args\":{{\"detail\":\"{}\"}}", escape(event.detail));
+			}
+			file << (i + 1 < events.size() ? "},\n" : "}\n");
+		}
+		file << "]}\n";
+
+		logs::info("wrote {} timing events to {}", events.size(), path.string());
+	}
+
+	void logTiming(const char* a_title)
+	{
+		logs::info("{} (self time, excluding nested phases):", a_title);
+		logs::info("  {:<24} {:>8} {:>12} {:>12}", "phase", "calls", "total ms", "longest ms");
+		for (std::size_t i = 0; i < g_phaseStats.size(); ++i) {
+			const auto& stats = g_phaseStats[i];
+			const auto calls = stats.calls.load(std::memory_order_relaxed);
+			if (calls > 0) {
+				logs::info("  {:<24} {:>8} {:>12.2f} {:>12.2f}", PHASE_NAMES[i], calls,
+					stats.ns.load(std::memory_order_relaxed) / 1e6, stats.longestNs.load(std::memory_order_relaxed) / 1e6);
+			}
+		}
+
+		if (Plugin::WRITE_TIMING_TRACE) {
+			writeTrace();
+		}
+	}
+}
@@ -0,0 +1,91 @@
+// ============================================================================
+//                                  Timing.h
+// ----------------------------------------------------------------------------
+// Part of the open-source Dynamic Animation Replacer (DARGH).
+//
+// Copyright (c) 2023 Nox Sidereum
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the �Software�), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is furnished
+// to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED �AS IS�, WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+// FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+// DEALINGS IN THE SOFTWARE.
+//
+// (The MIT License)
+// ============================================================================
+
+#pragma once
+
+// ----------------------------------------------------------------------------
+// Where the time goes while loading the DAR data, and while remapping each
+// character's animations (GenAnimationHook).
+//
+// Code to be measured is wrapped in a PhaseTimer. Timers nest: each phase is
+// charged its self time, i.e. excluding the timers nested within it on the
+// same thread, so the phases add up to the wall time. The totals are logged
+// to dargh.log as a table. If TimingTrace is set in the INI file, every
+// timer is also recorded as an event of a Chrome trace file (dargh_trace.json,
+// next to dargh.log), which chrome://tracing, Perfetto or speedscope show as
+// a flame graph.
+// ----------------------------------------------------------------------------
+namespace DARGH
+{
+	enum class Phase : uint32_t
+	{
+		kRegisterProjects,           // registering each race's behavior projects
+		kOpenArchives,               // indexing the archives with DAR trees
+		kLoadFolder,                 // the rest of loading a project folder
+		kEnumerate,                  // listing folders and animation files
+		kParseConditions,            // reading and parsing _conditions.txt files
+		kResolveForms,               // looking up mods and reconstructing form IDs
+		kLoadPack,                   // reading a precompiled .darpack
+		kBuildLinks,                 // storing, indexing and pooling the mappings
+		kRemap,                      // GenAnimationHook, per character
+		kBuildRemapPlan,             // building a remap plan (the first time only)
+
+		kTotal
+	};
+
+	class PhaseTimer
+	{
+	public:
+		// 'a_detail' (e.g. a folder name) is only used in the trace, and
+		// must outlive the timer.
+		explicit PhaseTimer(Phase a_phase, std::string_view a_detail = {});
+		~PhaseTimer();
+
+		PhaseTimer(const PhaseTimer&) = delete;
+		PhaseTimer& operator=(const PhaseTimer&) = delete;
+
+	private:
+		Phase            phase;
+		std::string_view detail;
+		PhaseTimer*      parent;
+		int64_t          start;
+		int64_t          childNs = 0;
+	};
+
+	// Self time charged to each phase so far, in ns.
+	using PhaseTotals = std::array<uint64_t, static_cast<std::size_t>(Phase::kTotal)>;
+	PhaseTotals getPhaseTotals();
+
+	// Logs how long loading 'a_folder' spent in each phase, given the
+	// totals from before it started.
+	void logFolderTiming(const std::string& a_folder, const PhaseTotals& a_before);
+
+	// Logs the table of every phase (calls, total and longest time), and
+	// writes the trace file if it's enabled.
+	void logTiming(const char* a_title);
+}
@@ -0,0 +1,271 @@
+// ============================================================================
+//                                 Trace.cpp
+// ----------------------------------------------------------------------------
+// Part of the open-source Dynamic Animation Replacer (DARGH).
+//
+// Copyright (c) 2023 Nox Sidereum
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the �Software�), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is furnished
+// to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED �AS IS�, WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+// FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+// DEALINGS IN THE SOFTWARE.
+//
+// (The MIT License)
+// ============================================================================
+
+#include "Trace.h"
+#include "Utilities.h"
+
+namespace DARGH
+{
+	std::atomic<uint32_t> g_traceCategories{ 0 };
+
+	namespace
+	{
+		constexpr std::array<std::string_view, static_cast<std::size_t>(TraceCategory::kTotal)> CATEGORY_NAMES{
+			"Loading", "ConditionEval", "Hooks", "Trampolines", "Prefetch", "WorldSnapshot"
+		};
+
+		// Records per thread, and the most threads that can trace. Each
+		// ring is allocated the first time its thread traces.
+		constexpr uint32_t RING_SIZE = 1024;
+		constexpr uint32_t MAX_TRACE_THREADS = 64;
+
+		// How often the records are written to dargh.log.
+		constexpr auto DRAIN_INTERVAL = std::chrono::milliseconds(50);
+
+		// Single producer (the owning thread), single consumer (the drain
+		// thread): records [tail, head) are ready to be written.
+		struct TraceRing
+		{
+			std::array<TraceRecord, RING_SIZE> records;
+			uint32_t threadID;
+			alignas(64) std::atomic<uint32_t> head{ 0 };
+			alignas(64) std::atomic<uint32_t> tail{ 0 };
+			std::atomic<uint64_t> dropped{ 0 };
+		};
+
+		std::array<std::atomic<TraceRing*>, MAX_TRACE_THREADS> g_rings{};
+		std::atomic<uint32_t> g_numRings{ 0 };
+
+		// Set by configureTracing, before any tracepoint runs.
+		uint32_t g_sampleEvery = 1;
+		std::vector<std::string> g_traceProjects;
+		std::chrono::steady_clock::time_point g_traceStart;
+
+		enum TraceState : uint8_t
+		{
+			kUnscoped,               // not in a TraceScope: trace
+			kSampled,                // in a traced event
+			kSkipped                 // in an event that isn't traced
+		};
+
+		thread_local uint8_t t_traceState = kUnscoped;
+		thread_local uint32_t t_eventCount = 0;
+		thread_local TraceRing* t_ring = nullptr;
+		thread_local bool t_noRing = false;
+
+		TraceRing* claimRing()
+		{
+			// Gives this thread a ring, unless too many threads already have one.
+			const auto index = g_numRings.fetch_add(1, std::memory_order_relaxed);
+			if (index >= MAX_TRACE_THREADS) {
+				t_noRing = true;
+				return nullptr;
+			}
+
+			t_ring = new TraceRing;
+			t_ring->threadID = index + 1;
+			g_rings[index].store(t_ring, std::memory_order_release);
+			return t_ring;
+		}
+
+		void drainTraceRings()
+		{
+			// Writes every published record to dargh.log, in time order, and
+			// reports records dropped because a ring was full.
+			std::vector<std::pair<TraceRing*, uint32_t>> heads;
+			std::vector<const TraceRecord*> records;
+
+			for (;;) {
+				std::this_thread::sleep_for(DRAIN_INTERVAL);
+
+				heads.clear();
+				records.clear();
+				const auto nRings = std::min(g_numRings.load(std::memory_order_relaxed), MAX_TRACE_THREADS);
+				for (uint32_t i = 0; i < nRings; ++i) {
+					const auto ring = g_rings[i].load(std::memory_order_acquire);
+					if (!ring) {
+						continue;
+					}
+
+					const auto tail = ring->tail.load(std::memory_order_relaxed);
+					const auto head = ring->head.load(std::memory_order_acquire);
+					for (auto n = tail; n != head; ++n) {
+						records.push_back(&ring->records[n % RING_SIZE]);
+					}
+					heads.emplace_back(ring, head);
+
+					if (const auto dropped = ring->dropped.exchange(0, std::memory_order_relaxed)) {
+						logs::warn("[trace] thread {}: dropped {} records (ring full)", ring->threadID, dropped);
+					}
+				}
+
+				std::stable_sort(records.begin(), records.end(),
+					[](const TraceRecord* a_lhs, const TraceRecord* a_rhs) { return a_lhs->time < a_rhs->time; });
+				for (const auto record : records) {
+					logs::info("[trace {:10.6f} t{:<2} {}] {}", record->time / 1e9, record->threadID,
+						CATEGORY_NAMES[static_cast<std::size_t>(record->category)],
+						std::string_view(record->text, record->length));
+				}
+
+				// The records are written, so their slots can be reused.
+				for (const auto& [ring, head] : heads) {
+					ring->tail.store(head, std::memory_order_release);
+				}
+			}
+		}
+
+		std::vector<std::string> splitList(std::string_view a_list)
+		{
+			// Splits a comma separated list into its trimmed, lower case items.
+			std::vector<std::string> items;
+			std::size_t start = 0;
+			while (start <= a_list.size()) {
+				auto end = a_list.find(',', start);
+				if (end == std::string_view::npos) {
+					end = a_list.size();
+				}
+				auto item = trim(std::string(a_list.substr(start, end - start)));
+				if (!item.empty()) {
+					toLowerASCII(item);
+					items.push_back(std::move(item));
+				}
+				start = end + 1;
+			}
+			return items;
+		}
+	}
+
+	TraceRecord* beginTraceRecord(TraceCategory a_category)
+	{
+		if (t_traceState == kSkipped) {
+			return nullptr;
+		}
+
+		auto ring = t_ring;
+		if (!ring) {
+			if (t_noRing || !(ring = claimRing())) {
+				return nullptr;
+			}
+		}
+
+		const auto head = ring->head.load(std::memory_order_relaxed);
+		if (head - ring->tail.load(std::memory_order_acquire) >= RING_SIZE) {
+			ring->dropped.fetch_add(1, std::memory_order_relaxed);
+			return nullptr;
+		}
+
+		auto& record = ring->records[head % RING_SIZE];
+		record.time = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - g_traceStart).count();
+		record.threadID = ring->threadID;
+		record.category = a_category;
+		return &record;
+	}
+
+	void endTraceRecord(TraceRecord* a_record, std::size_t a_length)
+	{
+		a_record->length = static_cast<uint32_t>(std::min(a_length, TraceRecord::TEXT_SIZE));
+		t_ring->head.store(t_ring->head.load(std::memory_order_relaxed) + 1, std::memory_order_release);
+	}
+
+	uint8_t TraceScope::enter(bool a_bTraced, bool a_bSample)
+	{
+		const auto prevState = t_traceState;
+		if (prevState == kUnscoped) {
+			const bool bSampled = !a_bSample || (t_eventCount++ % g_sampleEvery) == 0;
+			t_traceState = a_bTraced && bSampled ? kSampled : kSkipped;
+		} else if (!a_bTraced) {
+			t_traceState = kSkipped;
+		}
+		return prevState;
+	}
+
+	void TraceScope::leave(uint8_t a_prevState)
+	{
+		t_traceState = a_prevState;
+	}
+
+	void traceProject(bool a_bTraced)
+	{
+		if (!a_bTraced && t_traceState == kSampled) {
+			t_traceState = kSkipped;
+		}
+	}
+
+	void configureTracing(std::string_view a_categories, std::string_view a_projects, uint32_t a_sampleEvery)
+	{
+		// ====================================================================
+		//                         configureTracing
+		// --------------------------------------------------------------------
+		// Called once, while reading the INI file at startup.
+		// ====================================================================
+		uint32_t categories = 0;
+		for (const auto& item : splitList(a_categories)) {
+			if (item == "all") {
+				categories = (1u << static_cast<uint32_t>(TraceCategory::kTotal)) - 1;
+				continue;
+			}
+
+			const auto it = std::find_if(CATEGORY_NAMES.begin(), CATEGORY_NAMES.end(), [&item](std::string_view a_name) {
+				return a_name.size() == item.size() &&
+				       std::equal(a_name.begin(), a_name.end(), item.begin(),
+						   [](char a_lhs, char a_rhs) { return std::tolower(static_cast<unsigned char>(a_lhs)) == a_rhs; });
+			});
+			if (it == CATEGORY_NAMES.end()) {
+				logs::warn("Unknown trace category '{}'.", item);
+				continue;
+			}
+			categories |= 1u << static_cast<uint32_t>(it - CATEGORY_NAMES.begin());
+		}
+
+		if (categories == 0 || g_traceCategories.load(std::memory_order_relaxed) != 0) {
+			return;
+		}
+
+		g_traceProjects = splitList(a_projects);
+		g_sampleEvery = std::max(a_sampleEvery, 1u);
+		g_traceStart = std::chrono::steady_clock::now();
+		std::thread(drainTraceRings).detach();
+		g_traceCategories.store(categories, std::memory_order_release);
+
+		std::string names;
+		for (uint32_t i = 0; i < static_cast<uint32_t>(TraceCategory::kTotal); ++i) {
+			if (categories & (1u << i)) {
+				names += names.empty() ? "" : ", ";
+				names += CATEGORY_NAMES[i];
+			}
+		}
+		logs::info("Tracing {} (projects: {}, 1 in {} events).", names,
+			g_traceProjects.empty() ? "all" : a_projects, g_sampleEvery);
+	}
+
+	bool isProjectTraced(std::string_view a_projFolder)
+	{
+		return g_traceProjects.empty() ||
+		       std::find(g_traceProjects.begin(), g_traceProjects.end(), a_projFolder) != g_traceProjects.end();
+	}
+}
@@ -0,0 +1,144 @@
+// ============================================================================
+//                                  Trace.h
+// ----------------------------------------------------------------------------
+// Part of the open-source Dynamic Animation Replacer (DARGH).
+//
+// Copyright (c) 2023 Nox Sidereum
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the �Software�), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is furnished
+// to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED �AS IS�, WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+// FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+// DEALINGS IN THE SOFTWARE.
+//
+// (The MIT License)
+// ============================================================================
+
+#pragma once
+
+// ----------------------------------------------------------------------------
+// Tracepoints, switched on at runtime from the INI file (Trace,
+// TraceProjects and TraceSampleEvery), so that tracing needs no rebuild and
+// can stay on in a normal game session.
+//
+// A tracepoint is a call to trace(category, format, args...). When its
+// category is off, it costs one relaxed load and a branch. When it's on, the
+// record is formatted straight into a lock-free ring buffer owned by the
+// calling thread (so tracing doesn't allocate or take a lock), and a
+// background thread drains the rings into dargh.log, in time order.
+//
+// The hooks wrap each runtime event (e.g. one clip activation) in a
+// TraceScope. With TraceSampleEvery=N, only one in N events on each thread
+// is traced; every record inside it is kept, so each traced event is
+// complete. Once the event's project is known, traceProject drops the rest
+// of the event if the project isn't listed in TraceProjects. Records outside
+// any scope (e.g. while loading) aren't sampled.
+// ----------------------------------------------------------------------------
+namespace DARGH
+{
+	enum class TraceCategory : uint32_t
+	{
+		kLoading,                    // the DAR links stored while loading
+		kConditionEval,              // choosing a replacement in getNewAnimIndex
+		kHooks,                      // the hooks (see Hooks.cpp)
+		kTrampolines,                // the trampolines (see Trampolines.cpp)
+		kPrefetch,                   // the prefetcher (see Prefetch.cpp)
+		kWorldSnapshot,              // changes to the world snapshot, once per frame at most
+
+		kTotal
+	};
+
+	// Bit per TraceCategory that's on. Zero unless tracing.
+	extern std::atomic<uint32_t> g_traceCategories;
+
+	inline bool isTracing(TraceCategory a_category)
+	{
+		return (g_traceCategories.load(std::memory_order_relaxed) >> static_cast<uint32_t>(a_category)) & 1;
+	}
+
+	struct TraceRecord
+	{
+		static constexpr std::size_t TEXT_SIZE = 232;
+
+		int64_t       time;          // ns since tracing started
+		uint32_t      threadID;
+		TraceCategory category;
+		uint32_t      length;
+		char          text[TEXT_SIZE];
+	};
+
+	// Reserves the next record in the calling thread's ring, or returns
+	// null if this thread's event isn't traced or its ring is full.
+	TraceRecord* beginTraceRecord(TraceCategory a_category);
+	// Publishes the record, with 'a_length' characters of text (truncated
+	// to fit).
+	void endTraceRecord(TraceRecord* a_record, std::size_t a_length);
+
+	template <class... Args>
+	void trace(TraceCategory a_category, std::format_string<Args...> a_format, Args&&... a_args)
+	{
+		if (isTracing(a_category)) [[unlikely]] {
+			if (const auto record = beginTraceRecord(a_category)) {
+				const auto result = std::format_to_n(record->text, TraceRecord::TEXT_SIZE,
+					a_format, std::forward<Args>(a_args)...);
+				endTraceRecord(record, static_cast<std::size_t>(result.size));
+			}
+		}
+	}
+
+	class TraceScope
+	{
+	public:
+		// One runtime event on this thread, sampled unless 'a_bSample' is
+		// false. If 'a_bTraced' is false, nothing in it is traced.
+		explicit TraceScope(bool a_bTraced = true, bool a_bSample = true)
+		{
+			if (g_traceCategories.load(std::memory_order_relaxed) != 0) [[unlikely]] {
+				bActive = true;
+				prevState = enter(a_bTraced, a_bSample);
+			}
+		}
+
+		~TraceScope()
+		{
+			if (bActive) [[unlikely]] {
+				leave(prevState);
+			}
+		}
+
+		TraceScope(const TraceScope&) = delete;
+		TraceScope& operator=(const TraceScope&) = delete;
+
+	private:
+		bool    bActive = false;
+		uint8_t prevState = 0;
+
+		static uint8_t enter(bool a_bTraced, bool a_bSample);
+		static void leave(uint8_t a_prevState);
+	};
+
+	// Drops the rest of this thread's current event, unless 'a_bTraced'
+	// (i.e. its project is listed in TraceProjects).
+	void traceProject(bool a_bTraced);
+
+	// Turns tracing on for the comma separated 'a_categories' ("All", or
+	// e.g. "ConditionEval, Hooks") and 'a_projects' (project folders, e.g.
+	// "actors\character", or empty for all of them), for one in every
+	// 'a_sampleEvery' events. Starts the thread that writes the records.
+	void configureTracing(std::string_view a_categories, std::string_view a_projects, uint32_t a_sampleEvery);
+
+	// Whether the project folder is listed in TraceProjects.
+	bool isProjectTraced(std::string_view a_projFolder);
+}
@@ -0,0 +1,370 @@
+// ============================================================================
+//                                 Usage.cpp
+// ----------------------------------------------------------------------------
+// Part of the open-source Dynamic Animation Replacer (DARGH).
+//
+// Copyright (c) 2023 Nox Sidereum
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the �Software�), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is furnished
+// to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED �AS IS�, WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+// FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+// DEALINGS IN THE SOFTWARE.
+//
+// (The MIT License)
+// ============================================================================
+
+#include "Usage.h"
+#include "DARProject.h"
+#include "DARProjectRegistry.h"
+#include "Utilities.h"
+
+namespace
+{
+	// dargh_usage.bin is a UsageFileHeader followed by nEntries
+	// UsageFileEntry, one per counter (see mappingKey and choiceKey).
+	// Counters of mappings that are no longer installed aren't kept.
+	struct UsageFileHeader
+	{
+		char     magic[4];
+		uint32_t version;
+		uint64_t playMs;                                   // play time recorded
+		uint64_t nEntries;
+	};
+
+	struct UsageFileEntry
+	{
+		uint64_t key;
+		uint64_t count;
+	};
+
+	constexpr char USAGE_MAGIC[4] = { 'D', 'A', 'R', 'U' };
+	constexpr uint32_t USAGE_VERSION = 1;
+
+	// Play time recorded by past sessions and by this one, up to the last
+	// time the clock was stopped. 'g_playStart' is main thread only.
+	std::atomic<uint64_t> g_playMs{ 0 };
+	std::optional<std::chrono::steady_clock::time_point> g_playStart;
+
+	uint64_t mappingKey(std::string_view a_folder, int32_t a_priority, std::string_view a_target)
+	{
+		// M1 mappings have priority 0 (their target paths are unique anyway).
+		uint64_t hash = hashLowerASCII(a_folder);
+		hash = hashLowerASCII(std::format("|{}|", a_priority), hash);
+		return hashLowerASCII(a_target, hash);
+	}
+
+	uint64_t choiceKey(std::string_view a_folder, std::string_view a_from)
+	{
+		uint64_t hash = hashLowerASCII(a_folder);
+		hash = hashLowerASCII("|from|", hash);
+		return hashLowerASCII(a_from, hash);
+	}
+
+	// The name of the FROM file with the given hashLowerASCII.
+	const std::string& fromFile(const DARFolderData& a_folderData, uint64_t a_hash)
+	{
+		if (const auto it = a_folderData.conditionLinkIndex.find(a_hash); it != a_folderData.conditionLinkIndex.end()) {
+			return a_folderData.conditionLinks[it->second.front()].from_hkx_file;
+		}
+		return a_folderData.actorBaseLinks[a_folderData.actorBaseLinkIndex.at(a_hash).front()].from_hkx_file;
+	}
+
+	// Calls a_func(key, counter) for every counter of every folder.
+	template <class Func>
+	void forEachCounter(Func a_func)
+	{
+		for (const auto& [folder, folderData] : DARGH::g_DARFolderRegistry) {
+			const auto usage = folderData->usage.get();
+			if (!usage) {
+				continue;
+			}
+
+			for (std::size_t i = 0; i < folderData->actorBaseLinks.size(); ++i) {
+				a_func(mappingKey(folder, 0, folderData->actorBaseLinks[i].to_hkx_file), usage->actorBaseWins[i]);
+			}
+			for (std::size_t i = 0; i < folderData->conditionLinks.size(); ++i) {
+				const auto& link = folderData->conditionLinks[i];
+				a_func(mappingKey(folder, link.priority, link.to_hkx_file), usage->conditionWins[i]);
+			}
+			for (auto& [hash, counter] : usage->choices) {
+				a_func(choiceKey(folder, fromFile(*folderData, hash)), counter);
+			}
+		}
+	}
+
+	std::optional<std::filesystem::path> usagePath(std::string_view a_extension)
+	{
+		const auto dir = logs::log_directory();
+		if (!dir) {
+			return std::nullopt;
+		}
+		return *dir / std::format("dargh_usage.{}", a_extension);
+	}
+
+	void writeUsageFile()
+	{
+		const auto path = usagePath("bin");
+		if (!path) {
+			return;
+		}
+
+		std::vector<UsageFileEntry> entries;
+		forEachCounter([&entries](uint64_t a_key, const DARGH::UsageCounter& a_counter) {
+			entries.push_back({ a_key, a_counter.load(std::memory_order_relaxed) });
+		});
+
+		UsageFileHeader header{};
+		std::memcpy(header.magic, USAGE_MAGIC, sizeof(USAGE_MAGIC));
+		header.version = USAGE_VERSION;
+		header.playMs = g_playMs.load(std::memory_order_relaxed);
+		header.nEntries = entries.size();
+
+		// Write a new file and then replace the old one, so that a crash
+		// part way through doesn't lose the counts saved so far.
+		auto tmpPath = *path;
+		tmpPath += ".tmp";
+		{
+			std::ofstream file(tmpPath, std::ios::binary | std::ios::trunc);
+			if (!file.is_open()) {
+				logs::warn("couldn't write {}", tmpPath.string());
+				return;
+			}
+			file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+			file.write(reinterpret_cast<const char*>(entries.data()), entries.size() * sizeof(UsageFileEntry));
+			if (!file) {
+				logs::warn("couldn't write {}", tmpPath.string());
+				return;
+			}
+		}
+
+		std::error_code error;
+		std::filesystem::rename(tmpPath, *path, error);
+		if (error) {
+			logs::warn("couldn't replace {}: {}", path->string(), error.message());
+		}
+	}
+
+	void writeUsageReport()
+	{
+		// ====================================================================
+		//                          writeUsageReport
+		// --------------------------------------------------------------------
+		// Lists the mappings that never won, for each FROM file, by why:
+		//   * always shadowed: a higher priority (or, below priority 0, an
+		//     M1 mapping) won every choice made for the FROM file;
+		//   * never true: the choice reached the mapping, but its conditions
+		//     (or actor base) never matched;
+		//   * never played: no choice was ever made for the FROM file.
+		// ====================================================================
+		const auto path = usagePath("txt");
+		if (!path) {
+			return;
+		}
+
+		std::ofstream file(*path, std::ios::trunc);
+		if (!file.is_open()) {
+			logs::warn("couldn't write {}", path->string());
+			return;
+		}
+
+		struct DeadMapping
+		{
+			const std::string* folder;
+			const std::string* target;
+			int32_t priority;
+			bool bActorBase;
+			uint64_t choices;
+			uint64_t shadowed;                             // choices won by a higher priority
+		};
+		std::vector<DeadMapping> shadowed, neverTrue, neverPlayed;
+		std::size_t nMappings = 0;
+
+		for (const auto& [folder, folderData] : DARGH::g_DARFolderRegistry) {
+			const auto usage = folderData->usage.get();
+			if (!usage) {
+				continue;
+			}
+
+			for (const auto& [hash, choiceCounter] : usage->choices) {
+				const uint64_t choices = choiceCounter.load(std::memory_order_relaxed);
+
+				// The mappings from this file, as (priority, wins).
+				std::vector<std::pair<int32_t, uint64_t>> m1, m2;
+				const auto m1Search = folderData->actorBaseLinkIndex.find(hash);
+				const auto m2Search = folderData->conditionLinkIndex.find(hash);
+				if (m1Search != folderData->actorBaseLinkIndex.end()) {
+					for (const auto index : m1Search->second) {
+						m1.emplace_back(0, usage->actorBaseWins[index].load(std::memory_order_relaxed));
+					}
+				}
+				if (m2Search != folderData->conditionLinkIndex.end()) {
+					for (const auto index : m2Search->second) {
+						m2.emplace_back(folderData->conditionLinks[index].priority, usage->conditionWins[index].load(std::memory_order_relaxed));
+					}
+				}
+
+				const auto winsAbove = [&m1, &m2](int32_t a_priority) {
+					uint64_t wins = 0;
+					for (const auto& [priority, linkWins] : m2) {
+						wins += priority > a_priority ? linkWins : 0;
+					}
+					for (const auto& [priority, linkWins] : m1) {
+						wins += 0 > a_priority ? linkWins : 0;
+					}
+					return wins;
+				};
+
+				const auto classify = [&](const std::string& a_target, int32_t a_priority, bool a_bActorBase, uint64_t a_wins) {
+					++nMappings;
+					if (a_wins > 0) {
+						return;
+					}
+					const DeadMapping dead{ &folder, &a_target, a_priority, a_bActorBase, choices, winsAbove(a_priority) };
+					if (choices == 0) {
+						neverPlayed.push_back(dead);
+					} else if (dead.shadowed >= choices) {
+						shadowed.push_back(dead);
+					} else {
+						neverTrue.push_back(dead);
+					}
+				};
+
+				if (m1Search != folderData->actorBaseLinkIndex.end()) {
+					for (std::size_t i = 0; i < m1.size(); ++i) {
+						classify(folderData->actorBaseLinks[m1Search->second[i]].to_hkx_file, 0, true, m1[i].second);
+					}
+				}
+				if (m2Search != folderData->conditionLinkIndex.end()) {
+					for (std::size_t i = 0; i < m2.size(); ++i) {
+						classify(folderData->conditionLinks[m2Search->second[i]].to_hkx_file, m2[i].first, false, m2[i].second);
+					}
+				}
+			}
+		}
+
+		const auto byName = [](const DeadMapping& a_lhs, const DeadMapping& a_rhs) {
+			return std::tie(*a_lhs.folder, *a_lhs.target) < std::tie(*a_rhs.folder, *a_rhs.target);
+		};
+		const auto writeList = [&file, &byName](std::vector<DeadMapping>& a_list, std::string_view a_title, bool a_bCounts) {
+			std::sort(a_list.begin(), a_list.end(), byName);
+			file << std::format("\n{} ({}):\n", a_title, a_list.size());
+			for (const auto& dead : a_list) {
+				const auto priority = dead.bActorBase ? std::string("actor base") : std::format("priority {}", dead.priority);
+				file << std::format("  {}: {}: {}", *dead.folder, priority, *dead.target);
+				if (a_bCounts) {
+					file << std::format(" ({} of {} choices won by a higher priority)", dead.shadowed, dead.choices);
+				}
+				file << '\n';
+			}
+		};
+
+		const uint64_t nDead = shadowed.size() + neverTrue.size() + neverPlayed.size();
+		file << std::format("dargh mapping usage over {:.1f} hours of play: {} of {} mappings never won.\n",
+			g_playMs.load(std::memory_order_relaxed) / 3.6e6, nDead, nMappings);
+		writeList(shadowed, "Always shadowed by a higher priority", true);
+		writeList(neverTrue, "Never true when a choice reached them", true);
+		writeList(neverPlayed, "FROM animation never played", false);
+
+		logs::info("wrote the usage of {} mappings to {} ({} never won)", nMappings, path->string(), nDead);
+	}
+}
+
+namespace DARGH
+{
+	void initFolderUsage(DARFolderData& a_folderData)
+	{
+		auto usage = std::make_unique<FolderUsage>();
+		usage->actorBaseWins = std::make_unique<UsageCounter[]>(a_folderData.actorBaseLinks.size());
+		usage->conditionWins = std::make_unique<UsageCounter[]>(a_folderData.conditionLinks.size());
+		for (const auto& [hash, indices] : a_folderData.actorBaseLinkIndex) {
+			usage->choices.try_emplace(hash);
+		}
+		for (const auto& [hash, indices] : a_folderData.conditionLinkIndex) {
+			usage->choices.try_emplace(hash);
+		}
+		a_folderData.usage = std::move(usage);
+	}
+
+	void loadUsage()
+	{
+		const auto path = usagePath("bin");
+		if (!path) {
+			return;
+		}
+
+		std::ifstream file(*path, std::ios::binary);
+		if (!file.is_open()) {
+			// Nothing recorded yet.
+			return;
+		}
+
+		UsageFileHeader header{};
+		file.read(reinterpret_cast<char*>(&header), sizeof(header));
+		if (!file || std::memcmp(header.magic, USAGE_MAGIC, sizeof(USAGE_MAGIC)) != 0 || header.version != USAGE_VERSION) {
+			logs::warn("{} isn't a usage file this version can read, starting afresh", path->string());
+			return;
+		}
+
+		std::unordered_map<uint64_t, uint64_t> counts;
+		UsageFileEntry entry;
+		for (uint64_t i = 0; i < header.nEntries && file.read(reinterpret_cast<char*>(&entry), sizeof(entry)); ++i) {
+			counts[entry.key] = entry.count;
+		}
+
+		std::size_t nFound = 0;
+		forEachCounter([&counts, &nFound](uint64_t a_key, UsageCounter& a_counter) {
+			if (const auto it = counts.find(a_key); it != counts.end()) {
+				a_counter.fetch_add(it->second, std::memory_order_relaxed);
+				++nFound;
+			}
+		});
+		g_playMs.fetch_add(header.playMs, std::memory_order_relaxed);
+
+		logs::info("usage: {:.1f} hours of play recorded, {} of {} saved counters still in use",
+			header.playMs / 3.6e6, nFound, counts.size());
+	}
+
+	void startPlayClock()
+	{
+		if (!g_playStart) {
+			g_playStart = std::chrono::steady_clock::now();
+		}
+	}
+
+	void stopPlayClock()
+	{
+		if (g_playStart) {
+			const auto elapsed = std::chrono::steady_clock::now() - *g_playStart;
+			g_playMs.fetch_add(std::chrono::duration_cast<std::chrono::milliseconds>(elapsed).count(), std::memory_order_relaxed);
+			g_playStart.reset();
+		}
+	}
+
+	void saveUsage()
+	{
+		if (!g_isDARDataLoaded.load(std::memory_order_acquire)) {
+			return;
+		}
+
+		if (g_playStart) {
+			stopPlayClock();
+			startPlayClock();
+		}
+
+		writeUsageFile();
+		writeUsageReport();
+	}
+}
@@ -0,0 +1,93 @@
+// ============================================================================
+//                                  Usage.h
+// ----------------------------------------------------------------------------
+// Part of the open-source Dynamic Animation Replacer (DARGH).
+//
+// Copyright (c) 2023 Nox Sidereum
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the �Software�), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is furnished
+// to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED �AS IS�, WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+// FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+// DEALINGS IN THE SOFTWARE.
+//
+// (The MIT License)
+// ============================================================================
+
+#pragma once
+
+struct DARFolderData;
+
+// ----------------------------------------------------------------------------
+// Which mappings actually get used (UsageTelemetry in the INI file).
+//
+// A mapping is a (project folder, priority, target file). Every choice
+// getNewAnimIndex makes is counted against its FROM animation, and against
+// the mapping it chose, if any. The counters live in each folder's
+// FolderUsage, and each remap plan points its slots and FROM indices at them
+// (PlanUsage, in arrays indexed by to_hkx_index and from_hkx_index), so
+// recording a choice is two array reads and two relaxed increments.
+//
+// The counts are kept across sessions in dargh_usage.bin, next to dargh.log:
+// they're read once the DAR data has loaded, and written back whenever the
+// game is saved, along with dargh_usage.txt. That report lists the mappings
+// that never won in the hours of play recorded so far, and among them those
+// that were always shadowed, i.e. a higher priority won every choice they
+// could have been part of. Those are the ones to prune, to free slots.
+// ----------------------------------------------------------------------------
+namespace DARGH
+{
+	using UsageCounter = std::atomic<uint64_t>;
+
+	// Counters of one project folder's mappings.
+	struct FolderUsage
+	{
+		std::unique_ptr<UsageCounter[]> actorBaseWins;         // per DARFolderData::actorBaseLinks entry
+		std::unique_ptr<UsageCounter[]> conditionWins;         // per DARFolderData::conditionLinks entry
+		std::unordered_map<uint64_t, UsageCounter> choices;    // per FROM file, keyed by hashLowerASCII
+	};
+
+	// A remap plan's pointers into its folder's FolderUsage, indexed directly
+	// (null where the plan has no mapping).
+	struct PlanUsage
+	{
+		std::vector<UsageCounter*> slotWins;                   // per M1/M2 slot, i.e. to_hkx_index
+		std::vector<UsageCounter*> choices;                    // per from_hkx_index
+
+		void record(uint32_t a_fromIndex, int16_t a_toIndex) const
+		{
+			if (a_fromIndex < choices.size() && choices[a_fromIndex]) {
+				choices[a_fromIndex]->fetch_add(1, std::memory_order_relaxed);
+			}
+			if (a_toIndex >= 0 && static_cast<std::size_t>(a_toIndex) < slotWins.size() && slotWins[a_toIndex]) {
+				slotWins[a_toIndex]->fetch_add(1, std::memory_order_relaxed);
+			}
+		}
+	};
+
+	// Creates the folder's counters, once its links are loaded and indexed.
+	void initFolderUsage(DARFolderData& a_folderData);
+
+	// Adds the counts saved in past sessions to every folder's counters.
+	void loadUsage();
+
+	// Play time is counted from a game being started or loaded, until the
+	// next one is loaded.
+	void startPlayClock();
+	void stopPlayClock();
+
+	// Writes dargh_usage.bin and dargh_usage.txt (main thread).
+	void saveUsage();
+}
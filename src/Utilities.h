@@ -1,43 +1,50 @@
-// ============================================================================
-//                              Utilities.h
-// ----------------------------------------------------------------------------
-// Part of the open-source Dynamic Animation Replacer (DARGH).
-// 
-// Copyright (c) 2023 Nox Sidereum
-//
-// Permission is hereby granted, free of charge, to any person obtaining a copy
-// of this software and associated documentation files (the Software), to deal
-// in the Software without restriction, including without limitation the rights
-// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
-// copies of the Software, and to permit persons to whom the Software is furnished
-// to do so, subject to the following conditions:
-//
-// The above copyright notice and this permission notice shall be included in
-// all copies or substantial portions of the Software.
-//
-// THE SOFTWARE IS PROVIDED AS IS, WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
-// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
-// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
-// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
-// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
-// FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
-// DEALINGS IN THE SOFTWARE.
-// 
-// (The MIT License)
-// ============================================================================
-
-#pragma once
-
-bool startsWith(const std::string& str, const std::string& prefix);
-
-bool endsWith(const std::string& str, const std::string& suffix);
-
-bool isNumber(const std::string& s);
-
-bool findMatchingFiles(std::string& dirToSearch, std::vector<std::string>& matches_out,
-	                   bool filterToExt, bool recursive, std::string ext, std::string subDir);
-
-std::string trim(const std::string& s);
-
-std::vector<std::string> splitOnPipes(std::vector<std::string>& vec, std::string sArg);
-std::vector<std::string> splitOnCommas(std::vector<std::string>& vec, std::string strArgs);
\ No newline at end of file
+// ============================================================================
+//                              Utilities.h
+// ----------------------------------------------------------------------------
+// Part of the open-source Dynamic Animation Replacer (DARGH).
+// 
+// Copyright (c) 2023 Nox Sidereum
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the Software), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is furnished
+// to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED AS IS, WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+// FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+// DEALINGS IN THE SOFTWARE.
+// 
+// (The MIT License)
+// ============================================================================
+
+#pragma once
+
+bool startsWith(const std::string& str, const std::string& prefix);
+
+bool endsWith(const std::string& str, const std::string& suffix);
+
+bool isNumber(const std::string& s);
+
+bool findMatchingFiles(std::string& dirToSearch, std::vector<std::string>& matches_out,
+	                   bool filterToExt, bool recursive, std::string ext, std::string subDir);
+
+std::string trim(const std::string& s);
+
+std::vector<std::string> splitOnPipes(std::vector<std::string>& vec, std::string sArg);
+std::vector<std::string> splitOnCommas(std::vector<std::string>& vec, std::string strArgs);
+
+constexpr uint64_t FNV1A_OFFSET_BASIS = 0xCBF29CE484222325;
+constexpr uint64_t FNV1A_PRIME = 0x100000001B3;
+
+void toLowerASCII(char* dst, const char* src, std::size_t len);
+void toLowerASCII(std::string& str);
+uint64_t hashLowerASCII(std::string_view str, uint64_t hash = FNV1A_OFFSET_BASIS);
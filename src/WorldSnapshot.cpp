@@ -0,0 +1,170 @@
+// ============================================================================
+//                             WorldSnapshot.cpp
+// ----------------------------------------------------------------------------
+// Part of the open-source Dynamic Animation Replacer (DARGH).
+//
+// Copyright (c) 2023 Nox Sidereum
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the �Software�), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is furnished
+// to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED �AS IS�, WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+// FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+// DEALINGS IN THE SOFTWARE.
+//
+// (The MIT License)
+// ============================================================================
+
+#include "WorldSnapshot.h"
+#include "DARProjectRegistry.h"
+#include "Trace.h"
+
+namespace
+{
+	constexpr uint32_t NO_GLOBAL = 0xFFFFFFFF;
+
+	// Fixed by buildWorldSnapshot, before the DAR data is published
+	// (g_isDARDataLoaded), and only read after that.
+	std::vector<RE::FormID> g_snapshotGlobalIDs;                      // sorted
+	std::vector<RE::TESGlobal*> g_snapshotGlobals;                    // same order as g_snapshotGlobalIDs
+
+	// Written by the main thread in refreshWorldSnapshot, read by any thread
+	// evaluating conditions. Conditions only need each value to be untorn, not
+	// a consistent view across values, so each is atomic on its own.
+	std::atomic<bool> g_snapshotValid{ false };
+	std::atomic<RE::FormID> g_snapshotWeather{ 0 };
+	std::atomic<float> g_snapshotGameHour{ -1.0f };                   // < 0 if there's no calendar
+	std::unique_ptr<std::atomic<float>[]> g_snapshotGlobalValues;
+
+	uint32_t findSnapshotGlobal(RE::FormID a_formID)
+	{
+		const auto it = std::lower_bound(g_snapshotGlobalIDs.begin(), g_snapshotGlobalIDs.end(), a_formID);
+		return it != g_snapshotGlobalIDs.end() && *it == a_formID ?
+		           static_cast<uint32_t>(it - g_snapshotGlobalIDs.begin()) : NO_GLOBAL;
+	}
+}
+
+namespace DARGH
+{
+	void buildWorldSnapshot()
+	{
+		// ====================================================================
+		//                        buildWorldSnapshot
+		// --------------------------------------------------------------------
+		// Collects the globals referred to by the loaded conditions. Called once all the folders' condition pools
+		// have been built, and before the DAR data is published.
+		// ====================================================================
+		for (const auto& [folder, folderData] : g_DARFolderRegistry) {
+			const auto& pool = folderData->conditionPool;
+			for (uint32_t i = 0; i < pool.numTerms(); ++i) {
+				const auto& funcInfo = getConditionFunc(pool.ops[i]);
+				if ((funcInfo.deps & kDepGlobals) == 0) {
+					continue;
+				}
+
+				const uint32_t bmArgIsFloat = pool.flags[i] >> ConditionPool::kArgIsFloatShift;
+				for (uint32_t j = 0; j < funcInfo.nArgs; ++j) {
+					if ((bmArgIsFloat & (1 << j)) == 0) {
+						const auto formID = std::get<uint32_t>(pool.args[i][j]);
+						if (RE::TESForm::LookupByID<RE::TESGlobal>(formID)) {
+							g_snapshotGlobalIDs.push_back(formID);
+						}
+					}
+				}
+			}
+		}
+
+		std::sort(g_snapshotGlobalIDs.begin(), g_snapshotGlobalIDs.end());
+		g_snapshotGlobalIDs.erase(std::unique(g_snapshotGlobalIDs.begin(), g_snapshotGlobalIDs.end()), g_snapshotGlobalIDs.end());
+		for (const auto formID : g_snapshotGlobalIDs) {
+			g_snapshotGlobals.push_back(RE::TESForm::LookupByID<RE::TESGlobal>(formID));
+		}
+		g_snapshotGlobalValues = std::make_unique<std::atomic<float>[]>(g_snapshotGlobalIDs.size());
+
+		logs::info("world snapshot: {} globals", g_snapshotGlobalIDs.size());
+	}
+
+	void refreshWorldSnapshot()
+	{
+		// ====================================================================
+		//                       refreshWorldSnapshot
+		// --------------------------------------------------------------------
+		// Reads the world state for this frame. Main thread only.
+		// ====================================================================
+		if (!g_isDARDataLoaded.load(std::memory_order_acquire)) {
+			return;
+		}
+
+		RE::FormID weather = 0;
+		if (const auto sky = RE::Sky::GetSingleton()) {
+			if (sky->currentWeather) {
+				weather = sky->currentWeather->GetFormID();
+			}
+		}
+		if (g_snapshotWeather.exchange(weather, std::memory_order_relaxed) != weather) {
+			trace(TraceCategory::kWorldSnapshot, "weather {:08X}", weather);
+		}
+
+		float gameHour = -1.0f;
+		if (const auto calendar = RE::Calendar::GetSingleton()) {
+			// The fractional part of the game time is the proportion of the
+			// current day that has passed.
+			float f = 0.0;
+			gameHour = std::modf(calendar->GetCurrentGameTime(), &f) * calendar->GetHoursPerDay();
+		}
+		g_snapshotGameHour.store(gameHour, std::memory_order_relaxed);
+
+		for (std::size_t i = 0; i < g_snapshotGlobals.size(); ++i) {
+			const float value = g_snapshotGlobals[i]->value;
+			if (g_snapshotGlobalValues[i].exchange(value, std::memory_order_relaxed) != value) {
+				trace(TraceCategory::kWorldSnapshot, "global {:08X} = {}", g_snapshotGlobalIDs[i], value);
+			}
+		}
+
+		if (!g_snapshotValid.load(std::memory_order_relaxed)) {
+			g_snapshotValid.store(true, std::memory_order_release);
+		}
+	}
+
+	bool getSnapshotWeather(RE::FormID& a_weather)
+	{
+		if (!g_snapshotValid.load(std::memory_order_acquire)) {
+			return false;
+		}
+		a_weather = g_snapshotWeather.load(std::memory_order_relaxed);
+		return true;
+	}
+
+	bool getSnapshotGameHour(float& a_hour)
+	{
+		if (!g_snapshotValid.load(std::memory_order_acquire)) {
+			return false;
+		}
+		a_hour = g_snapshotGameHour.load(std::memory_order_relaxed);
+		return true;
+	}
+
+	bool getSnapshotGlobal(RE::FormID a_formID, float& a_value)
+	{
+		if (!g_snapshotValid.load(std::memory_order_acquire)) {
+			return false;
+		}
+		const auto global = findSnapshotGlobal(a_formID);
+		if (global == NO_GLOBAL) {
+			return false;
+		}
+		a_value = g_snapshotGlobalValues[global].load(std::memory_order_relaxed);
+		return true;
+	}
+}
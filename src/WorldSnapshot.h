@@ -0,0 +1,51 @@
+// ============================================================================
+//                              WorldSnapshot.h
+// ----------------------------------------------------------------------------
+// Part of the open-source Dynamic Animation Replacer (DARGH).
+//
+// Copyright (c) 2023 Nox Sidereum
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the �Software�), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is furnished
+// to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED �AS IS�, WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+// FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+// DEALINGS IN THE SOFTWARE.
+//
+// (The MIT License)
+// ============================================================================
+
+#pragma once
+
+#include "Conditions.h"
+
+// ----------------------------------------------------------------------------
+// A per-frame snapshot of the world state that conditions read: the current
+// weather, the game hour and the value of every GlobalVariable that a loaded
+// condition refers to. These are the same for every actor within a frame, so
+// they are read once per frame on the main thread (see MainUpdateHook)
+// rather than for every term of every activation.
+// ----------------------------------------------------------------------------
+namespace DARGH
+{
+	void buildWorldSnapshot();
+	void refreshWorldSnapshot();
+
+	// These return false until the first refresh after the DAR data has
+	// loaded (or, for getSnapshotGlobal, if no loaded condition refers to
+	// the global), in which case the caller should read the live value.
+	bool getSnapshotWeather(RE::FormID& a_weather);
+	bool getSnapshotGameHour(float& a_hour);
+	bool getSnapshotGlobal(RE::FormID a_formID, float& a_value);
+}
@@ -0,0 +1,122 @@
+// ============================================================================
+//                            bsarchive_bench.cpp
+// ----------------------------------------------------------------------------
+// Part of the open-source Dynamic Animation Replacer (DARGH).
+//
+// Copyright (c) 2023 Nox Sidereum
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the �Software�), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is furnished
+// to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED �AS IS�, WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+// FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+// DEALINGS IN THE SOFTWARE.
+//
+// (The MIT License)
+// ============================================================================
+
+// ----------------------------------------------------------------------------
+// bsarchive_bench: times the BSA reader (src/BSArchive.cpp) on real archives,
+// e.g. a mod's .bsa or "Skyrim - Animations.bsa":
+//     - opening (parsing the records and names into the index);
+//     - looking up every file by path;
+//     - reading every file, in MB/s of decompressed output.
+//
+//     xmake build bsarchive_bench && xmake run bsarchive_bench <archive.bsa>...
+// ----------------------------------------------------------------------------
+
+#include "BSArchive.h"
+
+#include <chrono>
+#include <cstdio>
+
+namespace
+{
+	using Clock = std::chrono::steady_clock;
+
+	double elapsedMs(Clock::time_point a_start)
+	{
+		return std::chrono::duration<double, std::milli>(Clock::now() - a_start).count();
+	}
+
+	bool bench(const std::filesystem::path& a_path)
+	{
+		constexpr int OPEN_REPS = 20;
+		constexpr int LOOKUP_REPS = 20;
+		constexpr int READ_REPS = 3;
+
+		BSArchive archive;
+		std::string error;
+		auto start = Clock::now();
+		for (int i = 0; i < OPEN_REPS; ++i) {
+			if (!archive.open(a_path, error)) {
+				std::printf("%s: %s\n", a_path.string().c_str(), error.c_str());
+				return false;
+			}
+		}
+		const double openMs = elapsedMs(start) / OPEN_REPS;
+
+		std::vector<std::string> paths;
+		paths.reserve(archive.numFiles());
+		archive.forEachFolderUnder("", [&](const BSArchive::Folder& a_folder) {
+			for (const auto& file : archive.filesIn(a_folder)) {
+				paths.push_back(a_folder.name + '\\' + std::string(archive.fileName(file)));
+			}
+		});
+
+		start = Clock::now();
+		std::size_t nFound = 0;
+		for (int i = 0; i < LOOKUP_REPS; ++i) {
+			for (const auto& path : paths) {
+				nFound += archive.findFile(path) != nullptr;
+			}
+		}
+		const double lookupNs = elapsedMs(start) * 1e6 / (static_cast<double>(LOOKUP_REPS) * std::max<std::size_t>(paths.size(), 1));
+
+		start = Clock::now();
+		std::size_t nBytes = 0;
+		std::size_t nFailed = 0;
+		std::vector<char> contents;
+		for (int i = 0; i < READ_REPS; ++i) {
+			for (const auto& path : paths) {
+				if (const auto file = archive.findFile(path); file && archive.read(*file, contents)) {
+					nBytes += contents.size();
+				} else {
+					++nFailed;
+				}
+			}
+		}
+		const double readMs = elapsedMs(start);
+
+		std::printf("%s: %zu folders, %zu files (%zu found, %zu unreadable)\n", a_path.filename().string().c_str(),
+			archive.numFolders(), archive.numFiles(), nFound / LOOKUP_REPS, nFailed / READ_REPS);
+		std::printf("  open %.2f ms, lookup %.0f ns per file, read %.0f MB/s\n",
+			openMs, lookupNs, readMs > 0 ? nBytes / readMs / 1e3 : 0.0);
+		return true;
+	}
+}
+
+int main(int argc, char* argv[])
+{
+	if (argc < 2) {
+		std::printf("usage: bsarchive_bench <archive.bsa>...\n");
+		return 2;
+	}
+
+	bool bOk = true;
+	for (int i = 1; i < argc; ++i) {
+		bOk = bench(argv[i]) && bOk;
+	}
+	return bOk ? 0 : 1;
+}
@@ -0,0 +1,253 @@
+// ============================================================================
+//                             bsarchive_test.cpp
+// ----------------------------------------------------------------------------
+// Part of the open-source Dynamic Animation Replacer (DARGH).
+//
+// Copyright (c) 2023 Nox Sidereum
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the �Software�), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is furnished
+// to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED �AS IS�, WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+// FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+// DEALINGS IN THE SOFTWARE.
+//
+// (The MIT License)
+// ============================================================================
+
+// ----------------------------------------------------------------------------
+// bsarchive_test: checks the BSA reader (src/BSArchive.cpp) outside the game,
+// against the archives in fixtures (see fixtures/make_fixtures.py):
+//     - the Bethesda path hash, against the generator's independent one;
+//     - folder and file lookup, and enumerating the folders under a path;
+//     - reading files, stored or compressed as LZ4 frames (linked and
+//       independent blocks, stored blocks, checksums, embedded names);
+//     - decoding hand-made LZ4 frames, and rejecting malformed ones.
+//
+//     xmake build bsarchive_test && xmake run bsarchive_test
+//
+// Exits with the number of failed checks.
+// ----------------------------------------------------------------------------
+
+#include "BSArchive.h"
+
+#include <array>
+#include <cstdio>
+#include <format>
+#include <set>
+
+namespace
+{
+	int g_failures = 0;
+
+	void expect(bool a_ok, const std::string& a_what)
+	{
+		if (!a_ok) {
+			std::printf("FAILED: %s\n", a_what.c_str());
+			++g_failures;
+		}
+	}
+
+	// As file_contents in make_fixtures.py.
+	std::vector<char> fileContents(std::string_view a_path, std::size_t a_size)
+	{
+		std::vector<char> out;
+		if (a_path.ends_with(".bin")) {
+			uint32_t state = static_cast<uint32_t>(a_path.size());
+			while (out.size() < a_size) {
+				state = (state * 1103515245u + 12345u) & 0x7FFFFFFF;
+				out.push_back(static_cast<char>(state >> 16 & 0xFF));
+			}
+			return out;
+		}
+		for (std::size_t line = 0; out.size() < a_size; ++line) {
+			const auto text = std::format("{} {}\r\n", a_path, line);
+			out.insert(out.end(), text.begin(), text.end());
+		}
+		out.resize(a_size);
+		return out;
+	}
+
+	constexpr std::string_view DAR = "meshes\\actors\\character\\animations\\dynamicanimationreplacer";
+
+	struct FixtureFile
+	{
+		std::string path;
+		std::size_t size;
+	};
+
+	// As FILES in make_fixtures.py.
+	const std::array<FixtureFile, 8> FIXTURE_FILES{ {
+		{ std::format("{}\\_customconditions\\100\\_conditions.txt", DAR), 40 },
+		{ std::format("{}\\_customconditions\\100\\mt_idle.hkx", DAR), 3000 },
+		{ std::format("{}\\_customconditions\\100\\sub\\deep\\1hm_attack.hkx", DAR), 150000 },
+		{ std::format("{}\\_customconditions\\-5\\_conditions.txt", DAR), 12 },
+		{ std::format("{}\\_customconditions\\-5\\noise.bin", DAR), 4000 },
+		{ std::format("{}\\skyrim.esm\\00000007\\mt_walk.hkx", DAR), 100 },
+		{ "meshes\\actors\\character\\animations\\dynamicanimationreplacer-old\\x.hkx", 1 },
+		{ "meshes\\actors\\character\\animations\\mt_idle.hkx", 4 },
+	} };
+
+	void testHashes()
+	{
+		// Printed by make_fixtures.py.
+		constexpr std::pair<std::string_view, uint64_t> FILE_HASHES[]{
+			{ "a", 0x0000000061010061 },
+			{ "ab", 0x0000000061020062 },
+			{ "abc.kf", 0x1711E3E9610362E3 },
+			{ "skeleton.nif", 0x875CFA7E7308EF6E },
+			{ "t.dds", 0x8DDBA9C5740180F4 },
+			{ "s.wav", 0x9733CF9EF3010073 },
+			{ "noext", 0x006F1BB66E057874 },
+			{ "_conditions.txt", 0xE08072155F0B6E73 },
+			{ "1hm_attack.hkx", 0x1190B2E1310A636B },
+			{ "mt_walk.hkx", 0xD4305E9C6D076C6B },
+		};
+		for (const auto& [name, hash] : FILE_HASHES) {
+			expect(BSArchive::hashFile(name) == hash, std::format("hashFile({}) == {:016X}", name, hash));
+		}
+
+		constexpr std::pair<std::string_view, uint64_t> FOLDER_HASHES[]{
+			{ "", 0 },
+			{ "meshes", 0x322F3A9A6D066573 },
+			{ "meshes\\actors\\character\\animations", 0xEE022B076D226E73 },
+			{ "meshes\\actors\\character\\animations\\dynamicanimationreplacer\\_customconditions\\-5", 0xEFFF7DBD6D502D35 },
+			{ "meshes\\actors\\character\\animations\\dynamicanimationreplacer\\skyrim.esm\\00000007", 0x530B188D6D4F3037 },
+		};
+		for (const auto& [path, hash] : FOLDER_HASHES) {
+			expect(BSArchive::hashFolder(path) == hash, std::format("hashFolder({}) == {:016X}", path, hash));
+		}
+	}
+
+	void testArchive(const std::filesystem::path& a_path)
+	{
+		const auto name = a_path.filename().string();
+		BSArchive archive;
+		std::string error;
+		if (!archive.open(a_path, error)) {
+			expect(false, std::format("{}: open ({})", name, error));
+			return;
+		}
+		expect(archive.numFolders() == 6, std::format("{}: 6 folders", name));
+		expect(archive.numFiles() == FIXTURE_FILES.size(), std::format("{}: {} files", name, FIXTURE_FILES.size()));
+
+		std::vector<char> contents;
+		for (const auto& [path, size] : FIXTURE_FILES) {
+			// Look each one up in upper case, with '/', to check the
+			// paths are normalised.
+			std::string query = path;
+			for (auto& c : query) {
+				c = c == '\\' ? '/' : static_cast<char>(std::toupper(static_cast<unsigned char>(c)));
+			}
+			const auto file = archive.findFile(query);
+			expect(file != nullptr, std::format("{}: findFile({})", name, query));
+			if (file) {
+				expect(archive.read(*file, contents) && contents == fileContents(path, size),
+					std::format("{}: read({})", name, path));
+			}
+		}
+
+		expect(!archive.findFile(std::format("{}\\_customconditions\\100\\missing.hkx", DAR)), std::format("{}: missing file", name));
+		expect(!archive.findFile("meshes\\missing\\mt_idle.hkx"), std::format("{}: file in a missing folder", name));
+		expect(archive.findFolder("Meshes/Actors/Character/Animations/") != nullptr, std::format("{}: findFolder", name));
+		// Archives only list the folders that have files.
+		expect(!archive.findFolder(std::format("{}\\_customconditions", DAR)), std::format("{}: folder without files", name));
+
+		// Enumerate the DAR tree, which mustn't pick up its "-old" sibling
+		// (which sorts between the tree's folders).
+		std::vector<std::string> under;
+		archive.forEachFolderUnder(DAR, [&](const BSArchive::Folder& a_folder) { under.push_back(a_folder.name); });
+		const std::vector<std::string> expected{
+			std::format("{}\\_customconditions\\-5", DAR),
+			std::format("{}\\_customconditions\\100", DAR),
+			std::format("{}\\_customconditions\\100\\sub\\deep", DAR),
+			std::format("{}\\skyrim.esm\\00000007", DAR),
+		};
+		expect(under == expected, std::format("{}: forEachFolderUnder", name));
+
+		std::size_t nFolders = 0;
+		archive.forEachFolderUnder("", [&](const BSArchive::Folder&) { ++nFolders; });
+		expect(nFolders == archive.numFolders(), std::format("{}: forEachFolderUnder(\"\")", name));
+	}
+
+	std::vector<uint8_t> frame(std::initializer_list<uint8_t> a_blocks, uint8_t a_flags = 0x60)
+	{
+		// Magic, flags, block descriptor (64 KB), header checksum (not
+		// checked), then the blocks as given.
+		std::vector<uint8_t> out;
+		out.reserve(7 + a_blocks.size());
+		out.insert(out.end(), { 0x04, 0x22, 0x4D, 0x18, a_flags, 0x40, 0x00 });
+		out.insert(out.end(), a_blocks);
+		return out;
+	}
+
+	bool decodes(const std::vector<uint8_t>& a_frame, std::string_view a_expected)
+	{
+		std::vector<char> out(a_expected.size());
+		return BSArchive::decompressLZ4Frame(a_frame, out) && std::string_view(out.data(), out.size()) == a_expected;
+	}
+
+	void testLZ4Frames()
+	{
+		// A stored block, then a compressed block whose match overlaps
+		// itself (offset 1, length 9), and the end mark.
+		const auto good = frame({
+			0x03, 0x00, 0x00, 0x80, 'x', 'y', 'z',
+			0x0A, 0x00, 0x00, 0x00, 0x15, 'a', 0x01, 0x00, 0x50, 'b', 'c', 'd', 'e', 'f',
+			0x00, 0x00, 0x00, 0x00 });
+		expect(decodes(good, "xyzaaaaaaaaaabcdef"), "LZ4: stored and overlapping");
+
+		// A match into the previous block (offset 4 reaches back to 'y').
+		const auto linked = frame({
+			0x03, 0x00, 0x00, 0x80, 'x', 'y', 'z',
+			0x04, 0x00, 0x00, 0x00, 0x00, 0x03, 0x00, 0x00,
+			0x00, 0x00, 0x00, 0x00 });
+		expect(decodes(linked, "xyzxyzx"), "LZ4: match into the previous block");
+
+		// Malformed frames.
+		auto badMagic = good;
+		badMagic[0] = 0x05;
+		expect(!decodes(badMagic, "xyzaaaaaaaaaabcdef"), "LZ4: bad magic");
+		expect(!decodes(frame({ 0x00, 0x00, 0x00, 0x00 }, 0x61), ""), "LZ4: dictionary");
+		expect(!decodes(frame({ 0x00, 0x00, 0x00, 0x00 }, 0xA0), ""), "LZ4: unknown version");
+		expect(!decodes(std::vector<uint8_t>(good.begin(), good.end() - 4), "xyzaaaaaaaaaabcdef"), "LZ4: no end mark");
+		expect(!decodes(good, "xyzaaaaaaaaaabcdefg"), "LZ4: too short");
+		expect(!decodes(good, "xyzaaaaaaaaaabcde"), "LZ4: too long");
+		expect(!decodes(frame({ 0x04, 0x00, 0x00, 0x00, 0x00, 0x01, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00 }), "aaaa"),
+			"LZ4: match before the start");
+		expect(!decodes(frame({ 0x08, 0x00, 0x00, 0x80, 'x', 'y', 'z', 0x00, 0x00, 0x00, 0x00 }), "xyz"),
+			"LZ4: block past the end");
+	}
+}
+
+int main(int argc, char* argv[])
+{
+	const std::filesystem::path fixtures = argc > 1 ? argv[1] : ".";
+
+	testHashes();
+	for (const auto name : { "lz4_linked.bsa", "lz4_embedded.bsa" }) {
+		testArchive(fixtures / name);
+	}
+
+	BSArchive archive;
+	std::string error;
+	expect(!archive.open(fixtures / "missing.bsa", error), "open: missing archive");
+	expect(!archive.open(fixtures / "make_fixtures.py", error), "open: not an archive");
+	expect(archive.open(fixtures / "lz4_linked.bsa", error) && archive.findFile(FIXTURE_FILES[0].path), "open: reused");
+
+	testLZ4Frames();
+
+	std::printf("%s (%d failed)\n", g_failures == 0 ? "passed" : "FAILED", g_failures);
+	return g_failures;
+}
@@ -0,0 +1,130 @@
+# ============================================================================
+#                              make_fixtures.py
+# ----------------------------------------------------------------------------
+# Part of the open-source Dynamic Animation Replacer (DARGH).
+#
+# Writes the small .bsa archives that bsarchive_test reads. The hash and the
+# archive layout are implemented here from the format's description (UESP's
+# "Skyrim Mod:Archive File Format"), independently of src/BSArchive.cpp, and
+# the compressed files are LZ4 frames written by the reference lz4 tool.
+# Run from this folder, with lz4 on the PATH:
+#
+#     python make_fixtures.py
+#
+# The file contents are generated, so bsarchive_test can generate them again
+# to check what it reads (see fileContents there).
+# ============================================================================
+import struct
+import subprocess
+
+
+def hash_chars(chars, h=0):
+    for c in chars.encode():
+        h = (h * 0x1003F + c) & 0xFFFFFFFF
+    return h
+
+
+def hash_path(root, ext=''):
+    n = len(root)
+    b = root.encode()
+    low = 0
+    if n > 0:
+        low = b[-1] | ((b[-2] if n > 2 else 0) << 8) | (n << 16) | (b[0] << 24)
+    high = hash_chars(root[1:n - 2]) if n > 3 else 0
+    low |= {'.kf': 0x80, '.nif': 0x8000, '.dds': 0x8080, '.wav': 0x80000000}.get(ext, 0)
+    high = (high + hash_chars(ext)) & 0xFFFFFFFF
+    return high << 32 | low
+
+
+def hash_file(name):
+    dot = name.rfind('.')
+    return hash_path(name) if dot < 0 else hash_path(name[:dot], name[dot:])
+
+
+def file_contents(path, size):
+    # Text lines (compressible) or, for ".bin" files, an LCG's bytes (not).
+    if path.endswith('.bin'):
+        out = bytearray()
+        state = len(path)
+        while len(out) < size:
+            state = (state * 1103515245 + 12345) & 0x7FFFFFFF
+            out.append(state >> 16 & 0xFF)
+        return bytes(out)
+    out = bytearray()
+    line = 0
+    while len(out) < size:
+        out += f'{path} {line}\r\n'.encode()
+        line += 1
+    return bytes(out[:size])
+
+
+def lz4(data, options):
+    return subprocess.run(['lz4', '-c', '-q'] + options, input=data, capture_output=True, check=True).stdout
+
+
+def write_archive(out_path, files, compress, embed_names, lz4_options, stored):
+    # 'files': path => size. 'stored': paths whose compression is toggled
+    # from the archive's default.
+    folders = {}
+    for path, size in files.items():
+        folder, name = path.rsplit('\\', 1)
+        folders.setdefault(folder, []).append((name, file_contents(path, size)))
+    folders = sorted(folders.items(), key=lambda f: hash_path(f[0]))
+    for _, folder_files in folders:
+        folder_files.sort(key=lambda f: hash_file(f[0]))
+
+    flags = 1 | 2 | (4 if compress else 0) | (0x100 if embed_names else 0)
+    folder_names_length = sum(len(folder) + 1 for folder, _ in folders)
+    file_names = b''.join(name.encode() + b'\0' for _, folder_files in folders for name, _ in folder_files)
+    header = struct.pack('<4sIIIIIIIHH', b'BSA\0', 105, 36, flags, len(folders), len(files),
+                         folder_names_length, len(file_names), 0, 0)
+
+    records_size = 24 * len(folders)
+    blocks_size = len(folders) + folder_names_length + 16 * len(files)
+    offset = 36 + records_size + blocks_size + len(file_names)
+    records = b''
+    blocks = b''
+    data = b''
+    for folder, folder_files in folders:
+        records += struct.pack('<QIIQ', hash_path(folder), len(folder_files), 0,
+                               36 + records_size + len(blocks) + len(file_names))
+        blocks += bytes([len(folder) + 1]) + folder.encode() + b'\0'
+        for name, contents in folder_files:
+            path = folder + '\\' + name
+            payload = b''
+            if embed_names:
+                payload += bytes([len(path)]) + path.encode()
+            toggled = path in stored
+            if compress != toggled:
+                payload += struct.pack('<I', len(contents)) + lz4(contents, lz4_options)
+            else:
+                payload += contents
+            blocks += struct.pack('<QII', hash_file(name), len(payload) | (0x40000000 if toggled else 0), offset + len(data))
+            data += payload
+
+    with open(out_path, 'wb') as out:
+        out.write(header + records + blocks + file_names + data)
+
+
+DAR = 'meshes\\actors\\character\\animations\\dynamicanimationreplacer'
+FILES = {
+    DAR + '\\_customconditions\\100\\_conditions.txt': 40,
+    DAR + '\\_customconditions\\100\\mt_idle.hkx': 3000,
+    DAR + '\\_customconditions\\100\\sub\\deep\\1hm_attack.hkx': 150000,    # several LZ4 blocks
+    DAR + '\\_customconditions\\-5\\_conditions.txt': 12,
+    DAR + '\\_customconditions\\-5\\noise.bin': 4000,                      # a stored LZ4 block
+    DAR + '\\skyrim.esm\\00000007\\mt_walk.hkx': 100,
+    'meshes\\actors\\character\\animations\\dynamicanimationreplacer-old\\x.hkx': 1,
+    'meshes\\actors\\character\\animations\\mt_idle.hkx': 4,
+}
+STORED = {DAR + '\\skyrim.esm\\00000007\\mt_walk.hkx'}
+
+if __name__ == '__main__':
+    # Linked 64 KB blocks with block checksums; and independent 64 KB
+    # blocks with the content size in the frame header and embedded names.
+    write_archive('lz4_linked.bsa', FILES, True, False, ['-B4', '-BD', '-BX'], STORED)
+    write_archive('lz4_embedded.bsa', FILES, True, True, ['-B4', '--content-size'], STORED)
+    for path in sorted(FILES):
+        print(f'{hash_file(path.rsplit(chr(92), 1)[1]):016X} {path.rsplit(chr(92), 1)[1]}')
+    for path in sorted({p.rsplit(chr(92), 1)[0] for p in FILES}):
+        print(f'{hash_path(path):016X} {path}')
@@ -0,0 +1,291 @@
+// ============================================================================
+//                             ConditionBatch.cpp
+// ----------------------------------------------------------------------------
+// Part of the open-source Dynamic Animation Replacer (DARGH).
+//
+// Copyright (c) 2023 Nox Sidereum
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the �Software�), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is furnished
+// to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED �AS IS�, WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+// FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+// DEALINGS IN THE SOFTWARE.
+//
+// (The MIT License)
+// ============================================================================
+
+#include "ConditionBatch.h"
+
+#include <xmmintrin.h>
+
+// ----------------------------------------------------------------------------
+// Batched evaluation of a condition chain for a group of actors, e.g. the
+// actors in a battle activating the same clip in the same frame.
+//
+// The chain is evaluated term by term across the group rather than actor by
+// actor. Numeric comparison terms (actor values, level, faction rank) read
+// their global arguments and look up their forms once per term, gather each
+// actor's value into a lane, and compare all the lanes against the threshold,
+// four at a time. Any other term is evaluated for each actor through the
+// pool's dispatch table, as evaluate does.
+//
+// A term is only evaluated for the actors that evaluate would evaluate it for,
+// so the results are identical to calling evaluate for each actor in turn.
+// Chains that use Random are evaluated actor by actor, in order, so that even
+// the random numbers are drawn in the same order.
+//
+// This isn't part of the plugin: the hooks decide each activation as it
+// happens, inside the engine's call, so there's never a group of activations
+// pending to batch. It's kept here, with condition_batch_test checking it
+// against evaluate, for whenever there is one.
+// ----------------------------------------------------------------------------
+
+namespace
+{
+	// Actors are evaluated in groups of up to this many, in fixed-size
+	// arrays, so that evaluating a batch doesn't allocate.
+	constexpr uint32_t LANES = 64;
+
+	// Below this many actors, the per-term bookkeeping costs more than it
+	// saves, so evaluate them one at a time.
+	constexpr std::size_t MIN_BATCH_ACTORS = 4;
+
+	enum LaneState : uint8_t
+	{
+		kPending,          // the chain's value isn't known yet
+		kTrueOr,           // the last evaluated term was true || ...
+		kFalse             // false && ..., i.e. the chain is false
+	};
+
+	enum class Compare : uint8_t
+	{
+		kLess,
+		kEqual
+	};
+
+	// How to gather the value a numeric condition function compares.
+	struct NumericFunc
+	{
+		enum class Value : uint8_t
+		{
+			kActorValue,
+			kActorValueBase,
+			kActorValueMax,
+			kActorValuePercentage,
+			kLevel,
+			kFactionRank
+		};
+
+		Value    value;
+		Compare  compare;
+		int32_t  nGlobals;           // leading arguments read with readGlobalVars
+		uint32_t threshold;          // index of the threshold among them
+	};
+
+	const NumericFunc* getNumericFunc(ConditionFuncID a_id)
+	{
+		using Value = NumericFunc::Value;
+		static constexpr NumericFunc actorValueEqual{ Value::kActorValue, Compare::kEqual, 2, 1 };
+		static constexpr NumericFunc actorValueLess{ Value::kActorValue, Compare::kLess, 2, 1 };
+		static constexpr NumericFunc baseEqual{ Value::kActorValueBase, Compare::kEqual, 2, 1 };
+		static constexpr NumericFunc baseLess{ Value::kActorValueBase, Compare::kLess, 2, 1 };
+		static constexpr NumericFunc maxEqual{ Value::kActorValueMax, Compare::kEqual, 2, 1 };
+		static constexpr NumericFunc maxLess{ Value::kActorValueMax, Compare::kLess, 2, 1 };
+		static constexpr NumericFunc percentageEqual{ Value::kActorValuePercentage, Compare::kEqual, 2, 1 };
+		static constexpr NumericFunc percentageLess{ Value::kActorValuePercentage, Compare::kLess, 2, 1 };
+		static constexpr NumericFunc levelLess{ Value::kLevel, Compare::kLess, 1, 0 };
+		static constexpr NumericFunc factionRankEqual{ Value::kFactionRank, Compare::kEqual, 1, 0 };
+		static constexpr NumericFunc factionRankLess{ Value::kFactionRank, Compare::kLess, 1, 0 };
+
+		switch (a_id) {
+		case ConditionFuncID::kIsActorValueEqualTo:            return &actorValueEqual;
+		case ConditionFuncID::kIsActorValueLessThan:           return &actorValueLess;
+		case ConditionFuncID::kIsActorValueBaseEqualTo:        return &baseEqual;
+		case ConditionFuncID::kIsActorValueBaseLessThan:       return &baseLess;
+		case ConditionFuncID::kIsActorValueMaxEqualTo:         return &maxEqual;
+		case ConditionFuncID::kIsActorValueMaxLessThan:        return &maxLess;
+		case ConditionFuncID::kIsActorValuePercentageEqualTo:  return &percentageEqual;
+		case ConditionFuncID::kIsActorValuePercentageLessThan: return &percentageLess;
+		case ConditionFuncID::kIsLevelLessThan:                return &levelLess;
+		case ConditionFuncID::kIsFactionRankEqualTo:           return &factionRankEqual;
+		case ConditionFuncID::kIsFactionRankLessThan:          return &factionRankLess;
+		default:                                               return nullptr;
+		}
+	}
+
+	void compareLanes(const float* a_values, float a_threshold, Compare a_compare, uint8_t* a_results, uint32_t a_count)
+	{
+		// a_results[i] &= (a_values[i] < a_threshold), or ==, with the same
+		// IEEE semantics as the scalar comparisons (NaN compares false).
+		const __m128 threshold = _mm_set1_ps(a_threshold);
+		uint32_t i = 0;
+		for (; i + 4 <= a_count; i += 4) {
+			const __m128 values = _mm_loadu_ps(a_values + i);
+			const int mask = _mm_movemask_ps(a_compare == Compare::kLess ?
+				_mm_cmplt_ps(values, threshold) : _mm_cmpeq_ps(values, threshold));
+			a_results[i] &= mask & 1;
+			a_results[i + 1] &= (mask >> 1) & 1;
+			a_results[i + 2] &= (mask >> 2) & 1;
+			a_results[i + 3] &= (mask >> 3) & 1;
+		}
+		for (; i < a_count; ++i) {
+			a_results[i] &= a_compare == Compare::kLess ? a_values[i] < a_threshold : a_values[i] == a_threshold;
+		}
+	}
+
+	void evaluateNumericTerm(const NumericFunc& a_func, ConditionPool::Arg* a_args, uint32_t a_bmArgIsFloat,
+		RE::Actor* const* a_actors, uint32_t a_count, uint8_t* a_results)
+	{
+		// --------------------------------------------------------------------
+		// Evaluates a numeric comparison term for 'a_count' actors, as its
+		// condition function would for each of them.
+		// --------------------------------------------------------------------
+		float globals[MAX_CONDITION_ARGS];
+		if (!readGlobalVars(globals, a_args, a_bmArgIsFloat, a_func.nGlobals)) {
+			std::fill_n(a_results, a_count, uint8_t{ 0 });
+			return;
+		}
+
+		RE::TESFaction* faction = nullptr;
+		if (a_func.value == NumericFunc::Value::kFactionRank) {
+			faction = RE::TESForm::LookupByID<RE::TESFaction>(std::get<uint32_t>(a_args[1]));
+			if (!faction) {
+				std::fill_n(a_results, a_count, uint8_t{ 0 });
+				return;
+			}
+		}
+
+		// Gather each actor's value into its lane.
+		float values[LANES];
+		std::fill_n(a_results, a_count, uint8_t{ 1 });
+		const auto gather = [&](auto a_getValue) {
+			for (uint32_t i = 0; i < a_count; ++i) {
+				values[i] = a_getValue(a_actors[i]);
+			}
+		};
+		const auto av = static_cast<RE::ActorValue>(globals[0]);
+		switch (a_func.value) {
+		case NumericFunc::Value::kActorValue:
+			gather([av](RE::Actor* a_actor) { return a_actor->GetActorValue(av); });
+			break;
+		case NumericFunc::Value::kActorValueBase:
+			gather([av](RE::Actor* a_actor) { return a_actor->GetBaseActorValue(av); });
+			break;
+		case NumericFunc::Value::kActorValueMax:
+			gather([av](RE::Actor* a_actor) { return a_actor->GetPermanentActorValue(av); });
+			break;
+		case NumericFunc::Value::kActorValuePercentage:
+			gather([avIndex = static_cast<uint32_t>(globals[0])](RE::Actor* a_actor) { return getActorValPct(a_actor, avIndex); });
+			break;
+		case NumericFunc::Value::kLevel:
+			gather([](RE::Actor* a_actor) { return static_cast<float>(a_actor->GetLevel()); });
+			break;
+		case NumericFunc::Value::kFactionRank:
+			for (uint32_t i = 0; i < a_count; ++i) {
+				const auto actor = a_actors[i];
+				if (actor->IsInFaction(faction)) {
+					values[i] = static_cast<float>(actor->GetFactionRank(faction, actor->IsPlayer()));
+				} else {
+					a_results[i] = 0;
+					values[i] = 0.0f;
+				}
+			}
+			break;
+		}
+
+		compareLanes(values, globals[a_func.threshold], a_func.compare, a_results, a_count);
+	}
+}
+
+void evaluateBatch(const ConditionPool& a_pool, uint32_t a_chain, std::span<RE::Actor* const> a_actors, uint8_t* a_results)
+{
+	if ((a_pool.chainDeps[a_chain] & kDepRandom) || a_actors.size() < MIN_BATCH_ACTORS) {
+		for (std::size_t i = 0; i < a_actors.size(); ++i) {
+			a_results[i] = a_pool.evaluate(a_chain, a_actors[i]);
+		}
+		return;
+	}
+
+	const uint32_t start = a_pool.chainStart[a_chain];
+	const uint32_t end = a_pool.chainStart[a_chain + 1];
+	for (std::size_t first = 0; first < a_actors.size(); first += LANES) {
+		const auto nLanes = static_cast<uint32_t>(std::min<std::size_t>(LANES, a_actors.size() - first));
+		RE::Actor* const* actors = a_actors.data() + first;
+
+		LaneState states[LANES];
+		std::fill_n(states, nLanes, kPending);
+		uint32_t nFalse = 0;
+
+		for (uint32_t i = start; i < end; ++i) {
+			const uint8_t f = a_pool.flags[i];
+			const bool bAnd = (f & ConditionPool::kAnd) != 0;
+			const bool bNot = (f & ConditionPool::kNot) != 0;
+
+			// Pick the lanes that evaluate would evaluate this term for (see
+			// evaluate for why the others don't need it).
+			RE::Actor* termActors[LANES];
+			uint8_t termLanes[LANES];
+			uint32_t nTermLanes = 0;
+			for (uint32_t lane = 0; lane < nLanes; ++lane) {
+				if (states[lane] == kTrueOr) {
+					if (bAnd) {
+						states[lane] = kPending;
+					}
+				} else if (states[lane] == kPending) {
+					termActors[nTermLanes] = actors[lane];
+					termLanes[nTermLanes++] = static_cast<uint8_t>(lane);
+				}
+			}
+			if (nTermLanes == 0) {
+				if (nFalse == nLanes) {
+					break;    // the chain is false for every actor
+				}
+				continue;
+			}
+
+			uint8_t conds[LANES];
+			const auto args = const_cast<ConditionPool::Arg*>(a_pool.args[i].data());
+			const uint32_t bmArgIsFloat = f >> ConditionPool::kArgIsFloatShift;
+			if (f & ConditionPool::kESPNotLoaded) {
+				std::fill_n(conds, nTermLanes, uint8_t{ 0 });
+			} else if (const auto numeric = getNumericFunc(a_pool.ops[i]);
+					   numeric && a_pool.dispatch[static_cast<std::size_t>(a_pool.ops[i])] == getConditionFunc(a_pool.ops[i]).funcPtr) {
+				evaluateNumericTerm(*numeric, args, bmArgIsFloat, termActors, nTermLanes, conds);
+			} else {
+				const auto func = a_pool.dispatch[static_cast<std::size_t>(a_pool.ops[i])];
+				for (uint32_t k = 0; k < nTermLanes; ++k) {
+					conds[k] = func(termActors[k], args, bmArgIsFloat);
+				}
+			}
+
+			for (uint32_t k = 0; k < nTermLanes; ++k) {
+				auto& state = states[termLanes[k]];
+				if ((conds[k] != 0) == bNot) {
+					// !true or false: false && ... is false, false || ... carries on.
+					if (bAnd) {
+						state = kFalse;
+						++nFalse;
+					}
+				} else {
+					state = bAnd ? kPending : kTrueOr;
+				}
+			}
+		}
+
+		for (uint32_t lane = 0; lane < nLanes; ++lane) {
+			a_results[first + lane] = states[lane] != kFalse;
+		}
+	}
+}
@@ -0,0 +1,39 @@
+// ============================================================================
+//                              ConditionBatch.h
+// ----------------------------------------------------------------------------
+// Part of the open-source Dynamic Animation Replacer (DARGH).
+//
+// Copyright (c) 2023 Nox Sidereum
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the �Software�), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is furnished
+// to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED �AS IS�, WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+// FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+// DEALINGS IN THE SOFTWARE.
+//
+// (The MIT License)
+// ============================================================================
+
+#pragma once
+
+#include "DARLink.h"
+
+// As ConditionPool::evaluate, for each of 'a_actors' in turn, into 'a_results'
+// (1 if the chain is true for the actor). See ConditionBatch.cpp.
+void evaluateBatch(const ConditionPool& a_pool, uint32_t a_chain, std::span<RE::Actor* const> a_actors, uint8_t* a_results);
+
+// Conditions.cpp's, which the batched numeric terms share.
+bool readGlobalVars(float* a_values, std::variant<uint32_t, float>* a_args, uint32_t a_bmArgIsFloat, int32_t a_nArgs);
+float getActorValPct(RE::Actor* a_actor, uint32_t a_value);
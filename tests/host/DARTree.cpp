@@ -0,0 +1,445 @@
+// ============================================================================
+//                                DARTree.cpp
+// ----------------------------------------------------------------------------
+// Part of the open-source Dynamic Animation Replacer (DARGH).
+//
+// Copyright (c) 2023 Nox Sidereum
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the �Software�), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is furnished
+// to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED �AS IS�, WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+// FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+// DEALINGS IN THE SOFTWARE.
+//
+// (The MIT License)
+// ============================================================================
+
+#include "DARTree.h"
+#include "DARCompiler.h"
+#include "DARPack.h"
+#include "Plugin.h"
+#include "Utilities.h"
+
+#include <chrono>
+#include <fstream>
+#include <random>
+#include <set>
+#include <sstream>
+
+namespace DARTree
+{
+	uint64_t g_nConditionCalls = 0;
+	uint32_t g_worldState = 0;
+}
+
+namespace
+{
+	// Where the choices go, so that the replays aren't optimised away.
+	volatile int64_t g_sink;
+}
+
+namespace
+{
+	using DARTree::g_nConditionCalls;
+	using DARTree::g_worldState;
+
+	uint64_t mix(uint64_t a_hash)
+	{
+		// splitmix64 finalizer.
+		a_hash = (a_hash ^ (a_hash >> 30)) * 0xBF58476D1CE4E5B9ull;
+		a_hash = (a_hash ^ (a_hash >> 27)) * 0x94D049BB133111EBull;
+		return a_hash ^ (a_hash >> 31);
+	}
+
+	uint32_t formArg(std::variant<uint32_t, float>* a_args)
+	{
+		return std::holds_alternative<uint32_t>(a_args[0]) ? std::get<uint32_t>(a_args[0]) : 0;
+	}
+
+	float floatArg(std::variant<uint32_t, float>* a_args, float a_default)
+	{
+		return std::holds_alternative<float>(a_args[0]) ? std::get<float>(a_args[0]) : a_default;
+	}
+
+	template <ConditionFuncID ID>
+	bool standIn(RE::Actor* a_actor, std::variant<uint32_t, float>* a_args, uint32_t)
+	{
+		++g_nConditionCalls;
+
+		const auto base = a_actor->GetActorBase();
+		const auto formID = [](const RE::TESForm* a_form) { return a_form ? a_form->GetFormID() : 0; };
+		switch (ID) {
+		case ConditionFuncID::kIsFemale:
+			return base->IsFemale();
+		case ConditionFuncID::kIsUnique:
+			return base->IsUnique();
+		case ConditionFuncID::kIsChild:
+			return mix(formID(a_actor->GetRace())) % 10 == 0;
+		case ConditionFuncID::kIsActorBase:
+			return base->GetFormID() == formArg(a_args);
+		case ConditionFuncID::kIsRace:
+			return formID(a_actor->GetRace()) == formArg(a_args);
+		case ConditionFuncID::kIsClass:
+			return formID(base->npcClass) == formArg(a_args);
+		case ConditionFuncID::kIsCombatStyle:
+			return formID(base->combatStyle) == formArg(a_args);
+		case ConditionFuncID::kIsVoiceType:
+			return formID(base->voiceType) == formArg(a_args);
+		default:
+			break;
+		}
+
+		uint64_t hash = mix((static_cast<uint64_t>(ID) << 32) ^ a_actor->GetFormID());
+		hash = mix(hash ^ g_worldState);
+		for (uint32_t i = 0; i < MAX_CONDITION_ARGS; ++i) {
+			const auto& arg = a_args[i];
+			hash = mix(hash ^ (arg.index() == 0 ? std::get<uint32_t>(arg) : std::bit_cast<uint32_t>(std::get<float>(arg))));
+		}
+		if (ID == ConditionFuncID::kRandom) {
+			return floatArg(a_args, 0.5f) > static_cast<float>(hash % 1000) / 1000.0f;
+		}
+		return hash % 100 < 40;
+	}
+
+	// As the table in Conditions.cpp, with the stand-ins.
+	constexpr std::array<FuncInfo, static_cast<std::size_t>(ConditionFuncID::kTotal)> g_funcs
+	{{
+		{ "IsEquippedRight",                standIn<ConditionFuncID::kIsEquippedRight>,                      ConditionFuncID::kIsEquippedRight,                1, 0, CostClass::kTrivial, kDepEquipment },
+		{ "IsEquippedRightType",            standIn<ConditionFuncID::kIsEquippedRightType>,                  ConditionFuncID::kIsEquippedRightType,            1, 1, CostClass::kLookup,  kDepEquipment | kDepGlobals },
+		{ "IsEquippedRightHasKeyword",      standIn<ConditionFuncID::kIsEquippedRightHasKeyword>,            ConditionFuncID::kIsEquippedRightHasKeyword,      1, 0, CostClass::kLookup,  kDepEquipment },
+		{ "IsEquippedLeft",                 standIn<ConditionFuncID::kIsEquippedLeft>,                       ConditionFuncID::kIsEquippedLeft,                 1, 0, CostClass::kTrivial, kDepEquipment },
+		{ "IsEquippedLeftType",             standIn<ConditionFuncID::kIsEquippedLeftType>,                   ConditionFuncID::kIsEquippedLeftType,             1, 1, CostClass::kLookup,  kDepEquipment | kDepGlobals },
+		{ "IsEquippedLeftHasKeyword",       standIn<ConditionFuncID::kIsEquippedLeftHasKeyword>,             ConditionFuncID::kIsEquippedLeftHasKeyword,       1, 0, CostClass::kLookup,  kDepEquipment },
+		{ "IsEquippedShout",                standIn<ConditionFuncID::kIsEquippedShout>,                      ConditionFuncID::kIsEquippedShout,                1, 0, CostClass::kTrivial, kDepEquipment },
+		{ "IsWorn",                         standIn<ConditionFuncID::kIsWorn>,                               ConditionFuncID::kIsWorn,                         1, 0, CostClass::kScan,    kDepInventory },
+		{ "IsWornHasKeyword",               standIn<ConditionFuncID::kIsWornHasKeyword>,                     ConditionFuncID::kIsWornHasKeyword,               1, 0, CostClass::kScan,    kDepInventory },
+		{ "IsFemale",                       standIn<ConditionFuncID::kIsFemale>,                             ConditionFuncID::kIsFemale,                       0, 0, CostClass::kTrivial, kDepActorBase },
+		{ "IsChild",                        standIn<ConditionFuncID::kIsChild>,                              ConditionFuncID::kIsChild,                        0, 0, CostClass::kTrivial, kDepRace },
+		{ "IsPlayerTeammate",               standIn<ConditionFuncID::kIsPlayerTeammate>,                     ConditionFuncID::kIsPlayerTeammate,               0, 0, CostClass::kTrivial, kDepActorState },
+		{ "IsInInterior",                   standIn<ConditionFuncID::kIsInInterior>,                         ConditionFuncID::kIsInInterior,                   0, 0, CostClass::kTrivial, kDepLocation },
+		{ "IsInFaction",                    standIn<ConditionFuncID::kIsInFaction>,                          ConditionFuncID::kIsInFaction,                    1, 0, CostClass::kScan,    kDepFactions },
+		{ "HasKeyword",                     standIn<ConditionFuncID::kHasKeyword>,                           ConditionFuncID::kHasKeyword,                     1, 0, CostClass::kLookup,  kDepActorBase },
+		{ "HasMagicEffect",                 standIn<ConditionFuncID::kHasMagicEffect>,                       ConditionFuncID::kHasMagicEffect,                 1, 0, CostClass::kScan,    kDepMagic },
+		{ "HasMagicEffectWithKeyword",      standIn<ConditionFuncID::kHasMagicEffectWithKeyword>,            ConditionFuncID::kHasMagicEffectWithKeyword,      1, 0, CostClass::kScan,    kDepMagic },
+		{ "HasPerk",                        standIn<ConditionFuncID::kHasPerk>,                              ConditionFuncID::kHasPerk,                        1, 0, CostClass::kLookup,  kDepMagic },
+		{ "HasSpell",                       standIn<ConditionFuncID::kHasSpell>,                             ConditionFuncID::kHasSpell,                       1, 0, CostClass::kScan,    kDepMagic },
+		{ "IsActorValueEqualTo",            standIn<ConditionFuncID::kIsActorValueEqualTo>,                  ConditionFuncID::kIsActorValueEqualTo,            2, 3, CostClass::kLookup,  kDepActorValues | kDepGlobals },
+		{ "IsActorValueLessThan",           standIn<ConditionFuncID::kIsActorValueLessThan>,                 ConditionFuncID::kIsActorValueLessThan,           2, 3, CostClass::kLookup,  kDepActorValues | kDepGlobals },
+		{ "IsActorValueBaseEqualTo",        standIn<ConditionFuncID::kIsActorValueBaseEqualTo>,              ConditionFuncID::kIsActorValueBaseEqualTo,        2, 3, CostClass::kLookup,  kDepActorValues | kDepGlobals },
+		{ "IsActorValueBaseLessThan",       standIn<ConditionFuncID::kIsActorValueBaseLessThan>,             ConditionFuncID::kIsActorValueBaseLessThan,       2, 3, CostClass::kLookup,  kDepActorValues | kDepGlobals },
+		{ "IsActorValueMaxEqualTo",         standIn<ConditionFuncID::kIsActorValueMaxEqualTo>,               ConditionFuncID::kIsActorValueMaxEqualTo,         2, 3, CostClass::kLookup,  kDepActorValues | kDepGlobals },
+		{ "IsActorValueMaxLessThan",        standIn<ConditionFuncID::kIsActorValueMaxLessThan>,              ConditionFuncID::kIsActorValueMaxLessThan,        2, 3, CostClass::kLookup,  kDepActorValues | kDepGlobals },
+		{ "IsActorValuePercentageEqualTo",  standIn<ConditionFuncID::kIsActorValuePercentageEqualTo>,        ConditionFuncID::kIsActorValuePercentageEqualTo,  2, 3, CostClass::kLookup,  kDepActorValues | kDepGlobals },
+		{ "IsActorValuePercentageLessThan", standIn<ConditionFuncID::kIsActorValuePercentageLessThan>,       ConditionFuncID::kIsActorValuePercentageLessThan, 2, 3, CostClass::kLookup,  kDepActorValues | kDepGlobals },
+		{ "IsLevelLessThan",                standIn<ConditionFuncID::kIsLevelLessThan>,                      ConditionFuncID::kIsLevelLessThan,                1, 1, CostClass::kTrivial, kDepActorValues | kDepGlobals },
+		{ "IsActorBase",                    standIn<ConditionFuncID::kIsActorBase>,                          ConditionFuncID::kIsActorBase,                    1, 0, CostClass::kTrivial, kDepActorBase },
+		{ "IsRace",                         standIn<ConditionFuncID::kIsRace>,                               ConditionFuncID::kIsRace,                         1, 0, CostClass::kTrivial, kDepRace },
+		{ "CurrentWeather",                 standIn<ConditionFuncID::kCurrentWeather>,                       ConditionFuncID::kCurrentWeather,                 1, 0, CostClass::kTrivial, kDepWorld },
+		{ "CurrentGameTimeLessThan",        standIn<ConditionFuncID::kCurrentGameTimeLessThan>,              ConditionFuncID::kCurrentGameTimeLessThan,        1, 1, CostClass::kTrivial, kDepWorld | kDepGlobals },
+		{ "ValueEqualTo",                   standIn<ConditionFuncID::kValueEqualTo>,                         ConditionFuncID::kValueEqualTo,                   2, 3, CostClass::kTrivial, kDepGlobals },
+		{ "ValueLessThan",                  standIn<ConditionFuncID::kValueLessThan>,                        ConditionFuncID::kValueLessThan,                  2, 3, CostClass::kTrivial, kDepGlobals },
+		{ "Random",                         standIn<ConditionFuncID::kRandom>,                               ConditionFuncID::kRandom,                         1, 1, CostClass::kLookup,  kDepRandom | kDepGlobals },
+		{ "IsUnique",                       standIn<ConditionFuncID::kIsUnique>,                             ConditionFuncID::kIsUnique,                       0, 0, CostClass::kTrivial, kDepActorBase },
+		{ "IsClass",                        standIn<ConditionFuncID::kIsClass>,                              ConditionFuncID::kIsClass,                        1, 0, CostClass::kTrivial, kDepActorBase },
+		{ "IsCombatStyle",                  standIn<ConditionFuncID::kIsCombatStyle>,                        ConditionFuncID::kIsCombatStyle,                  1, 0, CostClass::kTrivial, kDepActorBase },
+		{ "IsVoiceType",                    standIn<ConditionFuncID::kIsVoiceType>,                          ConditionFuncID::kIsVoiceType,                    1, 0, CostClass::kTrivial, kDepActorBase },
+		{ "IsAttacking",                    standIn<ConditionFuncID::kIsAttacking>,                          ConditionFuncID::kIsAttacking,                    0, 0, CostClass::kTrivial, kDepActorState },
+		{ "IsRunning",                      standIn<ConditionFuncID::kIsRunning>,                            ConditionFuncID::kIsRunning,                      0, 0, CostClass::kTrivial, kDepActorState },
+		{ "IsSneaking",                     standIn<ConditionFuncID::kIsSneaking>,                           ConditionFuncID::kIsSneaking,                     0, 0, CostClass::kTrivial, kDepActorState },
+		{ "IsSprinting",                    standIn<ConditionFuncID::kIsSprinting>,                          ConditionFuncID::kIsSprinting,                    0, 0, CostClass::kTrivial, kDepActorState },
+		{ "IsInAir",                        standIn<ConditionFuncID::kIsInAir>,                              ConditionFuncID::kIsInAir,                        0, 0, CostClass::kTrivial, kDepActorState },
+		{ "IsInCombat",                     standIn<ConditionFuncID::kIsInCombat>,                           ConditionFuncID::kIsInCombat,                     0, 0, CostClass::kTrivial, kDepActorState },
+		{ "IsWeaponDrawn",                  standIn<ConditionFuncID::kIsWeaponDrawn>,                        ConditionFuncID::kIsWeaponDrawn,                  0, 0, CostClass::kTrivial, kDepActorState },
+		{ "IsInLocation",                   standIn<ConditionFuncID::kIsInLocation>,                         ConditionFuncID::kIsInLocation,                   1, 0, CostClass::kLookup,  kDepLocation },
+		{ "HasRefType",                     standIn<ConditionFuncID::kHasRefType>,                           ConditionFuncID::kHasRefType,                     1, 0, CostClass::kLookup,  kDepLocation },
+		{ "IsParentCell",                   standIn<ConditionFuncID::kIsParentCell>,                         ConditionFuncID::kIsParentCell,                   1, 0, CostClass::kTrivial, kDepLocation },
+		{ "IsWorldSpace",                   standIn<ConditionFuncID::kIsWorldSpace>,                         ConditionFuncID::kIsWorldSpace,                   1, 0, CostClass::kTrivial, kDepLocation },
+		{ "IsFactionRankEqualTo",           standIn<ConditionFuncID::kIsFactionRankEqualTo>,                 ConditionFuncID::kIsFactionRankEqualTo,           2, 1, CostClass::kScan,    kDepFactions | kDepGlobals },
+		{ "IsFactionRankLessThan",          standIn<ConditionFuncID::kIsFactionRankLessThan>,                ConditionFuncID::kIsFactionRankLessThan,          2, 1, CostClass::kScan,    kDepFactions | kDepGlobals },
+		{ "IsMovementDirection",            standIn<ConditionFuncID::kIsMovementDirection>,                  ConditionFuncID::kIsMovementDirection,            1, 1, CostClass::kTrivial, kDepActorState | kDepGlobals },
+	}};
+
+	struct Forms
+	{
+		std::set<RE::FormID> bases;
+		std::set<RE::FormID> races;
+		std::set<RE::FormID> classes;
+		std::set<RE::FormID> combatStyles;
+		std::set<RE::FormID> voiceTypes;
+	};
+
+	template <class T>
+	void makeForms(const std::set<RE::FormID>& a_named, RE::FormID a_first, std::vector<T>& a_forms)
+	{
+		// The forms named, then as many others.
+		a_forms.resize(2 * a_named.size() + 1);
+		auto form = a_forms.begin();
+		for (const auto id : a_named) {
+			(form++)->formID = id;
+		}
+		for (RE::FormID id = a_first; form != a_forms.end(); ++id) {
+			(form++)->formID = id;
+		}
+	}
+}
+
+const FuncInfo* findConditionFunc(std::string_view a_name)
+{
+	for (const auto& func : g_funcs) {
+		if (func.name == a_name) {
+			return &func;
+		}
+	}
+	return nullptr;
+}
+
+const FuncInfo& getConditionFunc(ConditionFuncID a_id)
+{
+	return g_funcs[static_cast<std::size_t>(a_id)];
+}
+
+uint32_t numConditionFuncs()
+{
+	return static_cast<uint32_t>(g_funcs.size());
+}
+
+namespace DARTree
+{
+	bool loadProject(const std::filesystem::path& a_path, DARProject& a_project)
+	{
+		// std::string's heap buffer is aligned for the pack's tables, as in loadDARPack.
+		std::string data;
+		if (std::filesystem::is_directory(a_path)) {
+			std::ostringstream log;
+			const auto pack = compileDARTree(a_path, log);
+			data.assign(pack.begin(), pack.end());
+			std::printf("%s", log.str().c_str());
+		} else {
+			std::ifstream file(a_path, std::ios::binary);
+			data.assign(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+		}
+
+		DARPack::View pack;
+		if (data.empty() || !pack.open(data.data(), data.size())) {
+			std::printf("%s: not a DynamicAnimationReplacer folder or a .darpack\n", a_path.string().c_str());
+			return false;
+		}
+
+		a_project.folderData = std::make_shared<DARFolderData>();
+		auto& folderData = *a_project.folderData;
+		folderData.projFolder = a_project.projFolder = a_path.filename().string();
+
+		const auto getPaths = [&pack](DARPack::Range a_range) {
+			std::vector<std::string> paths;
+			for (const auto path : DARPack::View::slice(pack.paths(), a_range)) {
+				paths.emplace_back(pack.string(path));
+			}
+			return paths;
+		};
+
+		// Plugin i of the table is loaded at index i + 1, and none is light.
+		const auto modIndex = [](uint32_t a_plugin) { return (a_plugin + 1) << 24; };
+
+		// As storeActorBaseLinks.
+		for (const auto& folder : pack.actorBaseFolders()) {
+			for (const auto& hkxFile : getPaths(folder.paths)) {
+				ActorBaseLink link;
+				link.from_hkx_file = "Animations\\" + hkxFile;
+				toLowerASCII(link.from_hkx_file);
+				link.to_hkx_file = std::string("Animations\\DynamicAnimationReplacer\\") +
+				                   pack.string(pack.plugins()[folder.plugin]) + "\\" + pack.string(folder.name) + "\\" + hkxFile;
+				link.actorBaseID = modIndex(folder.plugin) + folder.actorBaseID;
+				folderData.actorBaseLinks.push_back(std::move(link));
+			}
+		}
+
+		// As loadDARPack and storeConditionLinks.
+		for (const auto& folder : pack.priorityFolders()) {
+			if (folder.errorLine != DARPack::NO_STRING) {
+				continue;
+			}
+
+			bool bValid = true;
+			std::vector<ConditionLinkFunc> conditions;
+			for (const auto& term : DARPack::View::slice(pack.terms(), folder.terms)) {
+				const FuncInfo* funcInfo = findConditionFunc(pack.string(term.funcName));
+				const auto termArgs = DARPack::View::slice(pack.args(), term.args);
+				if (!funcInfo || termArgs.size() != funcInfo->nArgs) {
+					bValid = false;
+					break;
+				}
+
+				ConditionLinkFunc condition;
+				condition.funcPtr = funcInfo->funcPtr;
+				condition.funcID = funcInfo->id;
+				condition.bmArgIsFloat = 0;
+				condition.bNot = (term.flags & DARPack::kNot) != 0;
+				condition.bAnd = (term.flags & DARPack::kAnd) != 0;
+				for (const auto& arg : termArgs) {
+					if (arg.kind == DARPack::ArgKind::kFloat) {
+						condition.bmArgIsFloat |= 1 << condition.args.size();
+						condition.args.push_back(std::bit_cast<float>(arg.value));
+					} else {
+						condition.args.push_back(modIndex(arg.plugin) + arg.value);
+					}
+				}
+				conditions.push_back(std::move(condition));
+			}
+			if (!bValid) {
+				std::printf("%s: _CustomConditions\\%s: unknown condition function, ignored\n",
+					folderData.projFolder.c_str(), pack.string(folder.name));
+				continue;
+			}
+
+			for (const auto& hkxFile : getPaths(folder.paths)) {
+				ConditionLink link;
+				link.from_hkx_file = "Animations\\" + hkxFile;
+				toLowerASCII(link.from_hkx_file);
+				link.to_hkx_file = std::string("Animations\\DynamicAnimationReplacer\\_CustomConditions\\") +
+				                   pack.string(folder.name) + "\\" + hkxFile;
+				link.priority = folder.priority;
+				link.conditions = conditions;
+				folderData.conditionLinks.push_back(std::move(link));
+			}
+		}
+
+		// As Plugin.cpp.
+		DARGH::indexDARLinks(folderData);
+		DARGH::buildConditionPool(folderData);
+		if (Plugin::COMPILE_DECISION_DIAGRAMS) {
+			DARGH::compileDecisionDAGs(folderData);
+		}
+
+		// The project's animations are the FROM files, in name order.
+		std::set<std::string_view> fromFiles;
+		for (const auto& link : folderData.actorBaseLinks) {
+			fromFiles.insert(link.from_hkx_file);
+		}
+		for (const auto& link : folderData.conditionLinks) {
+			fromFiles.insert(link.from_hkx_file);
+		}
+		std::vector<const char*> names;
+		for (const auto file : fromFiles) {
+			names.push_back(file.data());
+		}
+
+		a_project.remapPlan = DARGH::getRemapPlan(a_project, a_project.projFolder, names.data(), static_cast<uint32_t>(names.size()));
+		return true;
+	}
+
+	std::vector<int16_t> contestedIndices(const DARRemapPlan& a_plan)
+	{
+		std::vector<int16_t> indices;
+		for (const auto& [fromIndex, links] : a_plan.allLinks) {
+			if (links.size() > 1) {
+				indices.push_back(static_cast<int16_t>(fromIndex));
+			}
+		}
+		std::sort(indices.begin(), indices.end());
+		return indices;
+	}
+
+	void makeActors(const DARFolderData& a_folderData, uint32_t a_nActors, Actors& a_actors)
+	{
+		Forms forms;
+		for (const auto& link : a_folderData.actorBaseLinks) {
+			forms.bases.insert(link.actorBaseID);
+		}
+		const auto& pool = a_folderData.conditionPool;
+		for (uint32_t i = 0; i < pool.numTerms(); ++i) {
+			const auto& arg = pool.args[i][0];
+			if (arg.index() != 0) {
+				continue;
+			}
+			switch (pool.ops[i]) {
+			case ConditionFuncID::kIsActorBase:
+				forms.bases.insert(std::get<uint32_t>(arg));
+				break;
+			case ConditionFuncID::kIsRace:
+				forms.races.insert(std::get<uint32_t>(arg));
+				break;
+			case ConditionFuncID::kIsClass:
+				forms.classes.insert(std::get<uint32_t>(arg));
+				break;
+			case ConditionFuncID::kIsCombatStyle:
+				forms.combatStyles.insert(std::get<uint32_t>(arg));
+				break;
+			case ConditionFuncID::kIsVoiceType:
+				forms.voiceTypes.insert(std::get<uint32_t>(arg));
+				break;
+			default:
+				break;
+			}
+		}
+
+		makeForms(forms.races, 0xFE000100, a_actors.races);
+		makeForms(forms.classes, 0xFE000200, a_actors.classes);
+		makeForms(forms.combatStyles, 0xFE000300, a_actors.combatStyles);
+		makeForms(forms.voiceTypes, 0xFE000400, a_actors.voiceTypes);
+		makeForms(forms.bases, 0xFE001000, a_actors.bases);
+
+		std::mt19937 random(1);
+		const auto pick = [&random](auto& a_forms) { return &a_forms[random() % a_forms.size()]; };
+		for (auto& base : a_actors.bases) {
+			base.npcClass = pick(a_actors.classes);
+			base.combatStyle = pick(a_actors.combatStyles);
+			base.voiceType = pick(a_actors.voiceTypes);
+			base.female = random() % 2;
+			base.unique = random() % 10 == 0;
+		}
+
+		a_actors.actors.resize(a_nActors);
+		for (uint32_t i = 0; i < a_nActors; ++i) {
+			auto& actor = a_actors.actors[i];
+			actor.formID = 0xFF000800 + i;
+			actor.base = pick(a_actors.bases);
+			actor.race = pick(a_actors.races);
+		}
+	}
+
+	std::vector<Activation> makeActivations(Actors& a_actors, const std::vector<int16_t>& a_indices, uint32_t a_nWorldStates)
+	{
+		std::vector<Activation> activations;
+		activations.reserve(a_actors.actors.size() * a_indices.size() * a_nWorldStates);
+		for (uint32_t worldState = 0; worldState < a_nWorldStates; ++worldState) {
+			for (auto& actor : a_actors.actors) {
+				for (const auto index : a_indices) {
+					activations.push_back({ &actor, worldState, index });
+				}
+			}
+		}
+		return activations;
+	}
+
+	Replay replay(DARProject& a_project, const std::vector<Activation>& a_activations, std::vector<int16_t>* a_choices)
+	{
+		Replay result;
+		int64_t sink = 0;
+		const uint64_t nCalls = g_nConditionCalls;
+		const auto start = std::chrono::steady_clock::now();
+		for (const auto& activation : a_activations) {
+			g_worldState = activation.worldState;
+			const auto index = DARGH::getNewAnimIndex(&a_project, activation.fromIndex, activation.actor);
+			if (a_choices) {
+				a_choices->push_back(index);
+			}
+			sink += index;
+		}
+		result.ns = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count();
+		result.nCalls = g_nConditionCalls - nCalls;
+		g_sink = sink;
+		return result;
+	}
+}
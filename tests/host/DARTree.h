@@ -0,0 +1,102 @@
+// ============================================================================
+//                                 DARTree.h
+// ----------------------------------------------------------------------------
+// Part of the open-source Dynamic Animation Replacer (DARGH).
+//
+// Copyright (c) 2023 Nox Sidereum
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the �Software�), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is furnished
+// to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED �AS IS�, WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+// FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+// DEALINGS IN THE SOFTWARE.
+//
+// (The MIT License)
+// ============================================================================
+
+// ----------------------------------------------------------------------------
+// A real DynamicAnimationReplacer tree, loaded on the host for the benches.
+//
+// The tree (or a .darpack compiled from one) is read with the darpack
+// compiler, and its links stored as loadDARPack stores them, with every
+// plugin in its table loaded. The folder is then built as Plugin.cpp builds
+// one (see DARFolderData.cpp), following Plugin::CACHE_STATIC_CONDITIONS and
+// Plugin::COMPILE_DECISION_DIAGRAMS, and its remap plan by getRemapPlan.
+// Constant terms aren't folded (simplifyConditions needs the game).
+//
+// The condition functions are stand-ins that count their calls. The static
+// ones (see StaticConditions.h) read the actor as the real ones do. The
+// others (and Random) give a result that is a pure function of the term, the
+// actor and g_worldState, true about 40% of the time, so that every way of
+// evaluating the same activation gets the same results.
+// ----------------------------------------------------------------------------
+
+#include "DARProjectRegistry.h"
+
+namespace DARTree
+{
+	// Condition function calls so far.
+	extern uint64_t g_nConditionCalls;
+
+	// What the stand-ins for the actor's state and the world read. Changing
+	// it is the game moving on.
+	extern uint32_t g_worldState;
+
+	// Loads the tree at 'a_path' (...\animations\DynamicAnimationReplacer,
+	// or a .darpack file) into 'a_project', and builds its folder and its
+	// remap plan over every FROM file. Returns false, having said why, if it
+	// can't be read.
+	bool loadProject(const std::filesystem::path& a_path, DARProject& a_project);
+
+	// The from_hkx_indexes of 'a_plan' with more than one candidate mapping.
+	std::vector<int16_t> contestedIndices(const DARRemapPlan& a_plan);
+
+	// Made-up actors for a folder's conditions: their bases, races, classes,
+	// combat styles and voice types are drawn from those the conditions and
+	// the M1 folders name, and from as many others.
+	struct Actors
+	{
+		std::vector<RE::TESRace> races;
+		std::vector<RE::TESClass> classes;
+		std::vector<RE::TESCombatStyle> combatStyles;
+		std::vector<RE::BGSVoiceType> voiceTypes;
+		std::vector<RE::TESNPC> bases;
+		std::vector<RE::Actor> actors;
+	};
+
+	void makeActors(const DARFolderData& a_folderData, uint32_t a_nActors, Actors& a_actors);
+
+	// An actor activating the animation at 'fromIndex', in a world state.
+	struct Activation
+	{
+		RE::Actor* actor;
+		uint32_t worldState;
+		int16_t fromIndex;
+	};
+
+	// Every actor activating every one of 'a_indices', in each of
+	// 'a_nWorldStates' world states.
+	std::vector<Activation> makeActivations(Actors& a_actors, const std::vector<int16_t>& a_indices, uint32_t a_nWorldStates);
+
+	struct Replay
+	{
+		uint64_t nCalls = 0;                           // condition function calls
+		double ns = 0.0;
+	};
+
+	// Decides 'a_activations' with getNewAnimIndex, in order, and appends
+	// the choices to 'a_choices' if it isn't null.
+	Replay replay(DARProject& a_project, const std::vector<Activation>& a_activations, std::vector<int16_t>* a_choices);
+}
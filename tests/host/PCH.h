@@ -0,0 +1,299 @@
+// ============================================================================
+//                                   PCH.h
+// ----------------------------------------------------------------------------
+// Part of the open-source Dynamic Animation Replacer (DARGH).
+//
+// Copyright (c) 2023 Nox Sidereum
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the �Software�), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is furnished
+// to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED �AS IS�, WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+// FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+// DEALINGS IN THE SOFTWARE.
+//
+// (The MIT License)
+// ============================================================================
+
+#pragma once
+
+// ----------------------------------------------------------------------------
+// Stand-in for src/PCH.h, to build engine sources on the host (e.g. Linux),
+// without the game or CommonLibSSE. It declares the part of CommonLibSSE
+// that those sources use, as plain data that a test sets up: forms are just
+// their IDs, and an actor is the state its conditions read.
+//
+// Only sources that don't hook or call into the game can be built this way
+// (e.g. StaticConditions.cpp, WorldSnapshot.cpp, Utilities.cpp). Functions of the real engine they call (e.g. the condition
+// functions in Conditions.cpp) are provided by the test.
+// ----------------------------------------------------------------------------
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <bit>
+#include <cassert>
+#include <cmath>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
+#include <format>
+#include <fstream>
+#include <functional>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <numbers>
+#include <optional>
+#include <span>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <unordered_map>
+#include <unordered_set>
+#include <utility>
+#include <variant>
+#include <vector>
+
+namespace RE
+{
+	using FormID = uint32_t;
+
+	enum class ActorValue : uint32_t
+	{
+		kTotal = 164,
+		kNone = 255
+	};
+
+	enum class FormType : uint8_t
+	{
+		NPC = 43,
+		ActorCharacter = 62
+	};
+
+	struct TESForm
+	{
+		FormID formID{ 0 };
+
+		FormID GetFormID() const { return formID; }
+
+		// Defined by the test, for the form types it uses.
+		template <class T = TESForm>
+		static T* LookupByID(FormID a_formID);
+	};
+
+	struct TESClass : TESForm {};
+	struct TESCombatStyle : TESForm {};
+	struct BGSVoiceType : TESForm {};
+	struct TESRace : TESForm {};
+	struct TESFaction : TESForm {};
+	struct TESWeather : TESForm {};
+
+	struct TESGlobal : TESForm
+	{
+		float value{ 0.0f };
+	};
+
+	struct TESNPC : TESForm
+	{
+		TESClass*       npcClass{ nullptr };
+		TESCombatStyle* combatStyle{ nullptr };
+		BGSVoiceType*   voiceType{ nullptr };
+		bool            female{ false };
+		bool            unique{ false };
+
+		bool IsFemale() const { return female; }
+		bool IsUnique() const { return unique; }
+	};
+
+	struct Actor : TESForm
+	{
+		TESNPC*  base{ nullptr };
+		TESRace* race{ nullptr };
+		std::array<float, static_cast<std::size_t>(ActorValue::kTotal)> values{};
+		std::array<float, static_cast<std::size_t>(ActorValue::kTotal)> baseValues{};
+		std::array<float, static_cast<std::size_t>(ActorValue::kTotal)> permanentValues{};
+		FormType formType{ FormType::ActorCharacter };
+		uint16_t level{ 1 };
+		std::vector<std::pair<const TESFaction*, int32_t>> factionRanks;
+		bool player{ false };
+
+		TESNPC* GetActorBase() const { return base; }
+		TESRace* GetRace() const { return race; }
+		float GetActorValue(ActorValue a_value) const { return values[static_cast<std::size_t>(a_value)]; }
+		float GetBaseActorValue(ActorValue a_value) const { return baseValues[static_cast<std::size_t>(a_value)]; }
+		float GetPermanentActorValue(ActorValue a_value) const { return permanentValues[static_cast<std::size_t>(a_value)]; }
+		uint16_t GetLevel() const { return level; }
+		bool IsPlayer() const { return player; }
+		bool Is(FormType a_type) const { return formType == a_type; }
+
+		bool IsInFaction(const TESFaction* a_faction) const
+		{
+			return std::any_of(factionRanks.begin(), factionRanks.end(), [&](const auto& a_rank) { return a_rank.first == a_faction; });
+		}
+
+		int32_t GetFactionRank(const TESFaction* a_faction, bool) const
+		{
+			for (const auto& [faction, rank] : factionRanks) {
+				if (faction == a_faction) {
+					return rank;
+				}
+			}
+			return -2;
+		}
+	};
+
+	struct Sky
+	{
+		TESWeather* currentWeather{ nullptr };
+
+		static Sky* GetSingleton();                    // defined by the test
+	};
+
+	struct Calendar
+	{
+		float gameTime{ 0.0f };                        // days passed
+
+		float GetCurrentGameTime() const { return gameTime; }
+		float GetHoursPerDay() const { return 24.0f; }
+
+		static Calendar* GetSingleton();               // defined by the test
+	};
+
+	struct BSSpinLock
+	{
+		std::mutex mutex;
+	};
+
+	class BSSpinLockGuard
+	{
+	public:
+		explicit BSSpinLockGuard(BSSpinLock& a_lock) : guard(a_lock.mutex) {}
+
+	private:
+		std::lock_guard<std::mutex> guard;
+	};
+
+	// The in-game message box: there is none here.
+	template <class... Args>
+	void CreateMessage(const char*, Args...) {}
+
+	struct hkbProjectData {};
+
+	template <class T>
+	class hkRefPtr
+	{
+	public:
+		hkRefPtr(std::nullptr_t = nullptr) {}
+		explicit hkRefPtr(T* a_ptr) : ptr(a_ptr) {}
+		T* get() const { return ptr; }
+		void reset() { ptr = nullptr; }
+		explicit operator bool() const { return ptr != nullptr; }
+		bool operator==(const hkRefPtr&) const = default;
+
+	private:
+		T* ptr{ nullptr };
+	};
+
+	// What the hooks read of a clip activation's context (see ClipActivation.cpp).
+	struct hkbCharacter
+	{
+		hkRefPtr<hkbProjectData> projectData;
+	};
+
+	struct hkbContext
+	{
+		hkbCharacter* character{ nullptr };
+	};
+
+	struct hkbClipGenerator
+	{
+		int16_t animationBindingIndex{ -1 };
+	};
+
+	// The hooks find the actor from its character, at offset 0xC0.
+	struct BShkbAnimationGraph
+	{
+		Actor*       holder{ nullptr };
+		char         pad08[0xC0 - sizeof(Actor*)];
+		hkbCharacter characterInstance;
+	};
+	static_assert(offsetof(BShkbAnimationGraph, characterInstance) == 0xC0);
+
+	// For the declarations in DebugUtils.h.
+	template <class T>
+	struct hkArray {};
+	struct hkStringPtr {};
+	struct hkbAssetBundleStringData {};
+	struct hkbCharacterStringData
+	{
+		struct FileNameMeshNamePair {};
+	};
+}
+
+// For the declarations in Plugin.h.
+namespace SKSE
+{
+	struct MessagingInterface
+	{
+		struct Message;
+	};
+}
+
+// The directory search Utilities.cpp does on Windows: finds nothing here.
+namespace REX::W32
+{
+	constexpr std::uint32_t FILE_ATTRIBUTE_DIRECTORY = 0x10;
+	inline void* const INVALID_HANDLE_VALUE = reinterpret_cast<void*>(-1);
+
+	struct WIN32_FIND_DATAA
+	{
+		std::uint32_t fileAttributes;
+		char fileName[260];
+	};
+
+	inline void* FindFirstFileA(const char*, WIN32_FIND_DATAA*) { return INVALID_HANDLE_VALUE; }
+	inline bool FindNextFileA(void*, WIN32_FIND_DATAA*) { return false; }
+	inline bool FindClose(void*) { return true; }
+}
+
+namespace logs
+{
+	template <class... Args>
+	void print(const char* a_level, std::format_string<Args...> a_fmt, Args&&... a_args)
+	{
+		std::printf("[%s] %s\n", a_level, std::format(a_fmt, std::forward<Args>(a_args)...).c_str());
+	}
+
+	template <class... Args>
+	void debug(std::format_string<Args...> a_fmt, Args&&... a_args) { print("debug", a_fmt, std::forward<Args>(a_args)...); }
+	template <class... Args>
+	void info(std::format_string<Args...> a_fmt, Args&&... a_args) { print("info", a_fmt, std::forward<Args>(a_args)...); }
+	template <class... Args>
+	void warn(std::format_string<Args...> a_fmt, Args&&... a_args) { print("warning", a_fmt, std::forward<Args>(a_args)...); }
+	template <class... Args>
+	void error(std::format_string<Args...> a_fmt, Args&&... a_args) { print("error", a_fmt, std::forward<Args>(a_args)...); }
+	template <class... Args>
+	void critical(std::format_string<Args...> a_fmt, Args&&... a_args) { print("critical", a_fmt, std::forward<Args>(a_args)...); }
+
+	// There is no log directory here, so nothing writes files there.
+	inline std::optional<std::filesystem::path> log_directory() { return std::nullopt; }
+}
+
+namespace fs = std::filesystem;
+using namespace std::literals;
@@ -0,0 +1,231 @@
+// ============================================================================
+//                            activation_test.cpp
+// ----------------------------------------------------------------------------
+// Part of the open-source Dynamic Animation Replacer (DARGH).
+//
+// Copyright (c) 2023 Nox Sidereum
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the �Software�), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is furnished
+// to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED �AS IS�, WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+// FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+// DEALINGS IN THE SOFTWARE.
+//
+// (The MIT License)
+// ============================================================================
+
+// ----------------------------------------------------------------------------
+// activation_test: checks that a clip activation is decided once when the
+// game goes through AnimationLoaderHook, which decides the replacement, loads
+// it and then activates the clip generator, so that hkbClipGenerator::Activate
+// runs inside it (see ClipActivation.h).
+//
+// Both hooks are driven as the game drives them, through their decisions in
+// ClipActivation.cpp, over a project whose mappings use Random and IsFemale.
+// For each activation, the random numbers are drawn from the same seed
+// three times: for the loader hook then the Activate hook, and for the
+// Activate hook alone as a reference. Built with DEBUG_COUNT_DECISIONS.
+// Exits with 1 unless, for every activation,
+//     - the loader path evaluates the chains once, i.e. calls exactly as
+//       many condition functions as the reference;
+//     - the Activate hook activates the animation the loader hook loaded;
+//     - and that's the animation the reference chose.
+//
+//     xmake build activation_test && xmake run activation_test
+// ----------------------------------------------------------------------------
+
+#include "ClipActivation.h"
+#include "DARProjectRegistry.h"
+
+#include <random>
+
+namespace
+{
+	int g_nFailed = 0;
+
+	void check(bool a_ok, const char* a_what, uint32_t a_activation)
+	{
+		if (!a_ok) {
+			if (++g_nFailed <= 20) {
+				std::printf("FAILED: %s (activation %u)\n", a_what, a_activation);
+			}
+		}
+	}
+
+	// Condition function calls so far, and what Random draws from.
+	uint64_t g_nCalls = 0;
+	std::mt19937 g_random;
+
+	bool IsFemale(RE::Actor* a_actor, std::variant<uint32_t, float>*, uint32_t)
+	{
+		++g_nCalls;
+		return a_actor->GetActorBase()->IsFemale();
+	}
+
+	bool Random(RE::Actor*, std::variant<uint32_t, float>* a_args, uint32_t)
+	{
+		++g_nCalls;
+		return std::get<float>(a_args[0]) > std::generate_canonical<float, 10>(g_random);
+	}
+
+	// ------------------------------------------------------------------------
+	//  The hooks, as the game calls them. Each returns the index of the
+	//  animation the clip generator was activated with.
+	// ------------------------------------------------------------------------
+	int16_t activateHook(RE::hkbClipGenerator* a_clipGenerator, RE::hkbContext* a_context)
+	{
+		// As hkbClipGeneratorHook::Activate (Hooks.cpp).
+		const int16_t newIndex = DARGH::decideActivation(a_clipGenerator, a_context);
+		return newIndex == -1 ? a_clipGenerator->animationBindingIndex : newIndex;
+	}
+
+	int16_t loaderHook(RE::hkbClipGenerator* a_clipGenerator, RE::hkbContext* a_context, int16_t& a_loaded)
+	{
+		// As AnimationLoaderHook::Hook (Trampolines.cpp): the clip generator
+		// is loaded with the index decided, then activated, which goes
+		// through the Activate hook.
+		const int16_t origIndex = a_clipGenerator->animationBindingIndex;
+		DARProject* darProj;
+		DecidedActivation decided(a_clipGenerator);
+
+		const int16_t newIndex = DARGH::decideReplacement(a_clipGenerator, a_context, darProj, "AnimationLoaderHook");
+		if (newIndex != -1) {
+			a_clipGenerator->animationBindingIndex = newIndex;
+		}
+		a_loaded = a_clipGenerator->animationBindingIndex;
+		const int16_t activated = activateHook(a_clipGenerator, a_context);
+		a_clipGenerator->animationBindingIndex = origIndex;
+		return activated;
+	}
+
+	// ------------------------------------------------------------------------
+	//  The project: index 100 is replaced if Random(0.5); index 101 by one
+	//  of two folders, the first if Random(0.3), else the second if the
+	//  actor is female; index 102 if the actor is female.
+	// ------------------------------------------------------------------------
+	struct Project
+	{
+		DARRemapPlan plan;
+		RE::hkbProjectData projectData;
+	};
+
+	void addChain(ConditionPool& a_pool, ConditionFuncID a_id, float a_arg)
+	{
+		std::array<ConditionPool::Arg, MAX_CONDITION_ARGS> args{};
+		args[0] = a_arg;
+		a_pool.ops.push_back(a_id);
+		a_pool.flags.push_back(static_cast<uint8_t>(ConditionPool::kAnd | (1 << ConditionPool::kArgIsFloatShift)));
+		a_pool.args.push_back(args);
+		a_pool.chainStart.push_back(a_pool.numTerms());
+		a_pool.chainDeps.push_back(a_id == ConditionFuncID::kRandom ? kDepRandom : kDepActorBase);
+	}
+
+	void addLink(DARRemapPlan& a_plan, uint32_t a_fromIndex, int a_priority, uint32_t a_chain, uint16_t a_toIndex)
+	{
+		auto link = std::make_unique<ConditionLinkData>();
+		link->pool = a_plan.conditionPool;
+		link->chain = a_chain;
+		link->to_hkx_index = a_toIndex;
+		a_plan.allLinks[a_fromIndex].emplace(a_priority, link.get());
+		a_plan.linkPool.push_back(std::move(link));
+	}
+
+	void registerProject(Project& a_project)
+	{
+		// As LoadDARData: the folder's pool, a plan, and the registry entry.
+		DARGH::registerDARProject("actors\\character\\defaultmale.hkx");
+		auto& darProj = DARGH::g_DARProjectRegistry.begin()->second;
+
+		auto& pool = darProj.folderData->conditionPool;
+		pool.dispatch[static_cast<std::size_t>(ConditionFuncID::kIsFemale)] = IsFemale;
+		pool.dispatch[static_cast<std::size_t>(ConditionFuncID::kRandom)] = Random;
+		addChain(pool, ConditionFuncID::kRandom, 0.5f);    // chain 0
+		addChain(pool, ConditionFuncID::kRandom, 0.3f);    // chain 1
+		addChain(pool, ConditionFuncID::kIsFemale, 0.0f);  // chain 2
+
+		auto& plan = a_project.plan;
+		plan.conditionPool = &pool;
+		addLink(plan, 100, 5, 0, 0);
+		addLink(plan, 101, 7, 1, 1);
+		addLink(plan, 101, 3, 2, 2);
+		addLink(plan, 102, 1, 2, 3);
+
+		darProj.projData = RE::hkRefPtr<RE::hkbProjectData>(&a_project.projectData);
+		darProj.remapPlan.store(&plan, std::memory_order_release);
+		DARGH::g_isDARDataLoaded.store(true, std::memory_order_release);
+	}
+}
+
+const FuncInfo& getConditionFunc(ConditionFuncID a_id)
+{
+	// Only splitStaticConditions looks the functions up, and this test
+	// doesn't split its chains.
+	static const FuncInfo IS_FEMALE{ "IsFemale", IsFemale, ConditionFuncID::kIsFemale, 0, 0, CostClass::kTrivial, kDepActorBase };
+	static const FuncInfo RANDOM{ "Random", Random, ConditionFuncID::kRandom, 1, 1, CostClass::kLookup, kDepRandom };
+	return a_id == ConditionFuncID::kRandom ? RANDOM : IS_FEMALE;
+}
+
+int main()
+{
+	constexpr uint32_t N_ACTIVATIONS = 20000;
+
+	Project project;
+	registerProject(project);
+
+	std::array<RE::TESNPC, 2> bases;
+	bases[1].female = true;
+
+	std::array<RE::BShkbAnimationGraph, 4> graphs;
+	std::array<RE::Actor, 4> actors;
+	for (uint32_t i = 0; i < actors.size(); ++i) {
+		actors[i].base = &bases[i % 2];
+		graphs[i].holder = &actors[i];
+		graphs[i].characterInstance.projectData = RE::hkRefPtr<RE::hkbProjectData>(&project.projectData);
+	}
+	actors[3].formType = RE::FormType::NPC;                // not a character: never replaced
+
+	std::mt19937 random(3);
+	uint64_t nDecisionCalls = 0;
+	uint32_t nReplaced = 0;
+	for (uint32_t i = 0; i < N_ACTIVATIONS; ++i) {
+		RE::hkbContext context{ &graphs[random() % graphs.size()].characterInstance };
+		const auto origIndex = static_cast<int16_t>(99 + random() % 5);
+		RE::hkbClipGenerator clipGenerator{ origIndex };
+
+		g_random.seed(i);
+		const auto nBefore = g_nCalls;
+		const int16_t expected = activateHook(&clipGenerator, &context);
+		const auto nExpected = g_nCalls - nBefore;
+
+		g_random.seed(i);
+		int16_t loaded = -1;
+		const auto nLoaderBefore = g_nCalls;
+		const int16_t activated = loaderHook(&clipGenerator, &context, loaded);
+		const auto nLoader = g_nCalls - nLoaderBefore;
+
+		check(nLoader == nExpected, "the loader and Activate hooks evaluated the chains more than once", i);
+		check(activated == loaded, "the Activate hook activated a different animation than was loaded", i);
+		check(activated == expected, "the loader hook chose a different animation", i);
+		check(clipGenerator.animationBindingIndex == origIndex, "the loader hook didn't restore the animation index", i);
+
+		nDecisionCalls += nLoader;
+		nReplaced += activated != origIndex;
+	}
+
+	std::printf("%u activations (%u replaced), %llu condition calls through the loader hook\n",
+		N_ACTIVATIONS, nReplaced, static_cast<unsigned long long>(nDecisionCalls));
+	std::printf("activation_test: %s (%d failed)\n", g_nFailed ? "FAILED" : "passed", g_nFailed);
+	return g_nFailed ? 1 : 0;
+}
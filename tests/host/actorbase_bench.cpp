@@ -0,0 +1,235 @@
+// ============================================================================
+//                            actorbase_bench.cpp
+// ----------------------------------------------------------------------------
+// Part of the open-source Dynamic Animation Replacer (DARGH).
+//
+// Copyright (c) 2023 Nox Sidereum
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the �Software�), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is furnished
+// to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED �AS IS�, WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+// FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+// DEALINGS IN THE SOFTWARE.
+//
+// (The MIT License)
+// ============================================================================
+
+// ----------------------------------------------------------------------------
+// actorbase_bench: compares the memory and lookup time of a remap plan's
+// actor base (M1) mappings, on a real DynamicAnimationReplacer tree:
+//     - in one ActorBaseTable keyed by (from_hkx_index, actor base), as
+//       BaseLinkData keeps them (DARLink.h);
+//     - in a BaseLinkData per from_hkx_index, each with its own
+//       std::unordered_map<FormID, uint16_t>, as they were kept before.
+//
+// The tree is loaded as the plugin loads it (see DARTree.h), and its plan's
+// table is copied into the old layout. The memory is the heap each layout
+// holds (the per-index objects and their maps' nodes and buckets, or the
+// table's arrays), without the allocator's overhead, and with the host's
+// standard library. The lookups are every actor's, for every from_hkx_index
+// with M1 mappings; about half the actors have an actor base with M1
+// mappings. Exits with 1 if the two ever differ.
+//
+//     xmake build actorbase_bench
+//     xmake run actorbase_bench <...\animations\DynamicAnimationReplacer | x.darpack>...
+// ----------------------------------------------------------------------------
+
+#include "DARTree.h"
+
+#include <chrono>
+#include <set>
+
+namespace
+{
+	using Clock = std::chrono::steady_clock;
+
+	constexpr uint32_t N_ACTORS = 256;
+
+	// Where the results go, so that the loops aren't optimised away.
+	volatile int64_t g_sink;
+
+	// Heap bytes held by the old layout's maps.
+	std::size_t g_nMapBytes = 0;
+
+	template <class T>
+	struct CountingAllocator
+	{
+		using value_type = T;
+
+		CountingAllocator() = default;
+		template <class U>
+		CountingAllocator(const CountingAllocator<U>&) {}
+
+		T* allocate(std::size_t a_count)
+		{
+			g_nMapBytes += a_count * sizeof(T);
+			return std::allocator<T>().allocate(a_count);
+		}
+
+		void deallocate(T* a_ptr, std::size_t a_count)
+		{
+			g_nMapBytes -= a_count * sizeof(T);
+			std::allocator<T>().deallocate(a_ptr, a_count);
+		}
+
+		template <class U>
+		bool operator==(const CountingAllocator<U>&) const { return true; }
+	};
+
+	// BaseLinkData before ActorBaseTable: one per from_hkx_index.
+	class OldBaseLinkData : public LinkData
+	{
+	public:
+		// key: actor base form ID, val: to_hkx_index
+		std::unordered_map<RE::FormID, uint16_t, std::hash<RE::FormID>, std::equal_to<RE::FormID>,
+			CountingAllocator<std::pair<const RE::FormID, uint16_t>>> allLinks;
+
+		int16_t getNewAnimIndex(RE::Actor* a_actor, uint32_t, const uint64_t*) override
+		{
+			const auto base = a_actor->GetActorBase();
+			if (base) {
+				const auto search = allLinks.find(base->GetFormID());
+				if (search != allLinks.end()) {
+					return search->second;
+				}
+			}
+
+			return -1;
+		}
+
+		uint32_t stateDeps() const override
+		{
+			return kDepActorBase;
+		}
+	};
+
+	struct Lookup
+	{
+		RE::Actor* actor;
+		uint32_t fromIndex;
+		LinkData* oldLink;
+		LinkData* newLink;                             // the plan's BaseLinkData, from its LinkMap
+	};
+
+	template <class F>
+	double nsPerLookup(const std::vector<Lookup>& a_lookups, int a_reps, F&& a_f)
+	{
+		int64_t sink = 0;
+		const auto start = Clock::now();
+		for (int i = 0; i < a_reps; ++i) {
+			for (const auto& lookup : a_lookups) {
+				sink += a_f(lookup);
+			}
+		}
+		g_sink = sink;
+		return std::chrono::duration<double, std::nano>(Clock::now() - start).count() / (static_cast<double>(a_reps) * a_lookups.size());
+	}
+
+	bool bench(const std::filesystem::path& a_path)
+	{
+		DARProject project;
+		if (!DARTree::loadProject(a_path, project)) {
+			return false;
+		}
+
+		const auto& folderData = *project.folderData;
+		const auto& plan = *project.remapPlan.load();
+		const auto& table = plan.baseLinks.allLinks;
+		std::printf("%s: %zu M1 mappings\n", a_path.string().c_str(), table.size());
+		if (table.size() == 0) {
+			return true;
+		}
+
+		// The old layout, from the table: its keys are the plan's M1 indices
+		// and the folder's actor bases.
+		std::set<RE::FormID> actorBases;
+		for (const auto& link : folderData.actorBaseLinks) {
+			actorBases.insert(link.actorBaseID);
+		}
+		std::map<uint32_t, std::unique_ptr<OldBaseLinkData>> oldLinks;
+		g_nMapBytes = 0;
+		for (const auto& [fromIndex, links] : plan.allLinks) {
+			if (!links.contains(0)) {
+				continue;
+			}
+			auto& oldLink = oldLinks[fromIndex];
+			oldLink = std::make_unique<OldBaseLinkData>();
+			for (const auto actorBase : actorBases) {
+				const auto toIndex = table.find(fromIndex, actorBase);
+				if (toIndex != -1) {
+					oldLink->allLinks.emplace(actorBase, toIndex);
+				}
+			}
+		}
+		const std::size_t oldBytes = oldLinks.size() * sizeof(OldBaseLinkData) + g_nMapBytes;
+
+		DARTree::Actors actors;
+		DARTree::makeActors(folderData, N_ACTORS, actors);
+		std::vector<Lookup> lookups;
+		for (auto& actor : actors.actors) {
+			for (const auto& [fromIndex, oldLink] : oldLinks) {
+				lookups.push_back({ &actor, fromIndex, oldLink.get(), plan.allLinks.at(fromIndex).at(0) });
+			}
+		}
+
+		uint64_t nHits = 0;
+		uint64_t nMismatches = 0;
+		for (const auto& lookup : lookups) {
+			const auto oldIndex = lookup.oldLink->getNewAnimIndex(lookup.actor, lookup.fromIndex, nullptr);
+			const auto newIndex = lookup.newLink->getNewAnimIndex(lookup.actor, lookup.fromIndex, nullptr);
+			nHits += newIndex != -1;
+			if (oldIndex != newIndex && nMismatches++ == 0) {
+				std::printf("  MISMATCH: index %u, actor base %08X: per index %d, table %d\n", lookup.fromIndex,
+					lookup.actor->GetActorBase()->GetFormID(), oldIndex, newIndex);
+			}
+		}
+
+		// Both through the virtual call, as chooseAnimIndex makes it; best of a few.
+		constexpr int REPS = 20;
+		constexpr int ROUNDS = 5;
+		double oldNs = std::numeric_limits<double>::max();
+		double newNs = std::numeric_limits<double>::max();
+		for (int i = 0; i < ROUNDS; ++i) {
+			oldNs = std::min(oldNs, nsPerLookup(lookups, REPS, [](const Lookup& a_lookup) {
+				return a_lookup.oldLink->getNewAnimIndex(a_lookup.actor, a_lookup.fromIndex, nullptr);
+			}));
+			newNs = std::min(newNs, nsPerLookup(lookups, REPS, [](const Lookup& a_lookup) {
+				return a_lookup.newLink->getNewAnimIndex(a_lookup.actor, a_lookup.fromIndex, nullptr);
+			}));
+		}
+
+		std::printf("  %zu from_hkx_indexes with M1 mappings, %zu actor bases\n", oldLinks.size(), actorBases.size());
+		std::printf("  memory: per index %zu bytes, table %zu bytes (%+.0f%%)\n",
+			oldBytes, table.sizeInBytes(), 100.0 * (static_cast<double>(table.sizeInBytes()) / oldBytes - 1.0));
+		std::printf("  lookup: per index %.1f ns, table %.1f ns (%+.0f%%; %zu lookups, %.0f%% hits)\n",
+			oldNs, newNs, 100.0 * (newNs / oldNs - 1.0), lookups.size(), 100.0 * nHits / lookups.size());
+		std::printf("  %llu mismatches\n", static_cast<unsigned long long>(nMismatches));
+		return nMismatches == 0;
+	}
+}
+
+int main(int argc, char* argv[])
+{
+	if (argc < 2) {
+		std::printf("usage: actorbase_bench <...\\animations\\DynamicAnimationReplacer | x.darpack>...\n");
+		return 2;
+	}
+
+	bool bOK = true;
+	for (int i = 1; i < argc; ++i) {
+		bOK &= bench(argv[i]);
+	}
+	return bOK ? 0 : 1;
+}
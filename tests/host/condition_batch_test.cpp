@@ -0,0 +1,370 @@
+// ============================================================================
+//                          condition_batch_test.cpp
+// ----------------------------------------------------------------------------
+// Part of the open-source Dynamic Animation Replacer (DARGH).
+//
+// Copyright (c) 2023 Nox Sidereum
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the �Software�), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is furnished
+// to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED �AS IS�, WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+// FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+// DEALINGS IN THE SOFTWARE.
+//
+// (The MIT License)
+// ============================================================================
+
+// ----------------------------------------------------------------------------
+// condition_batch_test: checks that evaluateBatch (ConditionBatch.cpp) gives
+// the same result as ConditionPool::evaluate for each actor, for random chains
+// over groups of 1, 8, 64 and 512 actors (i.e. below the batching threshold,
+// within one group of lanes, and over several).
+//
+// The chains mix the numeric comparisons that are batched (with NaNs, values
+// equal to the threshold, missing globals and factions) with terms that
+// aren't, negation, OR, ESP-not-loaded terms and Random. The condition
+// functions are copies of those in Conditions.cpp. The check is repeated
+// with a numeric function replaced in the pool's dispatch table, which
+// evaluateBatch must then call rather than batch. Exits with 1 if any
+// result differs.
+//
+//     xmake build condition_batch_test && xmake run condition_batch_test
+// ----------------------------------------------------------------------------
+
+#include "ConditionBatch.h"
+
+#include <random>
+
+namespace
+{
+	constexpr uint32_t N_GLOBALS = 4;
+	constexpr uint32_t N_FACTIONS = 3;
+	constexpr RE::FormID FIRST_GLOBAL = 0x100;
+	constexpr RE::FormID FIRST_FACTION = 0x200;
+	constexpr RE::FormID MISSING_FORM = 0x999;
+
+	std::array<RE::TESGlobal, N_GLOBALS> g_globals;
+	std::array<RE::TESFaction, N_FACTIONS> g_factions;
+
+	// Random draws from this, so that it can be reset to draw the same
+	// numbers for evaluate and for evaluateBatch.
+	std::mt19937 g_random;
+
+	// ------------------------------------------------------------------------
+	//  Condition functions, as in Conditions.cpp.
+	// ------------------------------------------------------------------------
+	template <auto GetValue, bool bLess>
+	bool ActorValueCompare(RE::Actor* a_actor, std::variant<uint32_t, float>* a_args, uint32_t a_bmArgIsFloat)
+	{
+		float args[2];
+		if (!readGlobalVars(args, a_args, a_bmArgIsFloat, 2)) {
+			return false;
+		}
+
+		const auto value = GetValue(a_actor, args[0]);
+		return bLess ? value < args[1] : value == args[1];
+	}
+
+	float actorValue(RE::Actor* a_actor, float a_id) { return a_actor->GetActorValue(static_cast<RE::ActorValue>(a_id)); }
+	float baseValue(RE::Actor* a_actor, float a_id) { return a_actor->GetBaseActorValue(static_cast<RE::ActorValue>(a_id)); }
+	float maxValue(RE::Actor* a_actor, float a_id) { return a_actor->GetPermanentActorValue(static_cast<RE::ActorValue>(a_id)); }
+	float percentage(RE::Actor* a_actor, float a_id) { return getActorValPct(a_actor, static_cast<uint32_t>(a_id)); }
+
+	bool IsLevelLessThan(RE::Actor* a_actor, std::variant<uint32_t, float>* a_args, uint32_t a_bmArgIsFloat)
+	{
+		float arg;
+		if (!readGlobalVars(&arg, a_args, a_bmArgIsFloat, 1)) {
+			return false;
+		}
+
+		const auto level = a_actor->GetLevel();
+		return (level < arg);
+	}
+
+	template <bool bLess>
+	bool FactionRankCompare(RE::Actor* a_actor, std::variant<uint32_t, float>* a_args, uint32_t a_bmArgIsFloat)
+	{
+		float arg;
+		if (!readGlobalVars(&arg, a_args, a_bmArgIsFloat, 1)) {
+			return false;
+		}
+
+		const auto faction = RE::TESForm::LookupByID<RE::TESFaction>(std::get<uint32_t>(a_args[1]));
+		if (!faction || !a_actor->IsInFaction(faction)) {
+			return false;
+		}
+
+		const auto rank = static_cast<float>(a_actor->GetFactionRank(faction, a_actor->IsPlayer()));
+		return bLess ? rank < arg : rank == arg;
+	}
+
+	bool IsFemale(RE::Actor* a_actor, std::variant<uint32_t, float>*, uint32_t)
+	{
+		return a_actor->GetActorBase()->IsFemale();
+	}
+
+	bool Random(RE::Actor*, std::variant<uint32_t, float>* a_args, uint32_t a_bmArgIsFloat)
+	{
+		float percentage;
+		if (!readGlobalVars(&percentage, a_args, a_bmArgIsFloat, 1)) {
+			return false;
+		}
+		return percentage > std::generate_canonical<float, 10>(g_random);
+	}
+
+	bool Never(RE::Actor*, std::variant<uint32_t, float>*, uint32_t)
+	{
+		return false;
+	}
+
+	struct TestFunc
+	{
+		ConditionFuncID id;
+		ConditionFunc   func;
+		uint32_t        deps;
+	};
+
+	constexpr TestFunc TEST_FUNCS[]{
+		{ ConditionFuncID::kIsActorValueEqualTo, ActorValueCompare<actorValue, false>, kDepActorValues },
+		{ ConditionFuncID::kIsActorValueLessThan, ActorValueCompare<actorValue, true>, kDepActorValues },
+		{ ConditionFuncID::kIsActorValueBaseEqualTo, ActorValueCompare<baseValue, false>, kDepActorValues },
+		{ ConditionFuncID::kIsActorValueBaseLessThan, ActorValueCompare<baseValue, true>, kDepActorValues },
+		{ ConditionFuncID::kIsActorValueMaxEqualTo, ActorValueCompare<maxValue, false>, kDepActorValues },
+		{ ConditionFuncID::kIsActorValueMaxLessThan, ActorValueCompare<maxValue, true>, kDepActorValues },
+		{ ConditionFuncID::kIsActorValuePercentageEqualTo, ActorValueCompare<percentage, false>, kDepActorValues },
+		{ ConditionFuncID::kIsActorValuePercentageLessThan, ActorValueCompare<percentage, true>, kDepActorValues },
+		{ ConditionFuncID::kIsLevelLessThan, IsLevelLessThan, kDepActorValues },
+		{ ConditionFuncID::kIsFactionRankEqualTo, FactionRankCompare<false>, kDepFactions },
+		{ ConditionFuncID::kIsFactionRankLessThan, FactionRankCompare<true>, kDepFactions },
+		{ ConditionFuncID::kIsFemale, IsFemale, kDepActorBase },
+		{ ConditionFuncID::kRandom, Random, kDepRandom },
+	};
+
+	std::array<FuncInfo, static_cast<std::size_t>(ConditionFuncID::kTotal)> g_funcs{};
+
+	// ------------------------------------------------------------------------
+	//  Actors and chains.
+	// ------------------------------------------------------------------------
+	constexpr uint32_t N_VALUES = 4;    // actor values used, of each kind
+
+	float randomValue(std::mt19937& a_random)
+	{
+		// Small integers, so that values often equal the thresholds, and
+		// the odd NaN.
+		return a_random() % 16 == 0 ? std::numeric_limits<float>::quiet_NaN() : static_cast<float>(a_random() % 8);
+	}
+
+	std::vector<RE::TESNPC> g_bases(2);
+	std::vector<RE::Actor> g_actors(512);
+	std::vector<RE::Actor*> g_actorPtrs;
+
+	void createActors(std::mt19937& a_random)
+	{
+		g_bases[1].female = true;
+		for (auto& actor : g_actors) {
+			actor.base = &g_bases[a_random() % 2];
+			actor.level = static_cast<uint16_t>(a_random() % 8);
+			actor.player = &actor == &g_actors.front();
+			for (uint32_t v = 0; v < N_VALUES; ++v) {
+				actor.values[v] = randomValue(a_random);
+				actor.baseValues[v] = randomValue(a_random);
+				actor.permanentValues[v] = a_random() % 4 == 0 ? 0.0f : randomValue(a_random);
+			}
+			for (const auto& faction : g_factions) {
+				if (a_random() % 2) {
+					actor.factionRanks.emplace_back(&faction, static_cast<int32_t>(a_random() % 5) - 1);
+				}
+			}
+		}
+	}
+
+	ConditionPool::Arg randomGlobal(std::mt19937& a_random)
+	{
+		return a_random() % 8 == 0 ? MISSING_FORM : FIRST_GLOBAL + static_cast<uint32_t>(a_random() % N_GLOBALS);
+	}
+
+	void buildPool(ConditionPool& a_pool, std::mt19937& a_random)
+	{
+		for (const auto& func : TEST_FUNCS) {
+			a_pool.dispatch[static_cast<std::size_t>(func.id)] = func.func;
+		}
+
+		for (uint32_t chain = 0; chain < 400; ++chain) {
+			uint32_t deps = kDepNone;
+			for (uint32_t term = 0, nTerms = 1 + a_random() % 6; term < nTerms; ++term) {
+				// Random only in one chain in ten.
+				const auto nFuncs = std::size(TEST_FUNCS) - (chain % 10 ? 1 : 0);
+				const auto& func = TEST_FUNCS[a_random() % nFuncs];
+				std::array<ConditionPool::Arg, MAX_CONDITION_ARGS> args{};
+				uint32_t bmArgIsFloat = 0;
+				switch (func.id) {
+				case ConditionFuncID::kIsLevelLessThan:
+				case ConditionFuncID::kRandom:
+					if (a_random() % 2) {
+						args[0] = randomGlobal(a_random);
+					} else {
+						args[0] = func.id == ConditionFuncID::kRandom ? 0.5f : static_cast<float>(a_random() % 8);
+						bmArgIsFloat = 1;
+					}
+					break;
+				case ConditionFuncID::kIsFactionRankEqualTo:
+				case ConditionFuncID::kIsFactionRankLessThan:
+					args[0] = static_cast<float>(static_cast<int32_t>(a_random() % 6) - 2);
+					args[1] = a_random() % 8 == 0 ? MISSING_FORM : FIRST_FACTION + static_cast<uint32_t>(a_random() % N_FACTIONS);
+					bmArgIsFloat = 1;
+					break;
+				case ConditionFuncID::kIsFemale:
+					break;
+				default:
+					args[0] = static_cast<float>(a_random() % N_VALUES);
+					bmArgIsFloat = 1;
+					if (a_random() % 2) {
+						args[1] = randomGlobal(a_random);
+					} else {
+						args[1] = static_cast<float>(a_random() % 8) / (a_random() % 2 ? 1.0f : 8.0f);
+						bmArgIsFloat |= 2;
+					}
+					break;
+				}
+
+				uint8_t flags = static_cast<uint8_t>(bmArgIsFloat << ConditionPool::kArgIsFloatShift);
+				if (a_random() % 3) {
+					flags |= ConditionPool::kAnd;
+				}
+				if (a_random() % 4 == 0) {
+					flags |= ConditionPool::kNot;
+				}
+				if (a_random() % 20 == 0) {
+					flags |= ConditionPool::kESPNotLoaded;
+				}
+				a_pool.ops.push_back(func.id);
+				a_pool.flags.push_back(flags);
+				a_pool.args.push_back(args);
+				deps |= func.deps;
+			}
+			a_pool.chainStart.push_back(a_pool.numTerms());
+			a_pool.chainDeps.push_back(deps);
+		}
+	}
+
+	uint32_t checkPool(const ConditionPool& a_pool, std::string_view a_name)
+	{
+		uint32_t nFailed = 0;
+		for (const std::size_t nActors : { 1, 8, 64, 512 }) {
+			const std::span<RE::Actor* const> actors(g_actorPtrs.data(), nActors);
+			std::vector<uint8_t> results(nActors);
+			for (uint32_t chain = 0; chain + 1 < a_pool.chainStart.size(); ++chain) {
+				g_random.seed(chain);
+				evaluateBatch(a_pool, chain, actors, results.data());
+
+				g_random.seed(chain);
+				for (std::size_t i = 0; i < nActors; ++i) {
+					if ((results[i] != 0) != a_pool.evaluate(chain, actors[i])) {
+						if (++nFailed <= 20) {
+							std::printf("FAILED: %.*s: chain %u, actor %zu of %zu\n",
+								static_cast<int>(a_name.size()), a_name.data(), chain, i, nActors);
+						}
+					}
+				}
+			}
+		}
+		return nFailed;
+	}
+}
+
+// ----------------------------------------------------------------------------
+//  The parts of the engine the test stands in for.
+// ----------------------------------------------------------------------------
+template <>
+RE::TESGlobal* RE::TESForm::LookupByID<RE::TESGlobal>(RE::FormID a_formID)
+{
+	return a_formID >= FIRST_GLOBAL && a_formID < FIRST_GLOBAL + N_GLOBALS ? &g_globals[a_formID - FIRST_GLOBAL] : nullptr;
+}
+
+template <>
+RE::TESFaction* RE::TESForm::LookupByID<RE::TESFaction>(RE::FormID a_formID)
+{
+	return a_formID >= FIRST_FACTION && a_formID < FIRST_FACTION + N_FACTIONS ? &g_factions[a_formID - FIRST_FACTION] : nullptr;
+}
+
+const FuncInfo& getConditionFunc(ConditionFuncID a_id)
+{
+	return g_funcs[static_cast<std::size_t>(a_id)];
+}
+
+bool readGlobalVars(float* a_values, std::variant<uint32_t, float>* a_args, uint32_t a_bmArgIsFloat, int32_t a_nArgs)
+{
+	for (int32_t i = 0; i < a_nArgs; ++i) {
+		if (a_bmArgIsFloat & (1 << i)) {
+			a_values[i] = std::get<float>(a_args[i]);
+		} else if (const auto global = RE::TESForm::LookupByID<RE::TESGlobal>(std::get<uint32_t>(a_args[i]))) {
+			a_values[i] = global->value;
+		} else {
+			return false;
+		}
+	}
+	return true;
+}
+
+float getActorValPct(RE::Actor* a_actor, uint32_t a_value)
+{
+	const float fActorValue = a_actor->GetActorValue(static_cast<RE::ActorValue>(a_value));
+	const float fPermActorValue = a_actor->GetPermanentActorValue(static_cast<RE::ActorValue>(a_value));
+	if (fPermActorValue <= 0.0) {
+		return 1.0;
+	}
+
+	if (fActorValue > 0.0) {
+		if (fActorValue >= fPermActorValue) {
+			return 1.0;
+		}
+
+		return fActorValue / fPermActorValue;
+	}
+
+	return 0.0;
+}
+
+int main()
+{
+	for (const auto& func : TEST_FUNCS) {
+		g_funcs[static_cast<std::size_t>(func.id)] = { "", func.func, func.id, 0, 0, CostClass::kTrivial, func.deps };
+	}
+	for (uint32_t i = 0; i < N_GLOBALS; ++i) {
+		g_globals[i].formID = FIRST_GLOBAL + i;
+		g_globals[i].value = static_cast<float>(i + 1);
+	}
+	for (uint32_t i = 0; i < N_FACTIONS; ++i) {
+		g_factions[i].formID = FIRST_FACTION + i;
+	}
+
+	std::mt19937 random(3);
+	createActors(random);
+	for (auto& actor : g_actors) {
+		g_actorPtrs.push_back(&actor);
+	}
+
+	ConditionPool pool;
+	buildPool(pool, random);
+	uint32_t nFailed = checkPool(pool, "built-in functions");
+
+	// A native predicate registered over a numeric function replaces it in
+	// the dispatch table; evaluateBatch must call it rather than batch.
+	pool.dispatch[static_cast<std::size_t>(ConditionFuncID::kIsActorValueLessThan)] = Never;
+	nFailed += checkPool(pool, "replaced function");
+
+	std::printf("condition_batch_test: %s (%u failed)\n", nFailed ? "FAILED" : "passed", nFailed);
+	return nFailed ? 1 : 0;
+}
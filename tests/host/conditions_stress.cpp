@@ -0,0 +1,382 @@
+// ============================================================================
+//                           conditions_stress.cpp
+// ----------------------------------------------------------------------------
+// Part of the open-source Dynamic Animation Replacer (DARGH).
+//
+// Copyright (c) 2023 Nox Sidereum
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the �Software�), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is furnished
+// to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED �AS IS�, WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+// FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+// DEALINGS IN THE SOFTWARE.
+//
+// (The MIT License)
+// ============================================================================
+
+// ----------------------------------------------------------------------------
+// conditions_stress: exercises the condition engine's concurrency model (see
+// Conditions.h) under ThreadSanitizer, with the real StaticChainCache
+// (StaticConditions.cpp) and world snapshot (WorldSnapshot.cpp):
+//     - a loader thread builds a folder's ConditionPool, splits off its
+//       static conditions and builds the world snapshot, then publishes the
+//       DAR data (g_isDARDataLoaded), as loadDARDataAsync does;
+//     - worker threads evaluate every chain for every actor, as the hooks do
+//       on Havok's threads, through the StaticChainCache (filled in on first
+//       use, from several threads at once) and the snapshot;
+//     - the main thread changes the weather, the game time and the globals,
+//       and refreshes the snapshot every frame, as MainUpdateHook does.
+//
+// The condition functions are stand-ins for those in Conditions.cpp, using
+// the same patterns: snapshot reads, a lookup published on first use, and a
+// thread_local random number generator.
+//
+// Besides any race ThreadSanitizer reports, each cached static result is
+// checked against evaluating the static part of the chain directly. Exits
+// with the number of mismatches.
+//
+//     xmake build conditions_stress && xmake run conditions_stress
+// ----------------------------------------------------------------------------
+
+#include "DARProjectRegistry.h"
+#include "WorldSnapshot.h"
+
+#include <random>
+
+// As in Conditions.cpp; defined below.
+bool readGlobalVars(float* a_values, std::variant<uint32_t, float>* a_args, uint32_t a_bmArgIsFloat, int32_t a_nArgs);
+
+namespace DARGH
+{
+	std::atomic<bool> g_isDARDataLoaded{ false };
+	std::map<std::string, std::shared_ptr<DARFolderData>> g_DARFolderRegistry;
+}
+
+namespace
+{
+	// ------------------------------------------------------------------------
+	//  Game state. Only the main thread (and the loader, before publishing)
+	//  touches it; conditions read the snapshot instead.
+	// ------------------------------------------------------------------------
+	constexpr uint32_t N_GLOBALS = 4;
+	constexpr uint32_t N_WEATHERS = 3;
+	constexpr RE::FormID FIRST_GLOBAL = 0x100;
+	constexpr RE::FormID FIRST_WEATHER = 0x200;
+
+	RE::Sky g_sky;
+	RE::Calendar g_calendar;
+	std::array<RE::TESGlobal, N_GLOBALS> g_globals;
+	std::array<RE::TESWeather, N_WEATHERS> g_weathers;
+	RE::TESForm g_warhammerKeyword;
+
+	// ------------------------------------------------------------------------
+	//  Condition functions.
+	// ------------------------------------------------------------------------
+	bool IsFemale(RE::Actor* a_actor, std::variant<uint32_t, float>*, uint32_t)
+	{
+		return a_actor->GetActorBase()->IsFemale();
+	}
+
+	bool IsRace(RE::Actor* a_actor, std::variant<uint32_t, float>* a_args, uint32_t)
+	{
+		return a_actor->GetRace()->GetFormID() == std::get<uint32_t>(a_args[0]);
+	}
+
+	bool IsEquippedRightType(RE::Actor*, std::variant<uint32_t, float>*, uint32_t)
+	{
+		// As the warhammer keyword: looked up on first use, and published.
+		static std::atomic<const RE::TESForm*> keyword{ nullptr };
+		auto form = keyword.load(std::memory_order_acquire);
+		if (!form) {
+			form = &g_warhammerKeyword;
+			keyword.store(form, std::memory_order_release);
+		}
+		return form->GetFormID() == 0;
+	}
+
+	bool CurrentWeather(RE::Actor*, std::variant<uint32_t, float>* a_args, uint32_t)
+	{
+		RE::FormID weather = 0;
+		return DARGH::getSnapshotWeather(weather) && weather == std::get<uint32_t>(a_args[0]);
+	}
+
+	bool CurrentGameTimeLessThan(RE::Actor*, std::variant<uint32_t, float>* a_args, uint32_t a_bmArgIsFloat)
+	{
+		float hour = 0.0f;
+		float threshold = 0.0f;
+		return readGlobalVars(&threshold, a_args, a_bmArgIsFloat, 1) && DARGH::getSnapshotGameHour(hour) &&
+		       hour >= 0.0f && hour < threshold;
+	}
+
+	bool ValueLessThan(RE::Actor*, std::variant<uint32_t, float>* a_args, uint32_t a_bmArgIsFloat)
+	{
+		float values[2];
+		return readGlobalVars(values, a_args, a_bmArgIsFloat, 2) && values[0] < values[1];
+	}
+
+	bool Random(RE::Actor*, std::variant<uint32_t, float>* a_args, uint32_t a_bmArgIsFloat)
+	{
+		float percentage = 0.0f;
+		if (!readGlobalVars(&percentage, a_args, a_bmArgIsFloat, 1)) {
+			return false;
+		}
+		thread_local std::mt19937 generator{ std::random_device{}() };
+		return percentage > std::generate_canonical<float, 10>(generator);
+	}
+
+	bool IsActorValueLessThan(RE::Actor* a_actor, std::variant<uint32_t, float>* a_args, uint32_t a_bmArgIsFloat)
+	{
+		float values[2];
+		return readGlobalVars(values, a_args, a_bmArgIsFloat, 2) &&
+		       a_actor->GetActorValue(static_cast<RE::ActorValue>(values[0])) < values[1];
+	}
+
+	// The function table: immutable once built, before anything evaluates.
+	std::array<FuncInfo, static_cast<std::size_t>(ConditionFuncID::kTotal)> g_funcs{};
+
+	struct TestFunc
+	{
+		ConditionFuncID id;
+		ConditionFunc   func;
+		uint32_t        nArgs;
+		uint32_t        deps;
+	};
+
+	constexpr TestFunc TEST_FUNCS[]{
+		{ ConditionFuncID::kIsFemale, IsFemale, 0, kDepActorBase },
+		{ ConditionFuncID::kIsRace, IsRace, 1, kDepRace },
+		{ ConditionFuncID::kIsEquippedRightType, IsEquippedRightType, 1, kDepEquipment },
+		{ ConditionFuncID::kCurrentWeather, CurrentWeather, 1, kDepWorld },
+		{ ConditionFuncID::kCurrentGameTimeLessThan, CurrentGameTimeLessThan, 1, kDepWorld | kDepGlobals },
+		{ ConditionFuncID::kValueLessThan, ValueLessThan, 2, kDepGlobals },
+		{ ConditionFuncID::kRandom, Random, 1, kDepRandom | kDepGlobals },
+		{ ConditionFuncID::kIsActorValueLessThan, IsActorValueLessThan, 2, kDepActorValues | kDepGlobals },
+	};
+
+	// ------------------------------------------------------------------------
+	//  Actors: more kinds than a StaticChainCache holds, so that some are
+	//  never cached. Immutable once created.
+	// ------------------------------------------------------------------------
+	constexpr uint32_t N_RACES = 8;
+	constexpr uint32_t N_BASES = 1200;
+	constexpr uint32_t N_ACTORS = 2000;
+
+	std::array<RE::TESRace, N_RACES> g_races;
+	std::vector<RE::TESNPC> g_bases(N_BASES);
+	std::vector<RE::Actor> g_actors(N_ACTORS);
+
+	void createActors()
+	{
+		std::mt19937 random(7);
+		for (uint32_t i = 0; i < N_RACES; ++i) {
+			g_races[i].formID = 0x300 + i;
+		}
+		for (uint32_t i = 0; i < N_BASES; ++i) {
+			g_bases[i].formID = 0x1000 + i;
+			g_bases[i].female = random() % 2;
+		}
+		for (auto& actor : g_actors) {
+			actor.base = &g_bases[random() % N_BASES];
+			actor.race = &g_races[random() % N_RACES];
+			for (auto& value : actor.values) {
+				value = static_cast<float>(random() % 100);
+			}
+		}
+	}
+
+	void buildFolder()
+	{
+		// As LoadDARData, on the loader thread.
+		auto folderData = std::make_shared<DARFolderData>();
+		auto& pool = folderData->conditionPool;
+		for (const auto& func : TEST_FUNCS) {
+			pool.dispatch[static_cast<std::size_t>(func.id)] = func.func;
+		}
+
+		std::mt19937 random(1);
+		for (uint32_t chain = 0; chain < 200; ++chain) {
+			uint32_t deps = kDepNone;
+			for (uint32_t term = 0, nTerms = 1 + random() % 6; term < nTerms; ++term) {
+				const auto& func = TEST_FUNCS[random() % std::size(TEST_FUNCS)];
+				std::array<ConditionPool::Arg, MAX_CONDITION_ARGS> args{};
+				uint32_t bmArgIsFloat = 0;
+				switch (func.id) {
+				case ConditionFuncID::kIsRace:
+					args[0] = static_cast<uint32_t>(0x300 + random() % N_RACES);
+					break;
+				case ConditionFuncID::kCurrentWeather:
+					args[0] = FIRST_WEATHER + static_cast<uint32_t>(random() % N_WEATHERS);
+					break;
+				case ConditionFuncID::kCurrentGameTimeLessThan:
+					if (random() % 2) {
+						args[0] = FIRST_GLOBAL + static_cast<uint32_t>(random() % N_GLOBALS);
+					} else {
+						args[0] = static_cast<float>(random() % 24);
+						bmArgIsFloat = 1;
+					}
+					break;
+				case ConditionFuncID::kValueLessThan:
+					args[0] = FIRST_GLOBAL + static_cast<uint32_t>(random() % N_GLOBALS);
+					args[1] = static_cast<float>(random() % 20);
+					bmArgIsFloat = 2;
+					break;
+				case ConditionFuncID::kRandom:
+					args[0] = 0.5f;
+					bmArgIsFloat = 1;
+					break;
+				case ConditionFuncID::kIsActorValueLessThan:
+					args[0] = static_cast<float>(random() % 8);
+					args[1] = FIRST_GLOBAL + static_cast<uint32_t>(random() % N_GLOBALS);
+					bmArgIsFloat = 1;
+					break;
+				default:
+					break;
+				}
+
+				uint8_t flags = static_cast<uint8_t>(bmArgIsFloat << ConditionPool::kArgIsFloatShift);
+				if (random() % 3) {
+					flags |= ConditionPool::kAnd;
+				}
+				if (random() % 4 == 0) {
+					flags |= ConditionPool::kNot;
+				}
+				pool.ops.push_back(func.id);
+				pool.flags.push_back(flags);
+				pool.args.push_back(args);
+				deps |= func.deps;
+			}
+			pool.chainStart.push_back(pool.numTerms());
+			pool.chainDeps.push_back(deps);
+		}
+
+		splitStaticConditions(pool);
+		folderData->projFolder = "actors\\character";
+		DARGH::g_DARFolderRegistry[folderData->projFolder] = folderData;
+		DARGH::buildWorldSnapshot();
+		DARGH::g_isDARDataLoaded.store(true, std::memory_order_release);
+	}
+}
+
+// ----------------------------------------------------------------------------
+//  The parts of the engine the test stands in for.
+// ----------------------------------------------------------------------------
+RE::Sky* RE::Sky::GetSingleton() { return &g_sky; }
+RE::Calendar* RE::Calendar::GetSingleton() { return &g_calendar; }
+
+template <>
+RE::TESGlobal* RE::TESForm::LookupByID<RE::TESGlobal>(RE::FormID a_formID)
+{
+	return a_formID >= FIRST_GLOBAL && a_formID < FIRST_GLOBAL + N_GLOBALS ? &g_globals[a_formID - FIRST_GLOBAL] : nullptr;
+}
+
+const FuncInfo& getConditionFunc(ConditionFuncID a_id)
+{
+	return g_funcs[static_cast<std::size_t>(a_id)];
+}
+
+bool readGlobalVars(float* a_values, std::variant<uint32_t, float>* a_args, uint32_t a_bmArgIsFloat, int32_t a_nArgs)
+{
+	// As in Conditions.cpp, but without falling back on the live value
+	// (which is the game's, not the engine's, to keep consistent).
+	for (int32_t i = 0; i < a_nArgs; ++i) {
+		if (a_bmArgIsFloat & (1 << i)) {
+			a_values[i] = std::get<float>(a_args[i]);
+		} else if (!DARGH::getSnapshotGlobal(std::get<uint32_t>(a_args[i]), a_values[i])) {
+			return false;
+		}
+	}
+	return true;
+}
+
+int main()
+{
+	constexpr uint32_t N_WORKERS = 8;
+	constexpr uint32_t N_FRAMES = 2000;
+
+	for (const auto& func : TEST_FUNCS) {
+		g_funcs[static_cast<std::size_t>(func.id)] = { "", func.func, func.id, func.nArgs, 0, CostClass::kTrivial, func.deps };
+	}
+	for (uint32_t i = 0; i < N_GLOBALS; ++i) {
+		g_globals[i].formID = FIRST_GLOBAL + i;
+		g_globals[i].value = static_cast<float>(i * 6);
+	}
+	for (uint32_t i = 0; i < N_WEATHERS; ++i) {
+		g_weathers[i].formID = FIRST_WEATHER + i;
+	}
+	g_sky.currentWeather = &g_weathers[0];
+	createActors();
+
+	std::thread loader(buildFolder);
+
+	std::atomic<bool> bStop{ false };
+	std::atomic<uint64_t> nEvaluations{ 0 };
+	std::atomic<uint64_t> nMismatches{ 0 };
+	std::vector<std::thread> workers;
+	for (uint32_t w = 0; w < N_WORKERS; ++w) {
+		workers.emplace_back([&, w] {
+			while (!DARGH::g_isDARDataLoaded.load(std::memory_order_acquire)) {
+				std::this_thread::yield();
+			}
+			auto& pool = DARGH::g_DARFolderRegistry.begin()->second->conditionPool;
+			const uint32_t nChains = static_cast<uint32_t>(pool.staticChain.size());
+
+			ConditionLinkData link;
+			link.pool = &pool;
+			link.to_hkx_index = 0;
+
+			uint64_t n = 0;
+			uint64_t nBad = 0;
+			for (uint32_t i = w; !bStop.load(std::memory_order_relaxed); i += N_WORKERS) {
+				const auto actor = &g_actors[i % N_ACTORS];
+				const uint64_t* statics = pool.statics ? pool.statics->find(actor) : nullptr;
+				for (link.chain = 0; link.chain < nChains; ++link.chain) {
+					if (statics) {
+						const uint32_t staticChain = pool.staticChain[link.chain];
+						const bool bExpected = staticChain == ConditionPool::NO_CHAIN || pool.evaluate(staticChain, actor);
+						nBad += StaticChainCache::isTrue(statics, link.chain) != bExpected;
+					}
+					link.getNewAnimIndex(actor, 0, statics);
+					++n;
+				}
+			}
+			nEvaluations += n;
+			nMismatches += nBad;
+		});
+	}
+
+	for (uint32_t frame = 0; frame < N_FRAMES; ++frame) {
+		g_calendar.gameTime += 0.001f;
+		if (frame % 50 == 0) {
+			g_sky.currentWeather = &g_weathers[frame / 50 % N_WEATHERS];
+		}
+		if (frame % 70 == 0) {
+			g_globals[frame % N_GLOBALS].value += 1.0f;
+		}
+		DARGH::refreshWorldSnapshot();
+		std::this_thread::sleep_for(std::chrono::microseconds(200));
+	}
+
+	bStop = true;
+	for (auto& worker : workers) {
+		worker.join();
+	}
+	loader.join();
+
+	const auto& pool = DARGH::g_DARFolderRegistry.begin()->second->conditionPool;
+	std::printf("%llu chain evaluations on %u threads over %u frames, %u kinds of actor cached, %llu mismatches\n",
+		static_cast<unsigned long long>(nEvaluations.load()), N_WORKERS, N_FRAMES,
+		pool.statics ? pool.statics->size() : 0, static_cast<unsigned long long>(nMismatches.load()));
+	return static_cast<int>(std::min<uint64_t>(nMismatches.load(), 255));
+}
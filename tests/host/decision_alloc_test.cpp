@@ -0,0 +1,335 @@
+// ============================================================================
+//                          decision_alloc_test.cpp
+// ----------------------------------------------------------------------------
+// Part of the open-source Dynamic Animation Replacer (DARGH).
+//
+// Copyright (c) 2023 Nox Sidereum
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the �Software�), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is furnished
+// to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED �AS IS�, WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+// FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+// DEALINGS IN THE SOFTWARE.
+//
+// (The MIT License)
+// ============================================================================
+
+// ----------------------------------------------------------------------------
+// decision_alloc_test: checks that choosing a replacement doesn't allocate.
+// The hooks call getNewAnimIndex (DARProjectRegistry.cpp) on Havok's threads,
+// for every clip activation, so it mustn't touch the heap.
+//
+// A remap plan is built as buildRemapPlan builds one: M1 mappings, and M2
+// mappings whose chains share predicates, split into static and dynamic
+// parts, some from_hkx_indexes compiled into decision diagrams and the
+// others walked in sequence, with usage counters. A sequence of activations
+// (actor, from_hkx_index) is recorded up front, then replayed through
+// getNewAnimIndex with operator new replaced. Exits with 1 if any activation
+// allocates, and reports the first that did.
+//
+//     xmake build decision_alloc_test && xmake run decision_alloc_test
+// ----------------------------------------------------------------------------
+
+#include "DARProjectRegistry.h"
+
+#include <cstdlib>
+#include <random>
+
+namespace
+{
+	// Allocations made so far, by any thread.
+	std::atomic<uint64_t> g_nAllocations{ 0 };
+}
+
+void* operator new(std::size_t a_size)
+{
+	++g_nAllocations;
+	if (const auto ptr = std::malloc(a_size ? a_size : 1)) {
+		return ptr;
+	}
+	throw std::bad_alloc();
+}
+
+void* operator new(std::size_t a_size, std::align_val_t a_align)
+{
+	++g_nAllocations;
+	const auto align = static_cast<std::size_t>(a_align);
+	if (const auto ptr = std::aligned_alloc(align, (std::max<std::size_t>(a_size, 1) + align - 1) & ~(align - 1))) {
+		return ptr;
+	}
+	throw std::bad_alloc();
+}
+
+void operator delete(void* a_ptr) noexcept { std::free(a_ptr); }
+void operator delete(void* a_ptr, std::size_t) noexcept { std::free(a_ptr); }
+void operator delete(void* a_ptr, std::align_val_t) noexcept { std::free(a_ptr); }
+void operator delete(void* a_ptr, std::size_t, std::align_val_t) noexcept { std::free(a_ptr); }
+
+namespace
+{
+	constexpr uint32_t N_RACES = 6;
+	constexpr uint32_t N_BASES = 200;
+	constexpr uint32_t N_ACTORS = 400;
+	constexpr uint32_t N_FOLDERS = 24;              // M2 priority folders, one chain each
+	constexpr uint32_t N_FROM = 96;                 // from_hkx_indexes with mappings
+	constexpr uint32_t N_ACTIVATIONS = 200000;
+
+	std::array<RE::TESRace, N_RACES> g_races;
+	std::vector<RE::TESNPC> g_bases(N_BASES);
+	std::vector<RE::Actor> g_actors(N_ACTORS);
+
+	// ------------------------------------------------------------------------
+	//  Condition functions: stand-ins for those in Conditions.cpp.
+	// ------------------------------------------------------------------------
+	bool IsFemale(RE::Actor* a_actor, std::variant<uint32_t, float>*, uint32_t)
+	{
+		return a_actor->GetActorBase()->IsFemale();
+	}
+
+	bool IsRace(RE::Actor* a_actor, std::variant<uint32_t, float>* a_args, uint32_t)
+	{
+		return a_actor->GetRace()->GetFormID() == std::get<uint32_t>(a_args[0]);
+	}
+
+	bool IsActorValueLessThan(RE::Actor* a_actor, std::variant<uint32_t, float>* a_args, uint32_t)
+	{
+		return a_actor->GetActorValue(static_cast<RE::ActorValue>(std::get<float>(a_args[0]))) < std::get<float>(a_args[1]);
+	}
+
+	bool Random(RE::Actor*, std::variant<uint32_t, float>* a_args, uint32_t)
+	{
+		thread_local std::mt19937 generator{ 5 };
+		return std::get<float>(a_args[0]) > std::generate_canonical<float, 10>(generator);
+	}
+
+	std::array<FuncInfo, static_cast<std::size_t>(ConditionFuncID::kTotal)> g_funcs{};
+
+	constexpr FuncInfo TEST_FUNCS[]{
+		{ "IsFemale", IsFemale, ConditionFuncID::kIsFemale, 0, 0, CostClass::kTrivial, kDepActorBase },
+		{ "IsRace", IsRace, ConditionFuncID::kIsRace, 1, 0, CostClass::kTrivial, kDepRace },
+		{ "IsActorValueLessThan", IsActorValueLessThan, ConditionFuncID::kIsActorValueLessThan, 2, 3, CostClass::kLookup, kDepActorValues },
+		{ "Random", Random, ConditionFuncID::kRandom, 1, 1, CostClass::kLookup, kDepRandom }
+	};
+
+	void createActors(std::mt19937& a_random)
+	{
+		for (uint32_t i = 0; i < N_RACES; ++i) {
+			g_races[i].formID = 0x300 + i;
+		}
+		for (uint32_t i = 0; i < N_BASES; ++i) {
+			g_bases[i].formID = 0x1000 + i;
+			g_bases[i].female = a_random() % 2;
+		}
+		for (auto& actor : g_actors) {
+			actor.base = &g_bases[a_random() % N_BASES];
+			actor.race = &g_races[a_random() % N_RACES];
+			for (auto& value : actor.values) {
+				value = static_cast<float>(a_random() % 100);
+			}
+		}
+	}
+
+	void appendTerm(ConditionPool& a_pool, std::mt19937& a_random, bool a_bRandom)
+	{
+		// A term drawn from a few predicates, so that chains share them.
+		std::array<ConditionPool::Arg, MAX_CONDITION_ARGS> args{};
+		ConditionFuncID id;
+		uint32_t bmArgIsFloat = 0;
+		switch (a_bRandom ? 3 : a_random() % 3) {
+		case 0:
+			id = ConditionFuncID::kIsFemale;
+			break;
+		case 1:
+			id = ConditionFuncID::kIsRace;
+			args[0] = static_cast<uint32_t>(0x300 + a_random() % N_RACES);
+			break;
+		case 2:
+			id = ConditionFuncID::kIsActorValueLessThan;
+			args[0] = static_cast<float>(a_random() % 4);
+			args[1] = static_cast<float>(25 * (1 + a_random() % 3));
+			bmArgIsFloat = 3;
+			break;
+		default:
+			id = ConditionFuncID::kRandom;
+			args[0] = 0.5f;
+			bmArgIsFloat = 1;
+			break;
+		}
+
+		uint8_t flags = static_cast<uint8_t>(bmArgIsFloat << ConditionPool::kArgIsFloatShift);
+		if (a_random() % 3) {
+			flags |= ConditionPool::kAnd;
+		}
+		if (a_random() % 4 == 0) {
+			flags |= ConditionPool::kNot;
+		}
+		a_pool.ops.push_back(id);
+		a_pool.flags.push_back(flags);
+		a_pool.args.push_back(args);
+	}
+
+	struct Fixture
+	{
+		DARFolderData folderData;
+		DARRemapPlan plan;
+		DARProject project;
+		std::unique_ptr<DARGH::UsageCounter[]> counters;
+	};
+
+	void buildPlan(Fixture& a_fixture, std::mt19937& a_random)
+	{
+		// As buildConditionPool, compileDecisionDAGs and buildRemapPlan.
+		auto& pool = a_fixture.folderData.conditionPool;
+		for (const auto& func : TEST_FUNCS) {
+			pool.dispatch[static_cast<std::size_t>(func.id)] = func.funcPtr;
+		}
+		for (uint32_t chain = 0; chain < N_FOLDERS; ++chain) {
+			const bool bRandom = chain % 7 == 3;
+			for (uint32_t term = 0, nTerms = 1 + a_random() % 4; term < nTerms; ++term) {
+				appendTerm(pool, a_random, bRandom && term == 0);
+			}
+			pool.chainStart.push_back(pool.numTerms());
+			pool.chainDeps.push_back(kDepActorBase | kDepRace | kDepActorValues | (bRandom ? kDepRandom : 0u));
+		}
+		splitStaticConditions(pool);
+
+		auto& plan = a_fixture.plan;
+		plan.conditionPool = &pool;
+		uint16_t nextSlot = 0;
+		std::vector<uint32_t> chains;
+		for (uint32_t from = 0; from < N_FROM; ++from) {
+			const uint32_t fromIndex = 1000 + from;
+			auto& links = plan.allLinks[fromIndex];
+			if (from % 3 == 0) {
+				// M1 mappings, for a few actor bases.
+				links.try_emplace(0, &plan.baseLinks);
+				for (uint32_t i = 0; i < 4; ++i) {
+					plan.baseLinks.allLinks.insert(fromIndex, g_bases[a_random() % N_BASES].formID, nextSlot++);
+				}
+			}
+			for (uint32_t i = 0, nLinks = 1 + a_random() % 4; i < nLinks; ++i) {
+				const uint32_t chain = a_random() % N_FOLDERS;
+				auto link = std::make_unique<ConditionLinkData>();
+				link->pool = &pool;
+				link->chain = chain;
+				link->to_hkx_index = nextSlot++;
+				if (links.try_emplace(static_cast<int>(chain) + 1, link.get()).second) {
+					plan.linkPool.push_back(std::move(link));
+				}
+			}
+
+			// As attachDecisions: half of them with a decision diagram.
+			if (links.size() < 2 || from % 2) {
+				continue;
+			}
+			chains.clear();
+			for (const auto& [priority, link] : links) {
+				chains.push_back(link == &plan.baseLinks ? DecisionDAG::kActorBase : static_cast<const ConditionLinkData*>(link)->chain);
+			}
+			auto& dag = a_fixture.folderData.decisionDAGs[chains];
+			if (!dag) {
+				dag = DecisionDAG::compile(pool, chains);
+			}
+			if (dag) {
+				auto& decision = plan.decisions[fromIndex];
+				decision.dag = dag.get();
+				for (const auto& [priority, link] : links) {
+					decision.candidates.push_back({ link, link == &plan.baseLinks ?
+						int16_t(-1) :
+						static_cast<int16_t>(static_cast<const ConditionLinkData*>(link)->to_hkx_index) });
+				}
+			}
+		}
+
+		// Usage counters for every slot and FROM index (see Usage.h).
+		a_fixture.counters = std::make_unique<DARGH::UsageCounter[]>(nextSlot + N_FROM);
+		plan.usage = std::make_unique<DARGH::PlanUsage>();
+		plan.usage->slotWins.resize(nextSlot);
+		plan.usage->choices.resize(1000 + N_FROM);
+		for (uint32_t i = 0; i < nextSlot; ++i) {
+			plan.usage->slotWins[i] = &a_fixture.counters[i];
+		}
+		for (uint32_t from = 0; from < N_FROM; ++from) {
+			plan.usage->choices[1000 + from] = &a_fixture.counters[nextSlot + from];
+		}
+
+		a_fixture.project.remapPlan.store(&plan, std::memory_order_release);
+	}
+
+	struct Activation
+	{
+		RE::Actor* actor;
+		int16_t    fromIndex;
+	};
+}
+
+const FuncInfo& getConditionFunc(ConditionFuncID a_id)
+{
+	return g_funcs[static_cast<std::size_t>(a_id)];
+}
+
+int main()
+{
+	for (const auto& func : TEST_FUNCS) {
+		g_funcs[static_cast<std::size_t>(func.id)] = func;
+	}
+
+	std::mt19937 random(11);
+	createActors(random);
+	Fixture fixture;
+	buildPlan(fixture, random);
+
+	// Record the activations: mostly animations with mappings, a few
+	// without, by actors that come and go in runs, as in a scene.
+	std::vector<Activation> activations;
+	activations.reserve(N_ACTIVATIONS);
+	for (uint32_t i = 0; i < N_ACTIVATIONS; ++i) {
+		const auto actor = &g_actors[(i / 16 + random() % 8) % N_ACTORS];
+		const auto fromIndex = static_cast<int16_t>(random() % 10 ? 1000 + random() % N_FROM : random() % 1000);
+		activations.push_back({ actor, fromIndex });
+	}
+
+	// Building all that allocated, so operator new is the one above.
+	if (g_nAllocations.load() == 0) {
+		std::printf("decision_alloc_test: FAILED (operator new isn't replaced)\n");
+		return 1;
+	}
+
+	uint64_t nAllocating = 0;
+	uint64_t nReplaced = 0;
+	const Activation* firstAllocating = nullptr;
+	uint64_t nFirstAllocations = 0;
+	for (const auto& activation : activations) {
+		const auto before = g_nAllocations.load(std::memory_order_relaxed);
+		nReplaced += DARGH::getNewAnimIndex(&fixture.project, activation.fromIndex, activation.actor) != -1;
+		const auto nAllocations = g_nAllocations.load(std::memory_order_relaxed) - before;
+		if (nAllocations && nAllocating++ == 0) {
+			firstAllocating = &activation;
+			nFirstAllocations = nAllocations;
+		}
+	}
+
+	if (firstAllocating) {
+		std::printf("FAILED: activation %zu (from_hkx_index %d, actor %u) made %llu allocations\n",
+			static_cast<std::size_t>(firstAllocating - activations.data()), firstAllocating->fromIndex,
+			static_cast<unsigned>(firstAllocating->actor - g_actors.data()), static_cast<unsigned long long>(nFirstAllocations));
+	}
+	std::printf("%u activations (%llu replaced; %zu of %u indices with a decision diagram, %u kinds of actor cached)\n",
+		N_ACTIVATIONS, static_cast<unsigned long long>(nReplaced), fixture.plan.decisions.size(), N_FROM,
+		fixture.folderData.conditionPool.statics ? fixture.folderData.conditionPool.statics->size() : 0);
+	std::printf("decision_alloc_test: %s (%llu failed)\n", nAllocating ? "FAILED" : "passed",
+		static_cast<unsigned long long>(nAllocating));
+	return nAllocating ? 1 : 0;
+}
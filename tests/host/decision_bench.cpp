@@ -0,0 +1,139 @@
+// ============================================================================
+//                             decision_bench.cpp
+// ----------------------------------------------------------------------------
+// Part of the open-source Dynamic Animation Replacer (DARGH).
+//
+// Copyright (c) 2023 Nox Sidereum
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the �Software�), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is furnished
+// to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED �AS IS�, WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+// FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+// DEALINGS IN THE SOFTWARE.
+//
+// (The MIT License)
+// ============================================================================
+
+// ----------------------------------------------------------------------------
+// decision_bench: compares the two ways getNewAnimIndex (DARProjectRegistry.cpp)
+// decides a contested animation, i.e. one with more than one candidate
+// mapping, on a real DynamicAnimationReplacer tree:
+//     - in sequence, evaluating each candidate's chain by priority;
+//     - by the decision diagram compiled for its candidates (DecisionDAG.h).
+//
+// The tree is loaded twice (see DARTree.h), with DecisionDiagrams off and on
+// and StaticConditionCache off. Every actor then activates every contested
+// animation, in a few world states, through both projects. Reports the
+// condition function calls (predicate evaluations) and the time per decision
+// of each, over the animations that have a diagram, and exits with 1 if the
+// two ever choose differently.
+//
+//     xmake build decision_bench
+//     xmake run decision_bench <...\animations\DynamicAnimationReplacer | x.darpack>...
+// ----------------------------------------------------------------------------
+
+#include "DARTree.h"
+#include "Plugin.h"
+
+namespace
+{
+	constexpr uint32_t N_ACTORS = 64;
+	constexpr uint32_t N_WORLD_STATES = 16;
+
+	bool bench(const std::filesystem::path& a_path)
+	{
+		Plugin::CACHE_STATIC_CONDITIONS = false;
+
+		DARProject sequential;
+		Plugin::COMPILE_DECISION_DIAGRAMS = false;
+		if (!DARTree::loadProject(a_path, sequential)) {
+			return false;
+		}
+		DARProject diagram;
+		Plugin::COMPILE_DECISION_DIAGRAMS = true;
+		if (!DARTree::loadProject(a_path, diagram)) {
+			return false;
+		}
+
+		// Both plans have the same indices, as they are built from the same
+		// names; only the diagram's has decisions.
+		const auto& plan = *diagram.remapPlan.load();
+		const auto contested = DARTree::contestedIndices(plan);
+		std::vector<int16_t> decided;
+		for (const auto index : contested) {
+			if (plan.decisions.contains(index)) {
+				decided.push_back(index);
+			}
+		}
+
+		std::printf("%s: %zu animations replaced, %zu contested, %zu with a decision diagram\n",
+			a_path.string().c_str(), plan.allLinks.size(), contested.size(), decided.size());
+		if (decided.empty()) {
+			return true;
+		}
+
+		DARTree::Actors actors;
+		DARTree::makeActors(*diagram.folderData, N_ACTORS, actors);
+		const auto activations = DARTree::makeActivations(actors, decided, N_WORLD_STATES);
+
+		std::vector<int16_t> sequentialChoices;
+		std::vector<int16_t> diagramChoices;
+		const auto sequentialPath = DARTree::replay(sequential, activations, &sequentialChoices);
+		const auto diagramPath = DARTree::replay(diagram, activations, &diagramChoices);
+
+		uint64_t nMismatches = 0;
+		for (std::size_t i = 0; i < activations.size(); ++i) {
+			if (sequentialChoices[i] != diagramChoices[i] && nMismatches++ == 0) {
+				std::printf("  MISMATCH: index %d, actor %08X, world state %u: in sequence %d, diagram %d\n",
+					activations[i].fromIndex, activations[i].actor->GetFormID(), activations[i].worldState,
+					sequentialChoices[i], diagramChoices[i]);
+			}
+		}
+
+		// Time them again without recording the choices, best of a few.
+		constexpr int REPS = 5;
+		double sequentialNs = sequentialPath.ns;
+		double diagramNs = diagramPath.ns;
+		for (int i = 0; i < REPS; ++i) {
+			sequentialNs = std::min(sequentialNs, DARTree::replay(sequential, activations, nullptr).ns);
+			diagramNs = std::min(diagramNs, DARTree::replay(diagram, activations, nullptr).ns);
+		}
+
+		const double nDecisions = static_cast<double>(activations.size());
+		std::printf("  %zu decisions (%u actors x %u world states x %zu animations)\n",
+			activations.size(), N_ACTORS, N_WORLD_STATES, decided.size());
+		std::printf("  predicate evaluations per decision: in sequence %.2f, diagram %.2f (%.0f%% fewer)\n",
+			sequentialPath.nCalls / nDecisions, diagramPath.nCalls / nDecisions,
+			100.0 * (1.0 - static_cast<double>(diagramPath.nCalls) / std::max<uint64_t>(sequentialPath.nCalls, 1)));
+		std::printf("  time per decision: in sequence %.1f ns, diagram %.1f ns\n",
+			sequentialNs / nDecisions, diagramNs / nDecisions);
+		std::printf("  %llu mismatches\n", static_cast<unsigned long long>(nMismatches));
+		return nMismatches == 0;
+	}
+}
+
+int main(int argc, char* argv[])
+{
+	if (argc < 2) {
+		std::printf("usage: decision_bench <...\\animations\\DynamicAnimationReplacer | x.darpack>...\n");
+		return 2;
+	}
+
+	bool bOK = true;
+	for (int i = 1; i < argc; ++i) {
+		bOK &= bench(argv[i]);
+	}
+	return bOK ? 0 : 1;
+}
@@ -0,0 +1,183 @@
+// ============================================================================
+//                           lower_ascii_bench.cpp
+// ----------------------------------------------------------------------------
+// Part of the open-source Dynamic Animation Replacer (DARGH).
+//
+// Copyright (c) 2023 Nox Sidereum
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the �Software�), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is furnished
+// to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED �AS IS�, WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+// FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+// DEALINGS IN THE SOFTWARE.
+//
+// (The MIT License)
+// ============================================================================
+
+// ----------------------------------------------------------------------------
+// lower_ascii_bench: times the lowercasing and hashing of paths (Utilities.cpp)
+// against the std::transform(std::tolower) loop they replaced:
+//     - toLowerASCII, copying each path into a buffer;
+//     - hashLowerASCII, against lowercasing with std::transform then hashing.
+//
+// The paths are read from a file, one per line (e.g. a listing of a real
+// DynamicAnimationReplacer tree: dir /s /b > paths.txt), or else made up in
+// the shapes the plugin lowercases: animation names from the behavior files,
+// file names relative to a replacement folder, and full paths of files in
+// priority folders.
+//
+//     xmake build lower_ascii_bench && xmake run lower_ascii_bench [<paths.txt>]
+// ----------------------------------------------------------------------------
+
+#include "Utilities.h"
+
+#include <chrono>
+#include <clocale>
+#include <fstream>
+
+namespace
+{
+	using Clock = std::chrono::steady_clock;
+
+	// Where the results go, so that the loops aren't optimised away.
+	volatile uint64_t g_sink;
+
+	double elapsedNs(Clock::time_point a_start)
+	{
+		return std::chrono::duration<double, std::nano>(Clock::now() - a_start).count();
+	}
+
+	std::vector<std::string> makePaths()
+	{
+		// Shapes of the paths the plugin lowercases, with their usual lengths.
+		const char* const ANIMATIONS[]{ "1HM_Idle", "MT_WalkForward", "1hm_attackleft", "SneakMTRunForwardLeft",
+			"BOW_AimIdle", "magic_CastDualReleaseConcentration", "H2H_AttackPowerForwardRightHand", "MT_Jump_Fall" };
+
+		std::vector<std::string> paths;
+		for (uint32_t i = 0; i < 600; ++i) {
+			const std::string name = ANIMATIONS[i % std::size(ANIMATIONS)] + std::to_string(i / std::size(ANIMATIONS)) + ".HKX";
+			switch (i % 3) {
+			case 0:
+				// As in the behavior files' animation names (~30 chars).
+				paths.push_back("Animations\\" + name);
+				break;
+			case 1:
+				// Relative to a replacement folder, with a subfolder (~40 chars).
+				paths.push_back("_1stPerson\\Animations\\" + name);
+				break;
+			default:
+				// A file in a priority folder (~110 chars).
+				paths.push_back("Meshes\\Actors\\Character\\Animations\\DynamicAnimationReplacer\\_CustomConditions\\" +
+								std::to_string(100000 + i * 37) + "\\" + name);
+				break;
+			}
+		}
+		return paths;
+	}
+
+	uint64_t hashLowerTransform(const std::string& a_path, std::string& a_lower)
+	{
+		// Lowercase with std::transform, then hash, as the plugin did before.
+		a_lower.resize(a_path.size());
+		std::transform(a_path.begin(), a_path.end(), a_lower.begin(),
+			[](unsigned char c) { return static_cast<char>(std::tolower(c)); });
+
+		uint64_t hash = FNV1A_OFFSET_BASIS;
+		for (const char c : a_lower) {
+			hash = (hash ^ static_cast<uint8_t>(c)) * FNV1A_PRIME;
+		}
+		return hash;
+	}
+
+	template <class F>
+	double nsPerPath(const std::vector<std::string>& a_paths, int a_reps, F&& a_f)
+	{
+		const auto start = Clock::now();
+		for (int i = 0; i < a_reps; ++i) {
+			for (const auto& path : a_paths) {
+				a_f(path);
+			}
+		}
+		return elapsedNs(start) / (static_cast<double>(a_reps) * a_paths.size());
+	}
+}
+
+int main(int argc, char* argv[])
+{
+	constexpr int REPS = 2000;
+
+	std::setlocale(LC_ALL, "C");
+
+	std::vector<std::string> paths;
+	if (argc > 1) {
+		std::ifstream file(argv[1]);
+		if (!file) {
+			std::printf("%s: can't read it\n", argv[1]);
+			return 2;
+		}
+		for (std::string line; std::getline(file, line);) {
+			if (!line.empty() && line.back() == '\r') {
+				line.pop_back();
+			}
+			if (!line.empty()) {
+				paths.push_back(line);
+			}
+		}
+	} else {
+		paths = makePaths();
+	}
+	if (paths.empty()) {
+		std::printf("usage: lower_ascii_bench [<paths.txt>]\n");
+		return 2;
+	}
+
+	std::size_t nChars = 0;
+	std::size_t longest = 0;
+	for (const auto& path : paths) {
+		nChars += path.size();
+		longest = std::max(longest, path.size());
+	}
+	const double meanLength = static_cast<double>(nChars) / paths.size();
+
+	std::vector<char> buffer(longest);
+	uint64_t sink = 0;
+
+	const double transformNs = nsPerPath(paths, REPS, [&](const std::string& a_path) {
+		std::transform(a_path.begin(), a_path.end(), buffer.begin(),
+			[](unsigned char c) { return static_cast<char>(std::tolower(c)); });
+		sink += static_cast<uint8_t>(buffer[a_path.size() / 2]);
+	});
+	const double lowerNs = nsPerPath(paths, REPS, [&](const std::string& a_path) {
+		toLowerASCII(buffer.data(), a_path.data(), a_path.size());
+		sink += static_cast<uint8_t>(buffer[a_path.size() / 2]);
+	});
+
+	std::string lower;
+	const double hashTransformNs = nsPerPath(paths, REPS, [&](const std::string& a_path) {
+		sink += hashLowerTransform(a_path, lower);
+	});
+	const double hashNs = nsPerPath(paths, REPS, [&](const std::string& a_path) {
+		sink += hashLowerASCII(a_path);
+	});
+
+	std::printf("%zu paths, %.0f chars on average (longest %zu)%s\n", paths.size(), meanLength, longest,
+		argc > 1 ? "" : ", made up");
+	std::printf("  lowercase: std::transform %.1f ns, toLowerASCII %.1f ns per path (%.1fx)\n",
+		transformNs, lowerNs, transformNs / lowerNs);
+	std::printf("  hash:      std::transform + FNV-1a %.1f ns, hashLowerASCII %.1f ns per path (%.1fx)\n",
+		hashTransformNs, hashNs, hashTransformNs / hashNs);
+	g_sink = sink;
+	return 0;
+}
@@ -0,0 +1,150 @@
+// ============================================================================
+//                            lower_ascii_test.cpp
+// ----------------------------------------------------------------------------
+// Part of the open-source Dynamic Animation Replacer (DARGH).
+//
+// Copyright (c) 2023 Nox Sidereum
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the �Software�), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is furnished
+// to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED �AS IS�, WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+// FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+// DEALINGS IN THE SOFTWARE.
+//
+// (The MIT License)
+// ============================================================================
+
+// ----------------------------------------------------------------------------
+// lower_ascii_test: checks toLowerASCII and hashLowerASCII (Utilities.cpp)
+// against std::tolower in the "C" locale, which all our path matching used
+// before, for every byte value:
+//     - each of the 256 byte values at every position of strings of every
+//       length up to 3 SIMD blocks (so in the SSE2 loop and in the scalar
+//       remainder), from every alignment, copying and in place;
+//     - the hash of strings longer than hashLowerASCII's buffer, and of a
+//       string hashed in pieces.
+// Exits with 1 if any check fails.
+//
+//     xmake build lower_ascii_test && xmake run lower_ascii_test
+// ----------------------------------------------------------------------------
+
+#include "Utilities.h"
+
+#include <clocale>
+
+namespace
+{
+	int g_nFailed = 0;
+
+	void check(bool a_ok, std::string_view a_what, std::size_t a_arg)
+	{
+		if (!a_ok) {
+			if (++g_nFailed <= 20) {
+				std::printf("FAILED: %.*s (%zu)\n", static_cast<int>(a_what.size()), a_what.data(), a_arg);
+			}
+		}
+	}
+
+	char lowerC(char a_c)
+	{
+		return static_cast<char>(std::tolower(static_cast<unsigned char>(a_c)));
+	}
+
+	uint64_t hashLowerC(std::string_view a_str, uint64_t a_hash = FNV1A_OFFSET_BASIS)
+	{
+		for (const char c : a_str) {
+			a_hash ^= static_cast<uint8_t>(lowerC(c));
+			a_hash *= FNV1A_PRIME;
+		}
+		return a_hash;
+	}
+
+	void testEveryByteAtEveryPosition()
+	{
+		constexpr std::size_t MAX_LEN = 48;
+		constexpr std::size_t MAX_OFFSET = 16;
+		alignas(16) char src[MAX_OFFSET + MAX_LEN];
+		alignas(16) char dst[MAX_OFFSET + MAX_LEN + 1];
+
+		for (std::size_t len = 1; len <= MAX_LEN; ++len) {
+			for (std::size_t offset = 0; offset < MAX_OFFSET; ++offset) {
+				for (std::size_t pos = 0; pos < len; ++pos) {
+					for (int b = 0; b < 256; ++b) {
+						// The other bytes run through the values too, so that
+						// every byte is next to every other somewhere.
+						char* s = src + offset;
+						for (std::size_t i = 0; i < len; ++i) {
+							s[i] = static_cast<char>(b + 37 * i + 1);
+						}
+						s[pos] = static_cast<char>(b);
+
+						char* d = dst + (MAX_OFFSET - 1 - offset);
+						d[len] = '\x5A';
+						toLowerASCII(d, s, len);
+						bool ok = d[len] == '\x5A';
+						for (std::size_t i = 0; i < len; ++i) {
+							ok &= d[i] == lowerC(s[i]);
+						}
+						check(ok, "toLowerASCII", static_cast<std::size_t>(b));
+
+						std::string expected(len, '\0');
+						for (std::size_t i = 0; i < len; ++i) {
+							expected[i] = lowerC(s[i]);
+						}
+						toLowerASCII(s, s, len);
+						check(std::string_view(s, len) == expected, "toLowerASCII in place", static_cast<std::size_t>(b));
+					}
+				}
+			}
+		}
+	}
+
+	void testHashes()
+	{
+		// Every byte value, in strings up to several times the 256-char
+		// buffer that hashLowerASCII lowercases into.
+		std::string str;
+		for (std::size_t i = 0; i < 1100; ++i) {
+			str.push_back(static_cast<char>(i * 7));
+		}
+		for (std::size_t len = 0; len <= str.size(); ++len) {
+			const std::string_view s(str.data(), len);
+			check(hashLowerASCII(s) == hashLowerC(s), "hashLowerASCII", len);
+		}
+
+		// In pieces, as the hash of a path is made from its folder and file.
+		for (std::size_t split = 0; split <= 600; ++split) {
+			const std::string_view s(str.data(), 600);
+			check(hashLowerASCII(s.substr(split), hashLowerASCII(s.substr(0, split))) == hashLowerC(s),
+				"hashLowerASCII in pieces", split);
+		}
+
+		// And paths that differ only in case hash the same.
+		check(hashLowerASCII("Meshes\\Actors\\Character\\Animations\\MT_Idle.HKX") ==
+				  hashLowerASCII("meshes\\actors\\character\\animations\\mt_idle.hkx"),
+			"hashLowerASCII ignores case", 0);
+	}
+}
+
+int main()
+{
+	std::setlocale(LC_ALL, "C");
+
+	testEveryByteAtEveryPosition();
+	testHashes();
+
+	std::printf("lower_ascii_test: %s (%d failed)\n", g_nFailed ? "FAILED" : "passed", g_nFailed);
+	return g_nFailed ? 1 : 0;
+}
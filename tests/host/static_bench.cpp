@@ -0,0 +1,138 @@
+// ============================================================================
+//                              static_bench.cpp
+// ----------------------------------------------------------------------------
+// Part of the open-source Dynamic Animation Replacer (DARGH).
+//
+// Copyright (c) 2023 Nox Sidereum
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the �Software�), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is furnished
+// to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED �AS IS�, WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+// FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+// DEALINGS IN THE SOFTWARE.
+//
+// (The MIT License)
+// ============================================================================
+
+// ----------------------------------------------------------------------------
+// static_bench: measures how much chain evaluation StaticConditionCache saves
+// (see StaticConditions.h) on a real DynamicAnimationReplacer tree.
+//
+// The tree is loaded twice (see DARTree.h), with StaticConditionCache off
+// and on and DecisionDiagrams off. Every actor then activates every replaced
+// animation, in a few world states, through both projects. Reports:
+//     - how many chains have a static part, and the cache's size;
+//     - condition function calls (predicate evaluations) per decision:
+//       unsplit, split with an empty cache (i.e. including filling it for
+//       each kind of actor), and split once every kind is cached;
+//     - the time per decision, unsplit and split once cached.
+// Exits with 1 if the two ever choose differently.
+//
+//     xmake build static_bench
+//     xmake run static_bench <...\animations\DynamicAnimationReplacer | x.darpack>...
+// ----------------------------------------------------------------------------
+
+#include "DARTree.h"
+#include "Plugin.h"
+
+namespace
+{
+	constexpr uint32_t N_ACTORS = 64;
+	constexpr uint32_t N_WORLD_STATES = 16;
+
+	bool bench(const std::filesystem::path& a_path)
+	{
+		Plugin::COMPILE_DECISION_DIAGRAMS = false;
+
+		DARProject unsplit;
+		Plugin::CACHE_STATIC_CONDITIONS = false;
+		if (!DARTree::loadProject(a_path, unsplit)) {
+			return false;
+		}
+		DARProject split;
+		Plugin::CACHE_STATIC_CONDITIONS = true;
+		if (!DARTree::loadProject(a_path, split)) {
+			return false;
+		}
+
+		const auto& pool = split.folderData->conditionPool;
+		const auto nStatic = std::count_if(pool.staticChain.begin(), pool.staticChain.end(),
+			[](uint32_t a_chain) { return a_chain != ConditionPool::NO_CHAIN; });
+		std::printf("%s: %zu chains, %zd with a static part\n", a_path.string().c_str(), pool.staticChain.size(), nStatic);
+		if (!pool.statics) {
+			return true;
+		}
+
+		std::vector<int16_t> replaced;
+		for (const auto& [fromIndex, links] : split.remapPlan.load()->allLinks) {
+			replaced.push_back(static_cast<int16_t>(fromIndex));
+		}
+		std::sort(replaced.begin(), replaced.end());
+
+		DARTree::Actors actors;
+		DARTree::makeActors(*split.folderData, N_ACTORS, actors);
+		const auto activations = DARTree::makeActivations(actors, replaced, N_WORLD_STATES);
+
+		// The first replay of the split project fills its cache.
+		std::vector<int16_t> unsplitChoices;
+		std::vector<int16_t> splitChoices;
+		const auto unsplitPath = DARTree::replay(unsplit, activations, &unsplitChoices);
+		const auto coldPath = DARTree::replay(split, activations, &splitChoices);
+		const auto warmPath = DARTree::replay(split, activations, nullptr);
+
+		uint64_t nMismatches = 0;
+		for (std::size_t i = 0; i < activations.size(); ++i) {
+			if (unsplitChoices[i] != splitChoices[i] && nMismatches++ == 0) {
+				std::printf("  MISMATCH: index %d, actor %08X, world state %u: unsplit %d, split %d\n",
+					activations[i].fromIndex, activations[i].actor->GetFormID(), activations[i].worldState,
+					unsplitChoices[i], splitChoices[i]);
+			}
+		}
+
+		// Time them again without recording the choices, best of a few.
+		constexpr int REPS = 5;
+		double unsplitNs = unsplitPath.ns;
+		double splitNs = warmPath.ns;
+		for (int i = 0; i < REPS; ++i) {
+			unsplitNs = std::min(unsplitNs, DARTree::replay(unsplit, activations, nullptr).ns);
+			splitNs = std::min(splitNs, DARTree::replay(split, activations, nullptr).ns);
+		}
+
+		const double nDecisions = static_cast<double>(activations.size());
+		std::printf("  %zu decisions (%u actors x %u world states x %zu animations), %u kinds of actor cached in %zu bytes\n",
+			activations.size(), N_ACTORS, N_WORLD_STATES, replaced.size(), pool.statics->size(), pool.statics->sizeInBytes());
+		std::printf("  predicate evaluations per decision: unsplit %.2f, split %.2f filling the cache, %.2f cached (%.0f%% fewer)\n",
+			unsplitPath.nCalls / nDecisions, coldPath.nCalls / nDecisions, warmPath.nCalls / nDecisions,
+			100.0 * (1.0 - static_cast<double>(warmPath.nCalls) / std::max<uint64_t>(unsplitPath.nCalls, 1)));
+		std::printf("  time per decision: unsplit %.1f ns, split %.1f ns cached\n",
+			unsplitNs / nDecisions, splitNs / nDecisions);
+		std::printf("  %llu mismatches\n", static_cast<unsigned long long>(nMismatches));
+		return nMismatches == 0;
+	}
+}
+
+int main(int argc, char* argv[])
+{
+	if (argc < 2) {
+		std::printf("usage: static_bench <...\\animations\\DynamicAnimationReplacer | x.darpack>...\n");
+		return 2;
+	}
+
+	bool bOK = true;
+	for (int i = 1; i < argc; ++i) {
+		bOK &= bench(argv[i]);
+	}
+	return bOK ? 0 : 1;
+}
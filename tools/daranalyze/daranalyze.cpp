@@ -0,0 +1,445 @@
+// ============================================================================
+//                               daranalyze.cpp
+// ----------------------------------------------------------------------------
+// Part of the open-source Dynamic Animation Replacer (DARGH).
+//
+// Copyright (c) 2023 Nox Sidereum
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the �Software�), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is furnished
+// to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED �AS IS�, WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+// FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+// DEALINGS IN THE SOFTWARE.
+//
+// (The MIT License)
+// ============================================================================
+
+// ----------------------------------------------------------------------------
+// daranalyze: reports on every DynamicAnimationReplacer tree under a copy of
+// Data\meshes, without starting the game. For each project folder it reports
+//     - the number of replacement folders and animations (M1 and M2);
+//     - the animation slots they need against MAX_ANIMATION_FILES, and what
+//       PackByPriority would keep if they don't fit;
+//     - animations replaced by more than one folder;
+//     - condition statistics (terms, functions, referenced plugins, errors);
+//     - the memory dargh is projected to use for it at runtime.
+//
+// Each tree is compiled in memory with the darpack compiler, so it is read
+// exactly as dargh reads it, and the report is built from the compiled pack.
+//
+// Usage:
+//     daranalyze <path to Data\meshes> [--originals <count>] [--limit <count>]
+//
+// The original animation names come from the game's behavior files, which
+// aren't read here: the slot counts assume every replaced animation is among
+// the originals, plus --originals (default 0) original names. dargh logs the
+// exact counts for each project ("... / 16384 : (project)") once loaded.
+// --limit is AnimationLimit from DynamicAnimationReplacer.ini (default 16384).
+// ----------------------------------------------------------------------------
+
+#include "DARCompiler.h"
+
+#include <algorithm>
+#include <chrono>
+#include <iostream>
+#include <map>
+#include <set>
+#include <sstream>
+#include <string>
+#include <unordered_map>
+#include <unordered_set>
+
+namespace fs = std::filesystem;
+
+namespace
+{
+	// ========================================================================
+	//                           MEMORY ESTIMATES
+	// ------------------------------------------------------------------------
+	// Approximate sizes (in bytes) of dargh's runtime structures in an x64
+	// MSVC build, including the allocator's per-block overhead.
+	// ========================================================================
+	namespace Size
+	{
+		constexpr std::size_t HEAP_BLOCK = 16;            // allocator overhead per allocation
+		constexpr std::size_t STRING = 32;                // std::string, short strings (< 16 chars) inline
+		constexpr std::size_t ACTOR_BASE_LINK = 72;       // ActorBaseLink
+		constexpr std::size_t CONDITION_LINK = 104;       // ConditionLink (its conditions are pooled)
+		constexpr std::size_t LINK_INDEX_ENTRY = 64;      // DARFolderData link index: node + bucket + vector
+		constexpr std::size_t POOL_TERM = 19;             // ConditionPool: op, flags, 2 args
+		constexpr std::size_t POOL_CHAIN = 8;             // ConditionPool: chainStart, chainDeps
+		constexpr std::size_t POOL_FIXED = 53 * 8;        // ConditionPool::dispatch
+		constexpr std::size_t ANIM_NAME = 8;              // DARRemapPlan::animNames, per slot
+		constexpr std::size_t ORIGINAL_NAME = 40;         // average original animation name, in namePool
+		constexpr std::size_t ALL_LINKS_ENTRY = 56;       // DARRemapPlan::allLinks: node + bucket + LinkMap
+		constexpr std::size_t LINK_MAP_NODE = 48;         // LinkMap (std::map) node
+		constexpr std::size_t CONDITION_LINK_DATA = 48;   // ConditionLinkData + its linkPool entry
+		constexpr std::size_t ACTOR_BASE_ENTRY = 10;      // ActorBaseTable, per slot (key + value)
+	}
+
+	std::size_t stringBytes(std::size_t a_length)
+	{
+		// std::string, plus its heap block if it doesn't fit inline.
+		return Size::STRING + (a_length < 16 ? 0 : ((a_length + 16) & ~std::size_t(15)) + Size::HEAP_BLOCK);
+	}
+
+	std::string toLower(std::string s)
+	{
+		std::transform(s.begin(), s.end(), s.begin(), [](unsigned char c) { return static_cast<char>(std::tolower(c)); });
+		return s;
+	}
+
+	std::string kb(std::size_t a_bytes)
+	{
+		std::ostringstream ss;
+		ss << (a_bytes + 512) / 1024 << " KB";
+		return ss.str();
+	}
+
+	struct Options
+	{
+		uint32_t originals = 0;
+		uint32_t limit = 16384;
+	};
+
+	// One replacement folder, i.e. DynamicAnimationReplacer\(esp name)\(actor base id)
+	// or DynamicAnimationReplacer\_CustomConditions\(priority).
+	struct Folder
+	{
+		std::string name;
+		int32_t priority;                                 // 0 for actor base folders
+		uint32_t nFiles;
+		std::size_t toNameBytes = 0;                      // the folder's TO animation names, in namePool
+		bool bKeep = true;                                // kept by PackByPriority
+	};
+
+	void analyze(const std::string& a_project, const DARPack::View& a_pack, const std::string& a_loadLog,
+		const Options& a_options)
+	{
+		// ====================================================================
+		//                              analyze
+		// --------------------------------------------------------------------
+		// Reports on one project folder's compiled DynamicAnimationReplacer
+		// tree. 'a_loadLog' is what the compiler reported while reading it.
+		// ====================================================================
+		const auto paths = a_pack.paths();
+		const auto actorBaseFolders = a_pack.actorBaseFolders();
+		const auto priorityFolders = a_pack.priorityFolders();
+		const auto terms = a_pack.terms();
+
+		std::vector<Folder> folders;
+		std::unordered_map<std::string, std::vector<uint32_t>> replacedBy;   // FROM animation => folders
+		std::size_t loadBytes = 0;
+		std::set<std::pair<uint32_t, uint32_t>> actorBases;
+		std::size_t nM1 = 0;
+		std::size_t nM2 = 0;
+
+		const auto addFolder = [&](const std::string& a_prefix, const char* a_name, int32_t a_priority,
+			                       DARPack::Range a_paths, std::size_t a_linkSize) {
+			const auto folderIndex = static_cast<uint32_t>(folders.size());
+			folders.push_back({ a_prefix + a_name, a_priority, a_paths.count });
+			for (const auto path : DARPack::View::slice(paths, a_paths)) {
+				const std::string file = a_pack.string(path);
+				const std::string from = "animations\\" + toLower(file);
+				const auto toLength = std::string_view("Animations\\DynamicAnimationReplacer\\").size() +
+				                      folders.back().name.size() + 1 + file.size();
+				auto& folderList = replacedBy[from];
+				if (folderList.empty() || folderList.back() != folderIndex) {
+					folderList.push_back(folderIndex);
+				}
+				loadBytes += a_linkSize + stringBytes(from.size()) + stringBytes(toLength);
+				folders.back().toNameBytes += toLength + 1;
+			}
+		};
+
+		for (const auto& folder : actorBaseFolders) {
+			addFolder(std::string(a_pack.string(a_pack.plugins()[folder.plugin])) + "\\", a_pack.string(folder.name),
+				0, folder.paths, Size::ACTOR_BASE_LINK);
+			actorBases.insert({ folder.plugin, folder.actorBaseID });
+			nM1 += folder.paths.count;
+		}
+
+		// Conditions.
+		std::map<std::string, uint32_t> funcUsage;
+		std::set<uint32_t> plugins;
+		uint32_t nErrors = 0;
+		uint32_t nChains = 0;
+		uint32_t nTerms = 0;
+		uint32_t maxTerms = 0;
+		uint32_t nOrTerms = 0;
+		uint32_t nNotTerms = 0;
+		for (const auto& folder : priorityFolders) {
+			if (folder.errorLine != DARPack::NO_STRING) {
+				// dargh doesn't load folders whose conditions don't parse.
+				++nErrors;
+				continue;
+			}
+
+			addFolder("_CustomConditions\\", a_pack.string(folder.name), folder.priority, folder.paths, Size::CONDITION_LINK);
+			nM2 += folder.paths.count;
+			if (folder.paths.count == 0) {
+				continue;
+			}
+
+			++nChains;
+			nTerms += folder.terms.count;
+			maxTerms = std::max(maxTerms, folder.terms.count);
+			for (const auto& term : DARPack::View::slice(terms, folder.terms)) {
+				++funcUsage[a_pack.string(term.funcName)];
+				nOrTerms += (term.flags & DARPack::kAnd) ? 0 : 1;
+				nNotTerms += (term.flags & DARPack::kNot) ? 1 : 0;
+				for (const auto& arg : DARPack::View::slice(a_pack.args(), term.args)) {
+					if (arg.kind == DARPack::ArgKind::kForm) {
+						plugins.insert(arg.plugin);
+					}
+				}
+			}
+		}
+		for (const auto& folder : actorBaseFolders) {
+			plugins.insert(folder.plugin);
+		}
+
+		std::cout << a_project << "\n";
+		std::cout << "  folders:      " << actorBaseFolders.size() << " actor base, " << priorityFolders.size() << " priority";
+		if (nErrors > 0) {
+			std::cout << " (" << nErrors << " not loaded: their conditions don't parse)";
+		}
+		std::cout << "\n";
+		std::cout << "  replacements: " << nM1 << " actor base (" << actorBases.size() << " actor bases), " << nM2
+		          << " priority, replacing " << replacedBy.size() << " animations\n";
+
+		// Slots (see buildRemapPlan): [M1 | M2 | padding | originals]. As in DAR,
+		// one slot must be left over for everything to be loaded.
+		const auto nReplacements = static_cast<uint32_t>(nM1 + nM2);
+		const uint32_t nNew = a_options.originals + nReplacements;
+		std::cout << "  slots:        " << nNew << " / " << a_options.limit << " (" << a_options.originals << " originals + "
+		          << nReplacements << " replacements)";
+		if (nNew < a_options.limit) {
+			std::cout << ", " << a_options.limit - nNew << " free\n";
+		} else {
+			std::cout << " - too many, nothing would be loaded\n";
+
+			// Simulate packByPriority: keep whole folders by descending priority
+			// while they fit.
+			std::vector<Folder*> byPriority;
+			for (auto& folder : folders) {
+				byPriority.push_back(&folder);
+			}
+			std::stable_sort(byPriority.begin(), byPriority.end(),
+				[](const Folder* a_lhs, const Folder* a_rhs) { return a_lhs->priority > a_rhs->priority; });
+
+			const uint32_t nSlots = a_options.originals < a_options.limit ? a_options.limit - a_options.originals - 1 : 0;
+			uint32_t nUsed = 0;
+			std::vector<const Folder*> dropped;
+			for (const auto folder : byPriority) {
+				if (nUsed + folder->nFiles <= nSlots) {
+					nUsed += folder->nFiles;
+				} else {
+					folder->bKeep = false;
+					dropped.push_back(folder);
+				}
+			}
+			std::cout << "  PackByPriority would keep " << folders.size() - dropped.size() << " of " << folders.size()
+			          << " folders (" << nUsed << " / " << nSlots << " free slots), dropping:\n";
+			for (const auto folder : dropped) {
+				std::cout << "    " << folder->name << " (" << folder->nFiles << " files, priority " << folder->priority << ")\n";
+			}
+		}
+
+		// Animations replaced by more than one folder: each replacement takes a slot,
+		// but only the highest priority one whose conditions are true is ever used.
+		std::vector<std::pair<std::size_t, const std::string*>> duplicates;
+		std::size_t nExtraSlots = 0;
+		for (const auto& [from, folderList] : replacedBy) {
+			if (folderList.size() > 1) {
+				duplicates.push_back({ folderList.size(), &from });
+				nExtraSlots += folderList.size() - 1;
+			}
+		}
+		if (!duplicates.empty()) {
+			std::sort(duplicates.begin(), duplicates.end(),
+				[](const auto& a_lhs, const auto& a_rhs) { return a_lhs.first != a_rhs.first ? a_lhs.first > a_rhs.first : *a_lhs.second < *a_rhs.second; });
+			std::cout << "  duplicates:   " << duplicates.size() << " animations replaced by more than one folder ("
+			          << nExtraSlots << " extra slots), most replaced:\n";
+			for (std::size_t i = 0; i < std::min<std::size_t>(duplicates.size(), 5); ++i) {
+				std::cout << "    " << *duplicates[i].second << " (" << duplicates[i].first << " folders)\n";
+			}
+		}
+
+		if (nChains > 0) {
+			std::cout << "  conditions:   " << nChains << " chains, " << nTerms << " terms (avg " << std::fixed;
+			std::cout.precision(1);
+			std::cout << static_cast<double>(nTerms) / nChains << ", max " << maxTerms << "), " << nOrTerms << " OR, "
+			          << nNotTerms << " NOT\n";
+
+			std::vector<std::pair<uint32_t, std::string>> byUsage;
+			for (const auto& [name, count] : funcUsage) {
+				byUsage.push_back({ count, name });
+			}
+			std::stable_sort(byUsage.begin(), byUsage.end(), [](const auto& a_lhs, const auto& a_rhs) { return a_lhs.first > a_rhs.first; });
+			std::cout << "  functions:   ";
+			for (const auto& [count, name] : byUsage) {
+				std::cout << " " << name << " " << count;
+			}
+			std::cout << "\n";
+		}
+		if (!plugins.empty()) {
+			std::cout << "  plugins:     ";
+			for (const auto plugin : plugins) {
+				std::cout << " " << a_pack.string(a_pack.plugins()[plugin]);
+			}
+			std::cout << "\n";
+		}
+		if (!a_loadLog.empty()) {
+			std::cout << "  loading:\n";
+			std::istringstream lines(a_loadLog);
+			for (std::string line; std::getline(lines, line);) {
+				std::cout << "    " << line << "\n";
+			}
+		}
+
+		// Memory. The links are loaded once per project folder; a remap plan is built
+		// once per distinct set of original animation names, and shared by every
+		// character using it.
+		loadBytes += replacedBy.size() * Size::LINK_INDEX_ENTRY;
+		if (nChains > 0) {
+			loadBytes += Size::POOL_FIXED + nTerms * Size::POOL_TERM + (nChains + 1) * Size::POOL_CHAIN;
+		}
+
+		const auto planBytes = [&](bool a_bPacked) -> std::size_t {
+			// The plan's animNames and original names, plus (if they're loaded) the
+			// replacements of the folders that are kept.
+			if (a_options.originals >= a_options.limit) {
+				return 0;
+			}
+			std::size_t nBytes = a_options.limit * Size::ANIM_NAME + a_options.originals * Size::ORIGINAL_NAME;
+			if (nNew >= a_options.limit && !a_bPacked) {
+				return nBytes;
+			}
+
+			std::size_t nFromIndices = 0;
+			std::size_t nM1FromIndices = 0;
+			std::size_t nM1Links = 0;
+			for (const auto& [from, folderList] : replacedBy) {
+				bool bKept = false;
+				bool bKeptM1 = false;
+				for (const auto index : folderList) {
+					const auto& folder = folders[index];
+					if (folder.bKeep) {
+						bKept = true;
+						bKeptM1 |= index < actorBaseFolders.size();
+					}
+				}
+				nFromIndices += bKept;
+				nM1FromIndices += bKeptM1;
+			}
+			for (std::size_t i = 0; i < folders.size(); ++i) {
+				if (!folders[i].bKeep) {
+					continue;
+				}
+				nBytes += folders[i].toNameBytes;
+				if (i < actorBaseFolders.size()) {
+					nM1Links += folders[i].nFiles;
+				} else {
+					nBytes += folders[i].nFiles * (Size::LINK_MAP_NODE + Size::CONDITION_LINK_DATA);
+				}
+			}
+
+			std::size_t actorBaseCapacity = 0;
+			if (nM1Links > 0) {
+				actorBaseCapacity = 16;
+				while (nM1Links * 2 > actorBaseCapacity) {
+					actorBaseCapacity *= 2;
+				}
+			}
+			return nBytes + nFromIndices * Size::ALL_LINKS_ENTRY + nM1FromIndices * Size::LINK_MAP_NODE +
+			       actorBaseCapacity * Size::ACTOR_BASE_ENTRY;
+		};
+
+		std::cout << "  memory:       ~" << kb(loadBytes) << " loaded, ~" << kb(planBytes(false)) << " per remap plan";
+		if (nNew >= a_options.limit) {
+			std::cout << " (~" << kb(planBytes(true)) << " packed by priority)";
+		}
+		std::cout << "\n\n";
+	}
+}
+
+int main(int argc, char* argv[])
+{
+	Options options;
+	fs::path meshesDir;
+	for (int i = 1; i < argc; ++i) {
+		const std::string arg = argv[i];
+		if ((arg == "--originals" || arg == "--limit") && i + 1 < argc) {
+			try {
+				(arg == "--originals" ? options.originals : options.limit) = static_cast<uint32_t>(std::stoul(argv[++i]));
+				continue;
+			} catch (const std::exception&) {}
+		} else if (meshesDir.empty() && !arg.starts_with("--")) {
+			meshesDir = fs::path(arg).lexically_normal();
+			continue;
+		}
+		meshesDir.clear();
+		break;
+	}
+	if (meshesDir.empty()) {
+		std::cerr << "usage: daranalyze <path to Data\\meshes> [--originals <count>] [--limit <count>]\n";
+		return 2;
+	}
+	if (!fs::is_directory(meshesDir)) {
+		std::cerr << "not a folder: " << meshesDir.string() << "\n";
+		return 1;
+	}
+
+	const auto start = std::chrono::steady_clock::now();
+
+	// Find every (project folder)\animations\DynamicAnimationReplacer.
+	std::vector<fs::path> darDirs;
+	std::error_code ec;
+	for (auto it = fs::recursive_directory_iterator(meshesDir, fs::directory_options::skip_permission_denied, ec);
+		 it != fs::recursive_directory_iterator(); it.increment(ec)) {
+		if (ec) {
+			break;
+		}
+		if (it->is_directory(ec) && toLower(it->path().filename().string()) == "dynamicanimationreplacer" &&
+			toLower(it->path().parent_path().filename().string()) == "animations") {
+			darDirs.push_back(it->path());
+			it.disable_recursion_pending();
+		}
+	}
+	std::sort(darDirs.begin(), darDirs.end());
+
+	std::size_t nFiles = 0;
+	for (const auto& darDir : darDirs) {
+		auto project = darDir.parent_path().parent_path().lexically_relative(meshesDir).string();
+		std::replace(project.begin(), project.end(), '/', '\\');
+
+		std::ostringstream log;
+		const auto data = compileDARTree(darDir, log);
+		DARPack::View pack;
+		if (!pack.open(data.data(), data.size())) {
+			std::cerr << project << ": couldn't compile\n";
+			continue;
+		}
+		analyze(project, pack, log.str(), options);
+		nFiles += pack.paths().size();
+	}
+
+	const std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+	std::cout << darDirs.size() << " projects, " << nFiles << " replacement animations, analyzed in ";
+	std::cout.precision(2);
+	std::cout << std::fixed << elapsed.count() << " s\n";
+	return 0;
+}
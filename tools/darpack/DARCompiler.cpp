@@ -0,0 +1,449 @@
+// ============================================================================
+//                              DARCompiler.cpp
+// ----------------------------------------------------------------------------
+// Part of the open-source Dynamic Animation Replacer (DARGH).
+//
+// Copyright (c) 2023 Nox Sidereum
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the �Software�), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is furnished
+// to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED �AS IS�, WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+// FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+// DEALINGS IN THE SOFTWARE.
+//
+// (The MIT License)
+// ============================================================================
+
+#include "DARCompiler.h"
+
+#include <algorithm>
+#include <bit>
+#include <cmath>
+#include <fstream>
+#include <optional>
+#include <ostream>
+#include <sstream>
+#include <string>
+#include <unordered_map>
+
+namespace fs = std::filesystem;
+
+namespace
+{
+	// ========================================================================
+	//                            STRING HELPERS
+	// ------------------------------------------------------------------------
+	// These mirror the ones in Utilities.cpp, so that the tree is parsed
+	// exactly as dargh would parse it.
+	// ========================================================================
+	std::string trim(const std::string& s)
+	{
+		const size_t posStart = s.find_first_not_of(" \t");
+		if (posStart == std::string::npos) {
+			return "";
+		}
+		const size_t posLast = s.find_last_not_of(" \t");
+		return s.substr(posStart, posLast - posStart + 1);
+	}
+
+	bool startsWith(const std::string& str, const std::string& prefix)
+	{
+		return str.size() >= prefix.size() && !str.compare(0, prefix.size(), prefix);
+	}
+
+	bool endsWith(const std::string& str, const std::string& suffix)
+	{
+		return str.size() >= suffix.size() && !str.compare(str.size() - suffix.size(), suffix.size(), suffix);
+	}
+
+	bool isNumber(const std::string& s)
+	{
+		return std::find_if(s.begin(), s.end(), [](unsigned char c) { return !std::isdigit(c); }) == s.end();
+	}
+
+	bool isPluginName(const std::string& s)
+	{
+		return endsWith(s, ".esp") || endsWith(s, ".esm") || endsWith(s, ".esl");
+	}
+
+	std::vector<std::string> splitOnCommas(const std::string& strArgs)
+	{
+		// Arguments are separated by ',', unless quoted.
+		std::vector<std::string> vec;
+		bool inQuote = false;
+		std::string cur;
+		for (const char c : strArgs) {
+			if (c == '"') {
+				inQuote = !inQuote;
+			}
+			if (c == ',' && !inQuote) {
+				vec.push_back(cur);
+				cur.clear();
+			} else {
+				cur += c;
+			}
+		}
+		if (!cur.empty()) {
+			vec.push_back(cur);
+		}
+		return vec;
+	}
+
+	std::vector<std::string> splitOnPipes(const std::string& sArg)
+	{
+		std::vector<std::string> vec;
+		std::istringstream ss(sArg);
+		std::string sToken;
+		while (std::getline(ss, sToken, '|')) {
+			vec.push_back(sToken);
+		}
+		return vec;
+	}
+
+	std::optional<uint32_t> parseUInt(const std::string& s)
+	{
+		// As std::stoi(s, nullptr, 0), but reports errors instead of throwing.
+		try {
+			std::size_t pos;
+			const long long value = std::stoll(s, &pos, 0);
+			if (pos != s.size() || value < 0 || value > 0xFFFFFFFF) {
+				return std::nullopt;
+			}
+			return static_cast<uint32_t>(value);
+		} catch (const std::exception&) {
+			return std::nullopt;
+		}
+	}
+
+	// ========================================================================
+	//                            DIRECTORY HELPERS
+	// ========================================================================
+	bool lessCaseInsensitive(const std::string& a, const std::string& b)
+	{
+		// Approximates the order in which Windows lists a folder.
+		return std::lexicographical_compare(a.begin(), a.end(), b.begin(), b.end(),
+			[](unsigned char x, unsigned char y) { return std::toupper(x) < std::toupper(y); });
+	}
+
+	std::vector<std::string> listSubfolders(const fs::path& a_dir)
+	{
+		std::vector<std::string> names;
+		std::error_code ec;
+		for (const auto& entry : fs::directory_iterator(a_dir, ec)) {
+			if (entry.is_directory()) {
+				names.push_back(entry.path().filename().string());
+			}
+		}
+		std::sort(names.begin(), names.end(), lessCaseInsensitive);
+		return names;
+	}
+
+	void findHkxFiles(const fs::path& a_dir, const std::string& a_subDir, std::vector<std::string>& a_out)
+	{
+		// Recursively finds the .hkx files under 'a_dir', as paths relative
+		// to it with '\' separators (as dargh's findMatchingFiles does).
+		std::vector<std::pair<std::string, bool>> entries;
+		std::error_code ec;
+		for (const auto& entry : fs::directory_iterator(a_dir, ec)) {
+			entries.emplace_back(entry.path().filename().string(), entry.is_directory());
+		}
+		std::sort(entries.begin(), entries.end(),
+			[](const auto& a, const auto& b) { return lessCaseInsensitive(a.first, b.first); });
+
+		for (const auto& [name, bIsDir] : entries) {
+			if (bIsDir) {
+				findHkxFiles(a_dir / name, a_subDir + name + "\\", a_out);
+			} else if (endsWith(name, ".hkx")) {
+				a_out.push_back(a_subDir + name);
+			}
+		}
+	}
+
+	// ========================================================================
+	//                              PACK BUILDER
+	// ========================================================================
+	class PackBuilder
+	{
+	public:
+		uint32_t addString(const std::string& a_str)
+		{
+			const auto [it, bAdded] = stringOffsets.try_emplace(a_str, static_cast<uint32_t>(strings.size()));
+			if (bAdded) {
+				strings.insert(strings.end(), a_str.begin(), a_str.end());
+				strings.push_back('\0');
+			}
+			return it->second;
+		}
+
+		uint32_t addPlugin(const std::string& a_name)
+		{
+			const auto [it, bAdded] = pluginIndices.try_emplace(a_name, static_cast<uint32_t>(plugins.size()));
+			if (bAdded) {
+				plugins.push_back(addString(a_name));
+			}
+			return it->second;
+		}
+
+		DARPack::Range addPaths(const std::vector<std::string>& a_paths)
+		{
+			DARPack::Range range{ static_cast<uint32_t>(paths.size()), static_cast<uint32_t>(a_paths.size()) };
+			for (const auto& path : a_paths) {
+				paths.push_back(addString(path));
+			}
+			return range;
+		}
+
+		std::vector<char> strings;
+		std::vector<uint32_t> plugins;
+		std::vector<uint32_t> paths;
+		std::vector<DARPack::ActorBaseFolder> actorBaseFolders;
+		std::vector<DARPack::PriorityFolder> priorityFolders;
+		std::vector<DARPack::Term> terms;
+		std::vector<DARPack::Arg> args;
+
+		std::vector<char> serialize() const
+		{
+			std::vector<char> file(sizeof(DARPack::Header));
+			DARPack::Header header{};
+			std::memcpy(header.magic, DARPack::MAGIC, sizeof(DARPack::MAGIC));
+			header.version = DARPack::VERSION;
+
+			auto append = [&file](const void* a_data, std::size_t a_recordSize, std::size_t a_count) {
+				file.resize((file.size() + 3) & ~std::size_t{ 3 });
+				const DARPack::Table table{ static_cast<uint32_t>(file.size()), static_cast<uint32_t>(a_count) };
+				const auto bytes = static_cast<const char*>(a_data);
+				file.insert(file.end(), bytes, bytes + a_recordSize * a_count);
+				return table;
+			};
+
+			header.plugins = append(plugins.data(), sizeof(uint32_t), plugins.size());
+			header.paths = append(paths.data(), sizeof(uint32_t), paths.size());
+			header.actorBaseFolders = append(actorBaseFolders.data(), sizeof(DARPack::ActorBaseFolder), actorBaseFolders.size());
+			header.priorityFolders = append(priorityFolders.data(), sizeof(DARPack::PriorityFolder), priorityFolders.size());
+			header.terms = append(terms.data(), sizeof(DARPack::Term), terms.size());
+			header.args = append(args.data(), sizeof(DARPack::Arg), args.size());
+			header.strings = append(strings.data(), 1, strings.size());
+			header.fileSize = static_cast<uint32_t>(file.size());
+			std::memcpy(file.data(), &header, sizeof(header));
+			return file;
+		}
+
+	private:
+		std::unordered_map<std::string, uint32_t> stringOffsets;
+		std::unordered_map<std::string, uint32_t> pluginIndices;
+	};
+
+	// ========================================================================
+	//                          METHOD 1: ACTOR BASE
+	// ========================================================================
+	void compileActorBaseFolders(const fs::path& a_darDir, PackBuilder& a_pack, std::ostream& a_log)
+	{
+		for (const auto& modName : listSubfolders(a_darDir)) {
+			if (!isPluginName(modName)) {
+				continue;    // Not a valid mod name (e.g. _CustomConditions).
+			}
+
+			for (const auto& sActorBaseID : listSubfolders(a_darDir / modName)) {
+				// The base ID should be exactly 8 hex digits, starting 00.
+				const auto actorBaseID = parseUInt("0x" + sActorBaseID);
+				if (sActorBaseID.size() != 8 || !actorBaseID || *actorBaseID > 0xFFFFFF) {
+					a_log << "skipping " << modName << "\\" << sActorBaseID << ": not a valid actor base ID\n";
+					continue;
+				}
+
+				std::vector<std::string> hkxFiles;
+				findHkxFiles(a_darDir / modName / sActorBaseID, "", hkxFiles);
+
+				DARPack::ActorBaseFolder folder{};
+				folder.plugin = a_pack.addPlugin(modName);
+				folder.actorBaseID = *actorBaseID;
+				folder.name = a_pack.addString(sActorBaseID);
+				folder.paths = a_pack.addPaths(hkxFiles);
+				a_pack.actorBaseFolders.push_back(folder);
+			}
+		}
+	}
+
+	// ========================================================================
+	//                       METHOD 2: CUSTOM CONDITIONS
+	// ========================================================================
+	bool parseConditions(const std::vector<std::string>& a_lines, PackBuilder& a_pack, std::vector<DARPack::Term>& a_terms,
+		std::vector<DARPack::Arg>& a_args, std::size_t& a_errorLine)
+	{
+		// Parses the (non-empty, non-comment) lines of a _conditions.txt
+		// file with the same grammar as loadDARMaps_Conditional:
+		//
+		//     (NOT) Function name("esp name" | formID, ...) (AND or OR)
+		//
+		// Returns false on a syntax error, with the line in 'a_errorLine'.
+		for (std::size_t iLineNum = 0; iLineNum < a_lines.size(); ++iLineNum) {
+			a_errorLine = iLineNum;
+			std::string line = a_lines[iLineNum];
+			const bool bLastLine = iLineNum == a_lines.size() - 1;
+
+			DARPack::Term term{};
+			term.flags = DARPack::kAnd;
+			if (startsWith(line, "NOT ") || startsWith(line, "NOT\t")) {
+				term.flags |= DARPack::kNot;
+				line = line.substr(3);
+			}
+
+			const std::size_t posLB = line.find_first_of('(');
+			const std::size_t posRB = line.find_first_of(')');
+			if (posLB == std::string::npos || posRB == std::string::npos || posRB < posLB) {
+				return false;
+			}
+			term.funcName = a_pack.addString(trim(line.substr(0, posLB)));
+
+			const std::string rest = trim(line.substr(posRB + 1));
+			if (rest.empty()) {
+				if (!bLastLine) {
+					return false;    // Don't know whether to AND or OR the next line.
+				}
+			} else if (startsWith(rest, "OR")) {
+				term.flags &= ~DARPack::kAnd;
+			} else if (!startsWith(rest, "AND")) {
+				return false;
+			}
+
+			term.args.first = static_cast<uint32_t>(a_args.size());
+			if (posLB != posRB - 1) {
+				const std::string commaSepArgs = trim(line.substr(posLB + 1, posRB - (posLB + 1)));
+				if (commaSepArgs.empty()) {
+					// N.B. dargh (like DAR) drops conditions written as "Func( )".
+					continue;
+				}
+
+				for (auto sArg : splitOnCommas(commaSepArgs)) {
+					sArg = trim(sArg);
+					DARPack::Arg arg{};
+					if (sArg.empty() || sArg[0] == '"') {
+						// "esp name" | formID
+						const auto tokens = splitOnPipes(sArg);
+						if (tokens.size() != 2) {
+							return false;
+						}
+
+						const std::string espName = trim(tokens[0]);
+						if (espName.size() <= 2 || espName.front() != '"' || espName.back() != '"' ||
+							!isPluginName(espName.substr(1, espName.size() - 2))) {
+							return false;
+						}
+
+						// Light plugins allow at most 0xFFF; that's checked at load time.
+						const auto formID = parseUInt(trim(tokens[1]));
+						if (!formID || *formID > 0xFFFFFF) {
+							return false;
+						}
+
+						arg.kind = DARPack::ArgKind::kForm;
+						arg.plugin = a_pack.addPlugin(espName.substr(1, espName.size() - 2));
+						arg.value = *formID;
+					} else {
+						float fVal;
+						try {
+							fVal = std::stof(sArg);
+						} catch (const std::exception&) {
+							return false;
+						}
+						if (std::isnan(fVal)) {
+							return false;
+						}
+
+						arg.kind = DARPack::ArgKind::kFloat;
+						arg.value = std::bit_cast<uint32_t>(fVal);
+					}
+					a_args.push_back(arg);
+				}
+			}
+
+			term.args.count = static_cast<uint32_t>(a_args.size()) - term.args.first;
+			a_terms.push_back(term);
+		}
+
+		return true;
+	}
+
+	void compilePriorityFolders(const fs::path& a_darDir, PackBuilder& a_pack, std::ostream& a_log)
+	{
+		const fs::path customCondDir = a_darDir / "_CustomConditions";
+		for (const auto& sPriority : listSubfolders(customCondDir)) {
+			// <Priority> is a non-zero decimal number, without leading zeros.
+			const bool bValid = !sPriority.empty() && sPriority[0] != '0' &&
+				(isNumber(sPriority) || (sPriority.size() >= 2 && sPriority[0] == '-' && sPriority[1] != '0' && isNumber(sPriority.substr(1))));
+			if (!bValid) {
+				a_log << "skipping _CustomConditions\\" << sPriority << ": not a valid priority\n";
+				continue;
+			}
+
+			const fs::path priorityDir = customCondDir / sPriority;
+			std::ifstream fConditions(priorityDir / "_conditions.txt");
+			if (!fConditions.is_open()) {
+				a_log << "skipping _CustomConditions\\" << sPriority << ": couldn't find _conditions.txt\n";
+				continue;
+			}
+
+			std::vector<std::string> lines;
+			std::string sLine;
+			while (std::getline(fConditions, sLine)) {
+				if (!sLine.empty() && sLine.back() == '\r') {
+					sLine.pop_back();
+				}
+				sLine = trim(sLine);
+				if (!sLine.empty() && sLine[0] != ';') {
+					lines.push_back(sLine);
+				}
+			}
+
+			DARPack::PriorityFolder folder{};
+			folder.priority = static_cast<int32_t>(std::strtol(sPriority.c_str(), nullptr, 0));
+			folder.name = a_pack.addString(sPriority);
+			folder.errorLine = DARPack::NO_STRING;
+
+			std::vector<DARPack::Term> terms;
+			std::vector<DARPack::Arg> args;
+			std::size_t errorLine = 0;
+			if (parseConditions(lines, a_pack, terms, args, errorLine)) {
+				// Rebase the terms' args onto the pack's arg table.
+				const auto firstArg = static_cast<uint32_t>(a_pack.args.size());
+				for (auto& term : terms) {
+					term.args.first += firstArg;
+				}
+				folder.terms = { static_cast<uint32_t>(a_pack.terms.size()), static_cast<uint32_t>(terms.size()) };
+				a_pack.terms.insert(a_pack.terms.end(), terms.begin(), terms.end());
+				a_pack.args.insert(a_pack.args.end(), args.begin(), args.end());
+
+				std::vector<std::string> hkxFiles;
+				findHkxFiles(priorityDir, "", hkxFiles);
+				folder.paths = a_pack.addPaths(hkxFiles);
+			} else {
+				// Keep the folder, so that dargh reports the error as it
+				// would have done when loading the loose files.
+				folder.errorLine = a_pack.addString(lines[errorLine]);
+				a_log << "error: _CustomConditions\\" << sPriority << "\\_conditions.txt\n   " << lines[errorLine] << "\n";
+			}
+
+			a_pack.priorityFolders.push_back(folder);
+		}
+	}
+}
+
+std::vector<char> compileDARTree(const fs::path& a_darDir, std::ostream& a_log)
+{
+	PackBuilder pack;
+	compileActorBaseFolders(a_darDir, pack, a_log);
+	compilePriorityFolders(a_darDir, pack, a_log);
+	return pack.serialize();
+}
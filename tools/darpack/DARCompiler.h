@@ -0,0 +1,50 @@
+// ============================================================================
+//                               DARCompiler.h
+// ----------------------------------------------------------------------------
+// Part of the open-source Dynamic Animation Replacer (DARGH).
+//
+// Copyright (c) 2023 Nox Sidereum
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the �Software�), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is furnished
+// to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED �AS IS�, WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+// FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+// DEALINGS IN THE SOFTWARE.
+//
+// (The MIT License)
+// ============================================================================
+
+#pragma once
+
+// ----------------------------------------------------------------------------
+// Compiles a DynamicAnimationReplacer tree into a DAR pack (see DARPack.h).
+// The tree is read the same way dargh reads it (see DARProject.cpp). Anything
+// that depends on the load order or on the condition functions themselves
+// (whether a plugin is active or light, whether a function exists and how many
+// arguments it takes) is checked by dargh when it loads the pack.
+//
+// Used by the darpack and daranalyze tools; doesn't depend on CommonLibSSE.
+// ----------------------------------------------------------------------------
+
+#include "DARPack.h"
+
+#include <filesystem>
+#include <iosfwd>
+#include <vector>
+
+// Returns the pack compiled from the tree at 'a_darDir'
+// (...\animations\DynamicAnimationReplacer). Folders that are skipped, and
+// _conditions.txt files that fail to parse, are reported to 'a_log'.
+std::vector<char> compileDARTree(const std::filesystem::path& a_darDir, std::ostream& a_log);
@@ -0,0 +1,80 @@
+// ============================================================================
+//                                darpack.cpp
+// ----------------------------------------------------------------------------
+// Part of the open-source Dynamic Animation Replacer (DARGH).
+//
+// Copyright (c) 2023 Nox Sidereum
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the �Software�), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is furnished
+// to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED �AS IS�, WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+// FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+// DEALINGS IN THE SOFTWARE.
+//
+// (The MIT License)
+// ============================================================================
+
+// ----------------------------------------------------------------------------
+// darpack: compiles a DynamicAnimationReplacer tree into a single .darpack file
+// (see src/DARPack.h), which dargh loads instead of rescanning the tree and
+// reparsing its _conditions.txt files on every start.
+//
+// Usage:
+//     darpack <path to ...\animations\DynamicAnimationReplacer> [<output file>]
+//
+// By default the pack is written next to the tree, as
+// ...\animations\DynamicAnimationReplacer.darpack.
+// ----------------------------------------------------------------------------
+
+#include "DARCompiler.h"
+
+#include <fstream>
+#include <iostream>
+
+namespace fs = std::filesystem;
+
+int main(int argc, char* argv[])
+{
+	if (argc < 2 || argc > 3) {
+		std::cerr << "usage: darpack <path to ...\\animations\\DynamicAnimationReplacer> [<output file>]\n";
+		return 2;
+	}
+
+	fs::path darDir = fs::path(argv[1]).lexically_normal();
+	if (darDir.filename().empty()) {
+		darDir = darDir.parent_path();    // trailing separator
+	}
+	if (!fs::is_directory(darDir)) {
+		std::cerr << "not a folder: " << darDir.string() << "\n";
+		return 1;
+	}
+
+	const fs::path outPath = argc == 3 ? fs::path(argv[2]) : darDir.parent_path() / DARPack::FILE_NAME;
+
+	const auto data = compileDARTree(darDir, std::cerr);
+
+	std::ofstream out(outPath, std::ios::binary);
+	if (!out.write(data.data(), data.size())) {
+		std::cerr << "couldn't write " << outPath.string() << "\n";
+		return 1;
+	}
+
+	DARPack::View pack;
+	pack.open(data.data(), data.size());
+	std::cout << "wrote " << outPath.string() << ": " << pack.actorBaseFolders().size() << " actor base folders, "
+	          << pack.priorityFolders().size() << " priority folders, " << pack.paths().size() << " animation files, "
+	          << data.size() << " bytes\n";
+	return 0;
+}
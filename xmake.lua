@@ -44,3 +44,151 @@ target("skse-dargh")
 
     -- add install files
     add_installfiles("res/*.ini", { prefixdir = "SKSE/Plugins" })
+
+-- offline compiler for DynamicAnimationReplacer trees (Windows or Linux):
+--     xmake build darpack
+target("darpack")
+    set_kind("binary")
+    set_default(false)
+
+    add_files("tools/darpack/*.cpp")
+    add_headerfiles("src/DARPack.h", "tools/darpack/*.h")
+    add_includedirs("src")
+
+-- offline report on the DynamicAnimationReplacer trees under a meshes folder:
+--     xmake build daranalyze
+target("daranalyze")
+    set_kind("binary")
+    set_default(false)
+
+    add_files("tools/daranalyze/*.cpp", "tools/darpack/DARCompiler.cpp")
+    add_headerfiles("src/DARPack.h", "tools/darpack/*.h")
+    add_includedirs("src", "tools/darpack")
+
+-- host tests of the BSA reader, against the archives in tests/bsarchive/fixtures:
+--     xmake build bsarchive_test && xmake run bsarchive_test
+target("bsarchive_test")
+    set_kind("binary")
+    set_default(false)
+
+    add_files("tests/bsarchive/bsarchive_test.cpp", "src/BSArchive.cpp")
+    add_headerfiles("src/BSArchive.h")
+    add_includedirs("src")
+    set_rundir("$(projectdir)/tests/bsarchive/fixtures")
+
+-- timings of the BSA reader on real archives:
+--     xmake build bsarchive_bench && xmake run bsarchive_bench <archive.bsa>...
+target("bsarchive_bench")
+    set_kind("binary")
+    set_default(false)
+
+    add_files("tests/bsarchive/bsarchive_bench.cpp", "src/BSArchive.cpp")
+    add_headerfiles("src/BSArchive.h")
+    add_includedirs("src")
+
+-- ThreadSanitizer stress test of the condition engine, built on the host against
+-- the engine stand-ins in tests/host (gcc or clang):
+--     xmake build conditions_stress && xmake run conditions_stress
+target("conditions_stress")
+    set_kind("binary")
+    set_default(false)
+    set_policy("build.sanitizer.thread", true)
+
+    add_files("tests/host/conditions_stress.cpp", "src/StaticConditions.cpp", "src/WorldSnapshot.cpp",
+              "src/Trace.cpp", "src/Utilities.cpp")
+    add_includedirs("tests/host", "src")
+    add_forceincludes("$(projectdir)/tests/host/PCH.h")
+
+-- host test of the lowercasing and hashing of paths (Utilities.cpp), for every byte value:
+--     xmake build lower_ascii_test && xmake run lower_ascii_test
+target("lower_ascii_test")
+    set_kind("binary")
+    set_default(false)
+
+    add_files("tests/host/lower_ascii_test.cpp", "src/Utilities.cpp")
+    add_includedirs("tests/host", "src")
+    add_forceincludes("$(projectdir)/tests/host/PCH.h")
+
+-- timings of the lowercasing and hashing of paths (Utilities.cpp) against std::transform(std::tolower),
+-- on made-up paths or on those listed in a file:
+--     xmake build lower_ascii_bench && xmake run lower_ascii_bench [<paths.txt>]
+target("lower_ascii_bench")
+    set_kind("binary")
+    set_default(false)
+
+    add_files("tests/host/lower_ascii_bench.cpp", "src/Utilities.cpp")
+    add_includedirs("tests/host", "src")
+    add_forceincludes("$(projectdir)/tests/host/PCH.h")
+
+-- host test that batched condition evaluation (tests/host/ConditionBatch.cpp) agrees with evaluate:
+--     xmake build condition_batch_test && xmake run condition_batch_test
+target("condition_batch_test")
+    set_kind("binary")
+    set_default(false)
+
+    add_files("tests/host/condition_batch_test.cpp", "tests/host/ConditionBatch.cpp")
+    add_includedirs("tests/host", "src")
+    add_forceincludes("$(projectdir)/tests/host/PCH.h")
+
+-- host test that choosing a replacement (getNewAnimIndex) doesn't allocate, over a recorded
+-- sequence of activations:
+--     xmake build decision_alloc_test && xmake run decision_alloc_test
+target("decision_alloc_test")
+    set_kind("binary")
+    set_default(false)
+
+    add_files("tests/host/decision_alloc_test.cpp", "src/DARProjectRegistry.cpp", "src/DecisionDAG.cpp",
+              "src/StaticConditions.cpp", "src/Trace.cpp", "src/Utilities.cpp")
+    add_includedirs("tests/host", "src")
+    add_forceincludes("$(projectdir)/tests/host/PCH.h")
+
+-- host test that AnimationLoaderHook and then hkbClipGenerator::Activate decide an activation once:
+--     xmake build activation_test && xmake run activation_test
+target("activation_test")
+    set_kind("binary")
+    set_default(false)
+
+    add_defines("DEBUG_COUNT_DECISIONS")
+    add_files("tests/host/activation_test.cpp", "src/ClipActivation.cpp", "src/DARProjectRegistry.cpp",
+              "src/StaticConditions.cpp", "src/Trace.cpp", "src/Utilities.cpp")
+    add_includedirs("tests/host", "src")
+    add_forceincludes("$(projectdir)/tests/host/PCH.h")
+
+-- predicate evaluations and time per decision, in sequence and by decision diagram (DecisionDAG.h),
+-- on real DynamicAnimationReplacer trees or .darpack files:
+--     xmake build decision_bench && xmake run decision_bench <...\animations\DynamicAnimationReplacer | x.darpack>...
+target("decision_bench")
+    set_kind("binary")
+    set_default(false)
+
+    add_files("tests/host/decision_bench.cpp", "tests/host/DARTree.cpp", "tools/darpack/DARCompiler.cpp",
+              "src/DARFolderData.cpp", "src/DARProjectRegistry.cpp", "src/DARRemapPlan.cpp", "src/DecisionDAG.cpp",
+              "src/StaticConditions.cpp", "src/Timing.cpp", "src/Trace.cpp", "src/Utilities.cpp")
+    add_includedirs("tests/host", "src", "tools/darpack")
+    add_forceincludes("$(projectdir)/tests/host/PCH.h")
+
+-- predicate evaluations and time per decision, with and without StaticConditionCache (StaticConditions.h),
+-- on real DynamicAnimationReplacer trees or .darpack files:
+--     xmake build static_bench && xmake run static_bench <...\animations\DynamicAnimationReplacer | x.darpack>...
+target("static_bench")
+    set_kind("binary")
+    set_default(false)
+
+    add_files("tests/host/static_bench.cpp", "tests/host/DARTree.cpp", "tools/darpack/DARCompiler.cpp",
+              "src/DARFolderData.cpp", "src/DARProjectRegistry.cpp", "src/DARRemapPlan.cpp", "src/DecisionDAG.cpp",
+              "src/StaticConditions.cpp", "src/Timing.cpp", "src/Trace.cpp", "src/Utilities.cpp")
+    add_includedirs("tests/host", "src", "tools/darpack")
+    add_forceincludes("$(projectdir)/tests/host/PCH.h")
+
+-- memory and lookup time of the actor base mappings (ActorBaseTable, DARLink.h) against the
+-- per-from_hkx_index std::unordered_map they replaced, on real DynamicAnimationReplacer trees or .darpack files:
+--     xmake build actorbase_bench && xmake run actorbase_bench <...\animations\DynamicAnimationReplacer | x.darpack>...
+target("actorbase_bench")
+    set_kind("binary")
+    set_default(false)
+
+    add_files("tests/host/actorbase_bench.cpp", "tests/host/DARTree.cpp", "tools/darpack/DARCompiler.cpp",
+              "src/DARFolderData.cpp", "src/DARProjectRegistry.cpp", "src/DARRemapPlan.cpp", "src/DecisionDAG.cpp",
+              "src/StaticConditions.cpp", "src/Timing.cpp", "src/Trace.cpp", "src/Utilities.cpp")
+    add_includedirs("tests/host", "src", "tools/darpack")
+    add_forceincludes("$(projectdir)/tests/host/PCH.h")